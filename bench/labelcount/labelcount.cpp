@@ -0,0 +1,114 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "Kaadugal.hpp"
+#include "DenseDataSet.hpp"
+#include "DenseStatistics.hpp"
+#include "LabelCounts.hpp"
+#include "Utilities.hpp"
+
+using namespace Kaadugal;
+
+// Microbenchmark for computing the left/right class counts of many thresholds of one feature response
+// Compares partitioning and aggregating statistics at every threshold (SplitSearch: Partition) with the
+// single pass label counting kernels in LabelCounts.hpp
+int main(int argc, char * argv[])
+{
+	if (argc > 1 && std::string(argv[1]) == "-h")
+	{
+		std::cout << "[ USAGE ]: " << argv[0] << " [NUM_DATAPOINTS] [NUM_THRESHOLDS] [NUM_CLASSES] [NUM_REPEATS]" << std::endl;
+		return -1;
+	}
+	int NumDataPoints = argc > 1 ? std::atoi(argv[1]) : 100000;
+	int NumThresholds = argc > 2 ? std::atoi(argv[2]) : 50;
+	int NumClasses = argc > 3 ? std::atoi(argv[3]) : 4;
+	int NumRepeats = argc > 4 ? std::atoi(argv[4]) : 10;
+	if (NumDataPoints <= 0 || NumThresholds <= 0 || NumClasses <= 0 || NumRepeats <= 0)
+	{
+		std::cout << "[ WARN ]: All arguments must be positive." << std::endl;
+		return -1;
+	}
+
+	// Random responses (one feature) and labels. The index is shuffled like the data of a tree node
+	std::mt19937 RNG(0);
+	std::uniform_real_distribution<VPFloat> ValueDist(0.0, 1.0);
+	std::uniform_int_distribution<int> LabelDist(0, NumClasses - 1);
+	auto DataSet = std::make_shared<DenseDataSet>(NumDataPoints, 1);
+	DataSet->SetNumClasses(NumClasses);
+	for (int i = 0; i < NumDataPoints; ++i)
+	{
+		DataSet->SetFeature(i, 0, ValueDist(RNG));
+		DataSet->SetLabel(i, LabelDist(RNG));
+	}
+	std::vector<int> Index(NumDataPoints);
+	for (int i = 0; i < NumDataPoints; ++i)
+		Index[i] = i;
+	std::shuffle(Index.begin(), Index.end(), RNG);
+	auto DataSetIdx = std::make_shared<DataSetIndex>(DataSet, Index);
+
+	std::vector<VPFloat> Responses(NumDataPoints);
+	for (int k = 0; k < NumDataPoints; ++k)
+		Responses[k] = DataSet->GetFeature(Index[k], 0);
+	std::vector<VPFloat> Thresholds(NumThresholds);
+	for (int j = 0; j < NumThresholds; ++j)
+		Thresholds[j] = ValueDist(RNG);
+	std::sort(Thresholds.begin(), Thresholds.end());
+
+	std::cout << "[ INFO ]: " << NumDataPoints << " data points, " << NumThresholds << " thresholds, " << NumClasses << " classes, "
+		<< NumRepeats << " repeats. Best kernel: " << LabelCounts::GetKernelName(LabelCounts::GetBestKernel()) << std::endl;
+
+	// Reference: partition at every threshold and aggregate statistics of both sides
+	std::vector<int> RefLeft(NumThresholds * NumClasses);
+	std::vector<int> RefRight(NumThresholds * NumClasses);
+	uint64_t StartTime = GetCurrentEpochTime();
+	for (int r = 0; r < NumRepeats; ++r)
+	{
+		for (int j = 0; j < NumThresholds; ++j)
+		{
+			std::vector<int> LeftIdx;
+			std::vector<int> RightIdx;
+			for (int k = 0; k < NumDataPoints; ++k)
+			{
+				if (Responses[k] > Thresholds[j])
+					LeftIdx.push_back(Index[k]);
+				else
+					RightIdx.push_back(Index[k]);
+			}
+			DenseHistogramStats LeftStats(std::make_shared<DataSetIndex>(DataSet, LeftIdx));
+			DenseHistogramStats RightStats(std::make_shared<DataSetIndex>(DataSet, RightIdx));
+			std::copy(LeftStats.GetBins().begin(), LeftStats.GetBins().end(), RefLeft.begin() + j * NumClasses);
+			std::copy(RightStats.GetBins().begin(), RightStats.GetBins().end(), RefRight.begin() + j * NumClasses);
+		}
+	}
+	double RefTime = (GetCurrentEpochTime() - StartTime) * 1e-3 / NumRepeats;
+	std::cout << "[ INFO ]: Partition + Aggregate: " << RefTime << " ms." << std::endl;
+
+	int Status = 0;
+	LabelCountKernel Kernels[] = { LabelCountKernel::Scalar, LabelCountKernel::SSE2, LabelCountKernel::AVX2 };
+	for (LabelCountKernel Kernel : Kernels)
+	{
+		if (LabelCounts::isKernelSupported(Kernel) == false)
+		{
+			std::cout << "[ INFO ]: " << LabelCounts::GetKernelName(Kernel) << ": not supported by this CPU." << std::endl;
+			continue;
+		}
+
+		std::vector<int> Left(NumThresholds * NumClasses);
+		std::vector<int> Right(NumThresholds * NumClasses);
+		StartTime = GetCurrentEpochTime();
+		for (int r = 0; r < NumRepeats; ++r)
+			CountLabelsPerThreshold(Responses.data(), DataSet->GetLabelData(), Index.data(), NumDataPoints, Thresholds.data(), NumThresholds, NumClasses, Left.data(), Right.data(), Kernel);
+		double Time = (GetCurrentEpochTime() - StartTime) * 1e-3 / NumRepeats;
+
+		bool isCorrect = Left == RefLeft && Right == RefRight;
+		std::cout << "[ INFO ]: " << LabelCounts::GetKernelName(Kernel) << ": " << Time << " ms (" << RefTime / Time << "x)"
+			<< (isCorrect ? "" : " WRONG COUNTS") << std::endl;
+		if (!isCorrect)
+			Status = -2;
+	}
+
+	return Status;
+}
@@ -0,0 +1,435 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
+#include <cmath>
+#include <chrono>
+#include <atomic>
+#include <new>
+
+#include "Kaadugal.hpp"
+#include "DenseDataSet.hpp"
+#include "DenseStatistics.hpp"
+#include "AxisAlignedFeatureResponse.hpp"
+#include "DecisionTreeBuilder.hpp"
+#include "DecisionForestBuilder.hpp"
+#include "CompiledForest.hpp"
+#include "Utilities.hpp"
+
+using namespace Kaadugal;
+
+typedef DecisionTreeBuilder<AxisAlignedFeatureResponse, DenseHistogramStats, AbstractLeafData> TreeBuilder;
+typedef DecisionForestBuilder<AxisAlignedFeatureResponse, DenseHistogramStats, AbstractLeafData> ForestBuilder;
+
+// Heap allocations of the whole program. Benchmarks report how many happen in one iteration
+std::atomic<uint64_t> g_NumAllocations(0);
+
+void * operator new(size_t Size)
+{
+	g_NumAllocations.fetch_add(1, std::memory_order_relaxed);
+	void * Pointer = std::malloc(Size > 0 ? Size : 1);
+	if (Pointer == nullptr)
+		throw std::bad_alloc();
+	return Pointer;
+}
+void * operator new[](size_t Size) { return operator new(Size); }
+// Not inlined so that GCC does not mistake freeing memory from operator new for a mismatched deallocation
+#if defined(__GNUC__)
+__attribute__((noinline))
+#endif
+void operator delete(void * Pointer) noexcept { std::free(Pointer); }
+void operator delete[](void * Pointer) noexcept { operator delete(Pointer); }
+void operator delete(void * Pointer, size_t) noexcept { operator delete(Pointer); }
+void operator delete[](void * Pointer, size_t) noexcept { operator delete(Pointer); }
+
+// Silences std::cout (e.g. progress printed by the builders) while in scope
+class QuietOutput
+{
+private:
+	std::ostringstream m_Sink;
+	std::streambuf * m_Original;
+
+public:
+	QuietOutput(void) : m_Original(std::cout.rdbuf(m_Sink.rdbuf())) {};
+	~QuietOutput(void) { std::cout.rdbuf(m_Original); };
+};
+
+struct BenchResult
+{
+	std::string m_Name;
+	uint64_t m_Items; // Work done by one iteration, e.g. data points or evaluations
+	int m_Iterations; // Iterations timed together in one run
+	std::vector<double> m_Times; // Milliseconds per iteration of every run
+	double m_Allocations; // Heap allocations per iteration (timed runs only, not setup)
+
+	double GetMin(void) const { return *std::min_element(m_Times.begin(), m_Times.end()); };
+	double GetMax(void) const { return *std::max_element(m_Times.begin(), m_Times.end()); };
+	double GetMean(void) const
+	{
+		double Sum = 0.0;
+		for (double Time : m_Times)
+			Sum += Time;
+		return Sum / m_Times.size();
+	};
+	double GetMedian(void) const
+	{
+		std::vector<double> Sorted = m_Times;
+		std::sort(Sorted.begin(), Sorted.end());
+		size_t Mid = Sorted.size() / 2;
+		return Sorted.size() % 2 ? Sorted[Mid] : 0.5 * (Sorted[Mid - 1] + Sorted[Mid]);
+	};
+};
+
+int g_NumDataPoints = 100000;
+int g_NumFeatures = 16;
+int g_NumClasses = 4;
+int g_NumRepeats = 5;
+int g_NumThreads = 1;
+std::string g_OutputFName = "microbench.json";
+const uint64_t g_Seed = 42; // Data and random numbers are the same in every run and version
+const double g_MinRunTime = 10.0; // Milliseconds. Fast kernels are iterated until a run takes at least this long
+std::vector<BenchResult> g_Results;
+
+// Times Run g_NumRepeats times after a warm up run that also decides how many iterations make up a run. Setup is
+// called (untimed) before every iteration. Random numbers are reseeded before every iteration so that all do the same work
+void RunBenchmark(const std::string& Name, uint64_t Items, std::function<void(void)> Run, std::function<void(void)> Setup = nullptr)
+{
+	BenchResult Result;
+	Result.m_Name = Name;
+	Result.m_Items = Items;
+	Result.m_Iterations = 1;
+	uint64_t NumAllocations = 0;
+	for (int r = -1; r < g_NumRepeats; ++r)
+	{
+		std::chrono::steady_clock::duration RunTime(0);
+		for (int i = 0; i < Result.m_Iterations; ++i)
+		{
+			if (Setup)
+				Setup();
+			Randomizer::Get().Seed(g_Seed);
+			QuietOutput Quiet;
+			uint64_t StartAllocations = g_NumAllocations.load(std::memory_order_relaxed);
+			std::chrono::steady_clock::time_point StartTime = std::chrono::steady_clock::now();
+			Run();
+			RunTime += std::chrono::steady_clock::now() - StartTime;
+			if (r >= 0)
+				NumAllocations += g_NumAllocations.load(std::memory_order_relaxed) - StartAllocations;
+		}
+		double Time = std::chrono::duration<double, std::milli>(RunTime).count() / Result.m_Iterations;
+		if (r >= 0)
+			Result.m_Times.push_back(Time);
+		else
+			Result.m_Iterations = std::max(1, int(std::ceil(g_MinRunTime / std::max(Time, 1e-6))));
+	}
+	Result.m_Allocations = double(NumAllocations) / (double(g_NumRepeats) * Result.m_Iterations);
+	std::cout << "[ INFO ]: " << Name << ": " << Result.GetMedian() << " ms (median of " << g_NumRepeats << " x " << Result.m_Iterations
+		<< " iterations), " << Items / Result.GetMedian() * 1e-3 << " M items/s, " << Result.m_Allocations << " allocations." << std::endl;
+	g_Results.push_back(Result);
+}
+
+// Classes depend on the first features so that trees grow like on real data. Other features are noise
+std::shared_ptr<DenseDataSet> MakeDataSet(int NumDataPoints, uint64_t Seed)
+{
+	std::mt19937 RNG(static_cast<uint32_t>(Seed));
+	std::uniform_real_distribution<VPFloat> ValueDist(0.0, 1.0);
+	std::uniform_int_distribution<int> NoiseDist(0, 9);
+	auto DataSet = std::make_shared<DenseDataSet>(NumDataPoints, g_NumFeatures);
+	DataSet->SetNumClasses(g_NumClasses);
+	for (int i = 0; i < NumDataPoints; ++i)
+	{
+		VPFloat Sum = 0.0;
+		for (int f = 0; f < g_NumFeatures; ++f)
+		{
+			VPFloat Value = ValueDist(RNG);
+			DataSet->SetFeature(i, f, Value);
+			if (f < 3)
+				Sum += Value;
+		}
+		int Label = std::min(g_NumClasses - 1, int(Sum / 3.0 * g_NumClasses));
+		if (NoiseDist(RNG) == 0)
+			Label = (Label + 1) % g_NumClasses;
+		DataSet->SetLabel(i, Label);
+	}
+
+	return DataSet;
+}
+
+void WriteJSON(std::ostream& Out)
+{
+	Out << "{\n";
+	Out << "  \"benchmark\": \"microbench\",\n";
+	Out << "  \"format_version\": 2,\n";
+	Out << "  \"timestamp_us\": " << GetCurrentEpochTime() << ",\n";
+	Out << "  \"config\": { \"num_datapoints\": " << g_NumDataPoints << ", \"num_features\": " << g_NumFeatures << ", \"num_classes\": " << g_NumClasses
+		<< ", \"num_repeats\": " << g_NumRepeats << ", \"num_threads\": " << g_NumThreads << ", \"seed\": " << g_Seed << ", \"min_run_ms\": " << g_MinRunTime << " },\n";
+	Out << "  \"environment\": { \"compiler\": \"" << __VERSION__ << "\", \"vpfloat_bytes\": " << sizeof(VPFloat)
+		<< ", \"max_threads\": " << omp_get_max_threads() << " },\n";
+	Out << "  \"results\": [\n";
+	for (size_t i = 0; i < g_Results.size(); ++i)
+	{
+		const BenchResult& Result = g_Results[i];
+		Out << "    { \"name\": \"" << Result.m_Name << "\", \"items\": " << Result.m_Items << ", \"iterations\": " << Result.m_Iterations << ", \"min_ms\": " << Result.GetMin()
+			<< ", \"median_ms\": " << Result.GetMedian() << ", \"mean_ms\": " << Result.GetMean() << ", \"max_ms\": " << Result.GetMax()
+			<< ", \"items_per_second\": " << uint64_t(Result.m_Items / Result.GetMedian() * 1e3) << ", \"allocations_per_iteration\": " << Result.m_Allocations
+			<< ", \"times_ms\": [";
+		for (size_t r = 0; r < Result.m_Times.size(); ++r)
+			Out << (r ? ", " : "") << Result.m_Times[r];
+		Out << "] }" << (i + 1 < g_Results.size() ? "," : "") << "\n";
+	}
+	Out << "  ]\n";
+	Out << "}\n";
+}
+
+bool ParseArguments(int argc, char * argv[])
+{
+	if (argc > 7 || (argc > 1 && std::string(argv[1]) == "-h"))
+	{
+		std::cout << "[ USAGE ]: " << argv[0] << " [NUM_DATAPOINTS] [NUM_FEATURES] [NUM_CLASSES] [NUM_REPEATS] [NUM_THREADS] [OUTPUT_JSON]" << std::endl;
+		return false;
+	}
+	g_NumDataPoints = argc > 1 ? std::atoi(argv[1]) : g_NumDataPoints;
+	g_NumFeatures = argc > 2 ? std::atoi(argv[2]) : g_NumFeatures;
+	g_NumClasses = argc > 3 ? std::atoi(argv[3]) : g_NumClasses;
+	g_NumRepeats = argc > 4 ? std::atoi(argv[4]) : g_NumRepeats;
+	g_NumThreads = argc > 5 ? std::atoi(argv[5]) : g_NumThreads;
+	g_OutputFName = argc > 6 ? argv[6] : g_OutputFName;
+	if (g_NumDataPoints < 100 || g_NumFeatures <= 0 || g_NumClasses <= 1 || g_NumRepeats <= 0 || g_NumThreads <= 0)
+	{
+		std::cout << "[ WARN ]: Need at least 100 data points, 2 classes and positive other arguments." << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+// Microbenchmarks of the training and inference hot paths on synthetic data. Results are written as JSON
+// (OUTPUT_JSON) so that runs of different versions of the library can be compared. All sizes are configurable
+// and the data and random numbers are seeded, so runs with the same arguments do the same work
+int main(int argc, char * argv[])
+{
+	if (ParseArguments(argc, argv) == false)
+		return -1;
+
+	std::shared_ptr<DenseDataSet> DataSet = MakeDataSet(g_NumDataPoints, g_Seed);
+	const int NumDataPoints = g_NumDataPoints;
+
+	// Index of a node as it is during training: shuffled data points
+	std::vector<int> Index(NumDataPoints);
+	for (int i = 0; i < NumDataPoints; ++i)
+		Index[i] = i;
+	std::mt19937 RNG(static_cast<uint32_t>(g_Seed));
+	std::shuffle(Index.begin(), Index.end(), RNG);
+	auto DataSetIdx = std::make_shared<DataSetIndex>(DataSet, Index);
+
+	ForestBuilderParameters NodeParameters(1, 1, 10, 50, 0.0, TrainMethod::DFS, g_NumThreads);
+	TreeBuilder Builder(NodeParameters);
+	std::cout << "[ INFO ]: " << NumDataPoints << " data points, " << g_NumFeatures << " features, " << g_NumClasses << " classes, "
+		<< g_NumRepeats << " repeats, " << g_NumThreads << " thread(s)." << std::endl;
+
+	// Node level kernels
+	AxisAlignedFeatureResponse FeatureResponse(0);
+	std::vector<VPFloat> Responses(NumDataPoints);
+	RunBenchmark("FeatureResponse", NumDataPoints, [&]()
+	{
+		for (int k = 0; k < NumDataPoints; ++k)
+			Responses[k] = FeatureResponse.GetResponseAt(*DataSet, Index[k]);
+	});
+
+	std::vector<VPFloat> Thresholds;
+	RunBenchmark("SelectThresholds", NodeParameters.m_NumCandidateThresholds, [&]()
+	{
+		Thresholds = Builder.SelectThresholds(Responses, NumDataPoints);
+	});
+
+	auto LeftBuffer = std::make_shared<std::vector<int>>();
+	auto RightBuffer = std::make_shared<std::vector<int>>();
+	std::pair<std::shared_ptr<DataSetIndex>, std::shared_ptr<DataSetIndex>> Subsets;
+	VPFloat MedianThreshold = Thresholds[Thresholds.size() / 2];
+	RunBenchmark("Partition", NumDataPoints, [&]()
+	{
+		Subsets = Builder.Partition(DataSetIdx, Responses, MedianThreshold, LeftBuffer, RightBuffer);
+	});
+
+	DenseHistogramStats ParentStats;
+	RunBenchmark("Statistics/Aggregate", NumDataPoints, [&]()
+	{
+		ParentStats.Aggregate(DataSetIdx);
+	});
+
+	// Merging leaf statistics (one per data point and tree when testing, one per bucket when training)
+	DenseHistogramStats LeftStats(Subsets.first);
+	DenseHistogramStats RightStats(Subsets.second);
+	auto LeafStats = std::make_shared<DenseHistogramStats>(LeftStats);
+	DenseHistogramStats MergedStats;
+	RunBenchmark("Statistics/Merge", NumDataPoints, [&]()
+	{
+		for (int k = 0; k < NumDataPoints; ++k)
+			MergedStats.Merge(LeafStats);
+	}, [&]() { MergedStats = DenseHistogramStats(); });
+
+	const int NumEvaluations = 100000;
+	VPFloat ObjVal = 0.0;
+	RunBenchmark("Objective", NumEvaluations, [&]()
+	{
+		for (int k = 0; k < NumEvaluations; ++k)
+			ObjVal += Builder.GetObjectiveValue(ParentStats, LeftStats, RightStats);
+	});
+
+	// Split search of a root node with all data: NumCandidateFeatures candidates with NumCandidateThresholds thresholds each
+	// The tree has only one level so the rest is making its two leaves. Builders get a fresh index since they may reorder it
+	std::shared_ptr<DataSetIndex> BuildDataSetIdx;
+	auto ResetIndex = [&]() { BuildDataSetIdx = std::make_shared<DataSetIndex>(DataSet, Index); };
+	const char * SearchNames[] = { "Partition", "Bucketed", "Histogram" };
+	SplitSearch Searches[] = { SplitSearch::Partition, SplitSearch::Bucketed, SplitSearch::Histogram };
+	if (DataSet->Quantize() == false)
+		std::cout << "[ WARN ]: Data set cannot be quantized. Histogram split search falls back to buckets." << std::endl;
+
+	// Evaluating one candidate of the root node with a warm workspace. This is the steady state of split search
+	// and should not allocate
+	for (int s = 0; s < 3; ++s)
+	{
+		ForestBuilderParameters SearchParameters(1, 1, 10, 50, 0.0, TrainMethod::DFS, g_NumThreads, 3, Searches[s]);
+		TreeBuilder CandidateBuilder(SearchParameters);
+		SplitWorkspace<DenseHistogramStats> Workspace;
+		DenseHistogramStats EmptyStats(std::make_shared<DataSetIndex>(DataSet, std::vector<int>()));
+		VPFloat CandidateObjVal = 0.0;
+		VPFloat CandidateThreshold = 0.0;
+		RunBenchmark(std::string("SplitCandidate/") + SearchNames[s], NumDataPoints, [&]()
+		{
+			CandidateBuilder.EvaluateCandidate(ParentStats, &EmptyStats, DataSetIdx, FeatureResponse, Workspace, CandidateObjVal, CandidateThreshold, 0);
+		});
+	}
+
+	for (int s = 0; s < 3; ++s)
+	{
+		ForestBuilderParameters SearchParameters(1, 1, 10, 50, 0.0, TrainMethod::DFS, g_NumThreads, 3, Searches[s]);
+		RunBenchmark(std::string("SplitSearch/") + SearchNames[s], NumDataPoints, [&]()
+		{
+			TreeBuilder SearchBuilder(SearchParameters);
+			SearchBuilder.Build(BuildDataSetIdx);
+		}, ResetIndex);
+	}
+
+	// Split search of the root of a second tree with the same builder. Its workspaces were sized for the first tree
+	// (see DecisionTreeBuilder::PrepareWorkspaces()) so evaluating all candidates must not allocate
+	for (int s = 0; s < 3; ++s)
+	{
+		ForestBuilderParameters SearchParameters(1, 1, 10, 50, 0.0, TrainMethod::DFS, g_NumThreads, 3, Searches[s]);
+		TreeBuilder SecondTreeBuilder(SearchParameters);
+		ResetIndex();
+		{
+			QuietOutput Quiet;
+			SecondTreeBuilder.Build(BuildDataSetIdx);
+		}
+		AxisAlignedFeatureResponse OptFeatureResponse;
+		VPFloat OptThreshold = 0.0;
+		RunBenchmark(std::string("SplitSearch/") + SearchNames[s] + "/SecondTree", NumDataPoints, [&]()
+		{
+			SecondTreeBuilder.FindBestSplit(ParentStats, DataSetIdx, 1, 0, OptFeatureResponse, OptThreshold);
+		});
+		if (g_Results.back().m_Allocations != 0.0)
+		{
+			std::cout << "[ ERROR ]: Split search of a second tree allocated " << g_Results.back().m_Allocations << " times." << std::endl;
+			return -2;
+		}
+	}
+
+	// Whole trees
+	const char * MethodNames[] = { "DFS", "BFS", "Hybrid" };
+	TrainMethod Methods[] = { TrainMethod::DFS, TrainMethod::BFS, TrainMethod::Hybrid };
+	for (int m = 0; m < 3; ++m)
+	{
+		ForestBuilderParameters TreeParameters(1, 16, 10, 20, 0.0, Methods[m], g_NumThreads, 10, SplitSearch::Bucketed);
+		RunBenchmark(std::string("TreeBuild/") + MethodNames[m], NumDataPoints, [&]()
+		{
+			TreeBuilder WholeTreeBuilder(TreeParameters);
+			WholeTreeBuilder.Build(BuildDataSetIdx);
+		}, ResetIndex);
+
+		// Trees after the first one of a builder reuse its workspaces. What is left are the nodes and per-level bookkeeping
+		TreeBuilder SecondTreeBuilder(TreeParameters);
+		ResetIndex();
+		{
+			QuietOutput Quiet;
+			SecondTreeBuilder.Build(BuildDataSetIdx);
+		}
+		RunBenchmark(std::string("TreeBuild/") + MethodNames[m] + "/SecondTree", NumDataPoints, [&]()
+		{
+			SecondTreeBuilder.Build(BuildDataSetIdx);
+		}, ResetIndex);
+	}
+
+	// Inference on data that was not trained on
+	ForestBuilderParameters ForestParameters(8, 16, 10, 20, 0.0, TrainMethod::DFS, g_NumThreads, 10, SplitSearch::Bucketed, -1, 16384, false, 65536, 1024, g_Seed);
+	ForestBuilder TrainedForestBuilder(ForestParameters);
+	{
+		QuietOutput Quiet;
+		TrainedForestBuilder.Build(DataSet);
+	}
+	DecisionForest<AxisAlignedFeatureResponse, DenseHistogramStats, AbstractLeafData>& Forest = TrainedForestBuilder.GetForest();
+	std::shared_ptr<DenseDataSet> TestDataSet = MakeDataSet(NumDataPoints, g_Seed + 1);
+	const int NumSingleTests = std::min(NumDataPoints, 10000); // Testing one data point object at a time is slow
+	RunBenchmark("ForestTest/Single", uint64_t(NumSingleTests) * Forest.GetNumTrees(), [&]()
+	{
+		for (int i = 0; i < NumSingleTests; ++i)
+		{
+			auto Stats = std::make_shared<DenseHistogramStats>();
+			Forest.Test(TestDataSet->Get(i), Stats);
+		}
+	});
+
+	std::vector<DenseHistogramStats> BatchResults;
+	RunBenchmark("ForestTest/Batch", uint64_t(NumDataPoints) * Forest.GetNumTrees(), [&]()
+	{
+		Forest.TestBatch(*TestDataSet, BatchResults, 0, NumDataPoints, nullptr, g_NumThreads);
+	}, [&]() { BatchResults.assign(NumDataPoints, DenseHistogramStats()); });
+
+	// Early exit once the winning class is decided (same decisions as all trees)
+	std::vector<int> NumTreesEvaluated;
+	RunBenchmark("ForestTest/EarlyExit", uint64_t(NumDataPoints) * Forest.GetNumTrees(), [&]()
+	{
+		Forest.TestBatchEarlyExit(*TestDataSet, BatchResults, NumTreesEvaluated, 0.0, 0, NumDataPoints, g_NumThreads);
+	}, [&]() { BatchResults.assign(NumDataPoints, DenseHistogramStats()); });
+	double SumTrees = 0.0;
+	for (int NumTrees : NumTreesEvaluated)
+		SumTrees += NumTrees;
+	std::cout << "[ INFO ]: Early exit evaluated " << SumTrees / NumDataPoints << " of " << Forest.GetNumTrees() << " trees on average." << std::endl;
+	std::vector<DenseHistogramStats> AllTreesResults(NumDataPoints);
+	Forest.TestBatch(*TestDataSet, AllTreesResults, 0, NumDataPoints, nullptr, g_NumThreads);
+	int NumChangedDecisions = 0;
+	for (int i = 0; i < NumDataPoints; ++i)
+		NumChangedDecisions += BatchResults[i].FindWinnerLabelIndex() != AllTreesResults[i].FindWinnerLabelIndex() ? 1 : 0;
+	if (NumChangedDecisions > 0)
+	{
+		std::cout << "[ ERROR ]: Early exit with margin 0 changed " << NumChangedDecisions << " decisions of TestBatch()." << std::endl;
+		return -2;
+	}
+
+	CompiledForest Compiled;
+	Compiled.Compile(Forest, g_NumClasses, [](const DenseHistogramStats& Stats, const AbstractLeafData& LeafData, VPFloat * Payload)
+	{
+		for (int c = 0; c < Stats.GetNumClasses(); ++c)
+			Payload[c] = VPFloat(Stats.GetBins()[c]); // Class counts have the same winner as DecisionForest::Test()
+	});
+	std::vector<VPFloat> Predictions;
+	RunBenchmark("ForestTest/Compiled", uint64_t(NumDataPoints) * Forest.GetNumTrees(), [&]()
+	{
+		Compiled.PredictBatch(*TestDataSet, Predictions, 0, NumDataPoints, g_NumThreads);
+	});
+
+	std::ofstream OutputFile(g_OutputFName);
+	WriteJSON(OutputFile);
+	if (!OutputFile.good())
+	{
+		std::cout << "[ WARN ]: Unable to write results to " << g_OutputFName << "." << std::endl;
+		return -2;
+	}
+	std::cout << "[ INFO ]: Results written to " << g_OutputFName << " (objective checksum " << ObjVal << ")." << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,155 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <cstdlib>
+#include <algorithm>
+
+#include "Kaadugal.hpp"
+#include "DenseDataSet.hpp"
+#include "DenseStatistics.hpp"
+#include "AxisAlignedFeatureResponse.hpp"
+#include "DecisionForestBuilder.hpp"
+
+using namespace Kaadugal;
+
+typedef DecisionForest<AxisAlignedFeatureResponse, DenseHistogramStats, AbstractLeafData> Forest;
+
+const int g_NumFeatures = 8;
+const int g_NumClasses = 4;
+const uint64_t g_Seed = 42;
+
+// Classes depend on the first features. Same as microbench
+std::shared_ptr<DenseDataSet> MakeDataSet(int NumDataPoints, uint64_t Seed)
+{
+	std::mt19937 RNG(static_cast<uint32_t>(Seed));
+	std::uniform_real_distribution<VPFloat> ValueDist(0.0, 1.0);
+	std::uniform_int_distribution<int> NoiseDist(0, 9);
+	auto DataSet = std::make_shared<DenseDataSet>(NumDataPoints, g_NumFeatures);
+	DataSet->SetNumClasses(g_NumClasses);
+	for (int i = 0; i < NumDataPoints; ++i)
+	{
+		VPFloat Sum = 0.0;
+		for (int f = 0; f < g_NumFeatures; ++f)
+		{
+			VPFloat Value = ValueDist(RNG);
+			DataSet->SetFeature(i, f, Value);
+			if (f < 3)
+				Sum += Value;
+		}
+		int Label = std::min(g_NumClasses - 1, int(Sum / 3.0 * g_NumClasses));
+		if (NoiseDist(RNG) == 0)
+			Label = (Label + 1) % g_NumClasses;
+		DataSet->SetLabel(i, Label);
+	}
+
+	return DataSet;
+}
+
+bool isSame(const DenseHistogramStats& Stats, const DenseHistogramStats& Expected)
+{
+	return Stats.GetNumDataPoints() == Expected.GetNumDataPoints() && Stats.GetBins() == Expected.GetBins();
+}
+
+// Tests one forest from many threads at once and compares every result with testing on one thread. Build with
+// -DKAADUGAL_SANITIZE_THREAD=ON to also check for data races with ThreadSanitizer. The forest is saved and loaded
+// first, like a forest that serves requests. Threads are std::threads and batch testing uses one OpenMP thread
+// per call, since OpenMP runtimes are usually not instrumented for ThreadSanitizer
+int main(int argc, char * argv[])
+{
+	if (argc > 4 || (argc > 1 && std::string(argv[1]) == "-h"))
+	{
+		std::cout << "[ USAGE ]: " << argv[0] << " [NUM_DATAPOINTS] [NUM_TREES] [NUM_THREADS]" << std::endl;
+		return -1;
+	}
+	int NumDataPoints = argc > 1 ? std::atoi(argv[1]) : 4000;
+	int NumTrees = argc > 2 ? std::atoi(argv[2]) : 8;
+	int NumThreads = argc > 3 ? std::atoi(argv[3]) : 8;
+	if (NumDataPoints < 100 || NumTrees <= 0 || NumThreads <= 0)
+	{
+		std::cout << "[ WARN ]: Need at least 100 data points and positive other arguments." << std::endl;
+		return -1;
+	}
+
+	std::shared_ptr<DenseDataSet> DataSet = MakeDataSet(NumDataPoints, g_Seed);
+	ForestBuilderParameters Parameters(NumTrees, 10, 10, 20, 0.0, TrainMethod::DFS, 1, 10, SplitSearch::Bucketed, -1, 16384, false, 65536, 1024, g_Seed);
+	DecisionForestBuilder<AxisAlignedFeatureResponse, DenseHistogramStats, AbstractLeafData> Builder(Parameters);
+	std::stringstream ForestStream;
+	{
+		std::ostringstream Sink;
+		std::streambuf * Original = std::cout.rdbuf(Sink.rdbuf());
+		Builder.Build(DataSet);
+		Builder.GetForest().Serialize(ForestStream);
+		std::cout.rdbuf(Original);
+	}
+	Forest LoadedForest;
+	{
+		std::ostringstream Sink;
+		std::streambuf * Original = std::cout.rdbuf(Sink.rdbuf());
+		LoadedForest.Deserialize(ForestStream);
+		std::cout.rdbuf(Original);
+	}
+	const Forest& SharedForest = LoadedForest; // Testing only needs const access
+
+	// Expected results from one thread
+	std::shared_ptr<DenseDataSet> TestDataSet = MakeDataSet(NumDataPoints, g_Seed + 1);
+	std::vector<DenseHistogramStats> Expected(NumDataPoints);
+	SharedForest.TestBatch(*TestDataSet, Expected, 0, NumDataPoints, nullptr, 1);
+	std::vector<DenseHistogramStats> ExpectedEarlyExit(NumDataPoints);
+	std::vector<int> ExpectedNumTrees;
+	SharedForest.TestBatchEarlyExit(*TestDataSet, ExpectedEarlyExit, ExpectedNumTrees, 0.0, 0, NumDataPoints, 1);
+	int NumChangedDecisions = 0; // Early exit with margin 0 must decide like testing with all trees
+	for (int i = 0; i < NumDataPoints; ++i)
+		NumChangedDecisions += ExpectedEarlyExit[i].FindWinnerLabelIndex() != Expected[i].FindWinnerLabelIndex() ? 1 : 0;
+	if (NumChangedDecisions > 0)
+	{
+		std::cout << "[ ERROR ]: Early exit with margin 0 changed " << NumChangedDecisions << " decisions of TestBatch()." << std::endl;
+		return -2;
+	}
+
+	// Every thread tests all data points, one at a time and in batches, starting at a different data point
+	std::atomic<int> NumMismatches(0);
+	std::vector<std::thread> Threads;
+	for (int t = 0; t < NumThreads; ++t)
+	{
+		Threads.push_back(std::thread([&, t]()
+		{
+			int Mismatches = 0;
+			int Offset = int(int64_t(t) * NumDataPoints / NumThreads);
+			for (int k = 0; k < NumDataPoints; ++k)
+			{
+				int i = (Offset + k) % NumDataPoints;
+				auto Stats = std::make_shared<DenseHistogramStats>();
+				SharedForest.Test(TestDataSet->Get(i), Stats);
+				Mismatches += isSame(*Stats, Expected[i]) ? 0 : 1;
+			}
+
+			std::vector<DenseHistogramStats> Results(NumDataPoints);
+			SharedForest.TestBatch(*TestDataSet, Results, 0, NumDataPoints, nullptr, 1);
+			std::vector<DenseHistogramStats> EarlyExitResults(NumDataPoints);
+			std::vector<int> NumTreesEvaluated;
+			SharedForest.TestBatchEarlyExit(*TestDataSet, EarlyExitResults, NumTreesEvaluated, 0.0, 0, NumDataPoints, 1);
+			for (int i = 0; i < NumDataPoints; ++i)
+			{
+				Mismatches += isSame(Results[i], Expected[i]) ? 0 : 1;
+				Mismatches += isSame(EarlyExitResults[i], ExpectedEarlyExit[i]) && NumTreesEvaluated[i] == ExpectedNumTrees[i] ? 0 : 1;
+			}
+			NumMismatches += Mismatches;
+		}));
+	}
+	for (std::thread& Thread : Threads)
+		Thread.join();
+
+	if (NumMismatches > 0)
+	{
+		std::cout << "[ ERROR ]: " << NumMismatches << " results of testing from " << NumThreads << " threads differ from testing on one thread." << std::endl;
+		return -2;
+	}
+	std::cout << "[ INFO ]: " << NumThreads << " threads tested " << NumDataPoints << " data points on one forest of " << SharedForest.GetNumTrees()
+		<< " trees. All results are the same as on one thread." << std::endl;
+
+	return 0;
+}
@@ -6,34 +6,43 @@
 #include "Randomizer.hpp"
 
 // 2D axis-aligned feature response
-class AAFeatureResponse2D : public Kaadugal::AbstractFeatureResponse
+class AAFeatureResponse2D : public Kaadugal::StaticFeatureResponse<AAFeatureResponse2D, Kaadugal::DenseDataSet>
 {
 private:
 	// NOTE: If new members are added, remember to add them to serialize/deserialize
-	std::uniform_int_distribution<int> m_UniDist; // Both inclusive
+	// Only the trained parameters are members so that testing does not touch any other state
 	int m_SelectedFeature;
 
-	int SelectFeature(void)
+public:
+	AAFeatureResponse2D(void)
+		: m_SelectedFeature(0) // The feature is selected by Randomize() during training
 	{
-		return m_UniDist(Kaadugal::Randomizer::Get().GetRNG());
+
 	};
 
-public:
-	AAFeatureResponse2D(void)
-		: m_UniDist(0, 1) /* Both inclusive */
+	// Called through Randomize(), which checks that the data is a DenseDataSet (i.e. a PointSet2D)
+	void RandomizeResponse(const Kaadugal::DenseDataSet& DataSet)
 	{
-		m_SelectedFeature = SelectFeature();
+		std::uniform_int_distribution<int> UniDist(0, 1); // Both inclusive
+		m_SelectedFeature = UniDist(Kaadugal::Randomizer::Get().GetRNG());
 	};
 
-	int GetSelectedFeature(void) { return m_SelectedFeature; };
+	int GetSelectedFeature(void) const { return m_SelectedFeature; };
+	virtual int GetFeatureColumn(void) const override { return m_SelectedFeature; }; // Features are (x, y)
 
-	virtual Kaadugal::VPFloat GetResponse(const std::shared_ptr<Kaadugal::AbstractDataPoint>& DataPoint) override
+	virtual Kaadugal::VPFloat GetResponse(const std::shared_ptr<Kaadugal::AbstractDataPoint>& DataPoint) const override
 	{
 		std::shared_ptr<Point2D> PointIn2D = std::dynamic_pointer_cast<Point2D>(DataPoint);
 
 		return (m_SelectedFeature == 0 ? PointIn2D->m_x : PointIn2D->m_y);
 	};
 
+	// Reads the column of PointSet2D directly without creating a point
+	inline Kaadugal::VPFloat ComputeResponse(const Kaadugal::DenseDataSet& DataSet, uint64_t DataPointIndex) const
+	{
+		return DataSet.GetFeature(DataPointIndex, m_SelectedFeature);
+	};
+
 	virtual void Serialize(std::ostream& OutputStream) const override
 	{
 		OutputStream.write((const char *)(&m_SelectedFeature), sizeof(int));
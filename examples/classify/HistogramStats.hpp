@@ -5,10 +5,11 @@
 #include <algorithm>
 
 #include "Abstract/AbstractStatistics.hpp"
+#include "DenseDataSet.hpp"
 
 // Supports histogram-like statistics for arbitrary number of classes
 class HistogramStats 
-	: public Kaadugal::AbstractStatistics
+	: public Kaadugal::StaticStatistics<HistogramStats, Kaadugal::DenseDataSet>
 {
 protected:
 	// NOTE: If new members are added, remember to add them to serialize/deserialize
@@ -63,14 +64,12 @@ public:
 	const int& GetNumDataPoints(void) const { return m_nDataPoints; };
 	const std::vector<int>& GetBins(void) const { return m_Bins; };
 
-	virtual void Aggregate(std::shared_ptr<Kaadugal::DataSetIndex> DataSetIdx) override
+	void AggregateStats(const Kaadugal::DenseDataSet& DataSet, const int * Index, int Size)
 	{
-		std::shared_ptr<PointSet2D> DerivedData = std::dynamic_pointer_cast<PointSet2D>(DataSetIdx->GetDataSet());
-		m_nClasses = DerivedData->GetNumClasses();
-		m_Bins.clear(); // TODO: Is this necessary and, if so, is it efficient?
-		m_Bins.resize(m_nClasses, 0);
+		m_nClasses = DataSet.GetNumClasses();
+		m_Bins.assign(m_nClasses, 0);
 
-		m_nDataPoints = DataSetIdx->Size(); // NOTE: Careful, if you take size from DerivedData, it will be wrong
+		m_nDataPoints = Size; // NOTE: Careful, if you take size from DataSet, it will be wrong
 		// NOTE: m_nDataPoints can be 0. This is fine. For this entropy would also be 0, as will probabilities, etc.
 		// if(m_nDataPoints <= 0)
 		// {
@@ -80,7 +79,7 @@ public:
 
 		for (int i = 0; i < m_nDataPoints; ++i)
 		{
-			int DataLabel = std::dynamic_pointer_cast<Point2D>(DataSetIdx->GetDataPoint(i))->GetLabel();
+			int DataLabel = DataSet.GetLabel(Index[i]);
 			if (DataLabel > m_nClasses - 1)
 				throw std::runtime_error("Data point label is inconsistent with number of classes. Exiting.");
 
@@ -90,32 +89,69 @@ public:
 		m_isAggregated = true;
 	};
 
-	virtual void Merge(std::shared_ptr<AbstractStatistics> OtherStats) override
+	void AccumulateStats(const Kaadugal::DenseDataSet& DataSet, uint64_t DataPointIndex)
+	{
+		int DataLabel = DataSet.GetLabel(DataPointIndex);
+		if (DataLabel > m_nClasses - 1)
+			throw std::runtime_error("Data point label is inconsistent with number of classes. Exiting.");
+
+		m_Bins[DataLabel]++;
+		m_nDataPoints++;
+		m_isAggregated = true;
+	};
+
+	void MergeStats(const HistogramStats& OtherStats)
 	{
-		std::shared_ptr<HistogramStats> DerivedOtherStats = std::dynamic_pointer_cast<HistogramStats>(OtherStats);
-		if (DerivedOtherStats->GetNumClasses() != GetNumClasses())
+		if (OtherStats.GetNumClasses() != GetNumClasses())
 			throw std::runtime_error("Cannot merge statistics. Number of classes don't match. Exiting.");
 
-		// std::cout << DerivedOtherStats->GetNumClasses() << std::endl;
-		// std::cout << GetNumClasses() << std::endl;
-		// if(isAggregated() != true || DerivedOtherStats->isAggregated() != true)
+		// if(isAggregated() != true || OtherStats.isAggregated() != true)
 		//     throw std::runtime_error("Cannot merge statistics. One of them is not aggregated yet. Exiting.");
 
-		if (DerivedOtherStats == nullptr)
-			throw std::runtime_error("Incoming statistics is null. Please check input. Exiting.");
+		m_nDataPoints += OtherStats.GetNumDataPoints();
+		for (int i = 0; i < m_nClasses; ++i)
+			m_Bins[i] += OtherStats.GetBins()[i];
 
-		m_nDataPoints += DerivedOtherStats->GetNumDataPoints();
+		m_isAggregated = true;
+	};
+
+	bool SubtractStats(const HistogramStats& OtherStats)
+	{
+		if (OtherStats.GetNumClasses() != GetNumClasses())
+			return false;
+
+		m_nDataPoints -= OtherStats.GetNumDataPoints();
 		for (int i = 0; i < m_nClasses; ++i)
-			m_Bins[i] += DerivedOtherStats->GetBins()[i];
+			m_Bins[i] -= OtherStats.GetBins()[i];
+
+		return true;
+	};
 
+	virtual bool SetLabelCounts(const int * Counts, int NumClasses) override
+	{
+		m_nClasses = NumClasses;
+		m_Bins.assign(Counts, Counts + NumClasses);
+		m_nDataPoints = 0;
+		for (int i = 0; i < NumClasses; ++i)
+			m_nDataPoints += Counts[i];
 		m_isAggregated = true;
+
+		return true;
 	};
 
-	void Reset(void) // Reset bin counts to 0
+	virtual const int * GetLabelCounts(int& NumClasses) const override
 	{
-		m_Bins.clear();
+		NumClasses = m_nClasses;
+		return m_Bins.empty() ? nullptr : m_Bins.data();
+	};
 
+	virtual bool Reset(void) override // Reset bin counts to 0
+	{
+		std::fill(m_Bins.begin(), m_Bins.end(), 0);
 		m_nDataPoints = 0;
+		m_isAggregated = true;
+
+		return true;
 	};
 
 	inline Kaadugal::VPFloat GetProbability(int ClassLabel) const
@@ -7,8 +7,11 @@
 #include <ostream>
 #include <string>
 #include <set>
+#include <vector>
+#include <algorithm>
 
-#include "Abstract/AbstractDataSet.hpp"
+#include "DenseDataSet.hpp"
+#include "DataSetFile.hpp"
 
 class Point2D
 	: public Kaadugal::AbstractDataPoint
@@ -54,15 +57,34 @@ public:
 	};
 };
 
-class PointSet2D : public Kaadugal::AbstractDataSet
+// Points are stored in the columns of a DenseDataSet (x is feature 0, y is feature 1) and loaded either from a text
+// data file or from a binary dataset file (see DataSetFile and the convertdataset utility)
+class PointSet2D : public Kaadugal::DenseDataSet
 {
 private:
-	int m_NumClassLabels;
+	bool m_isLabeled; // False if some points have no class label
 
 public:
-	PointSet2D(void) {};
+	PointSet2D(void)
+		: m_isLabeled(false)
+	{
+
+	};
 	PointSet2D(const std::string& DataFileName)
+		: m_isLabeled(false)
 	{
+		if (Kaadugal::DataSetFile::isDataSetFile(DataFileName))
+		{
+			if (Kaadugal::DataSetFile::Load(DataFileName, *this) != Kaadugal::ClassLabels)
+				std::fill(GetLabels(), GetLabels() + m_NumDataPoints, -1);
+			else
+				m_isLabeled = true;
+			if (m_NumFeatures != 2)
+				throw std::runtime_error("Invalid data file. PointSet2D needs 2 features. Exiting.");
+			std::cout << "[ INFO ]: Finished reading input data (Total: " << m_NumDataPoints << "). Total number of classes: " << m_NumClasses << std::endl;
+			return;
+		}
+
 		// This is in human-readable format
 		std::filebuf DataFile;
 		DataFile.open(DataFileName, std::ios::in);
@@ -76,7 +98,15 @@ public:
 			std::cout << "[ WARN ]: Unable to open file: " << DataFileName << std::endl;
 	};
 
-	const int& GetNumClasses(void) { return m_NumClassLabels; };
+	virtual const int * GetLabelData(void) override { return m_isLabeled ? GetLabels() : nullptr; };
+
+	virtual std::shared_ptr<Kaadugal::AbstractDataPoint> Get(uint64_t i) override
+	{
+		if (i >= m_NumDataPoints)
+			return nullptr;
+
+		return std::make_shared<Point2D>(GetFeature(i, 0), GetFeature(i, 1), GetLabel(i));
+	};
 
 	virtual void Serialize(std::ostream& OutputStream) override
 	{
@@ -90,6 +120,7 @@ public:
 		// First Col: x; Second Col: y[, Third Col: Class Label]
 		std::string Line;
 		std::set<int> ClassSet;
+		std::vector<Point2D> Rows;
 		while (std::getline(InputStream, Line))
 		{
 			// Skip empty lines or lines beginning with #
@@ -124,11 +155,20 @@ public:
 				throw std::runtime_error("Invalid data file. Exiting.");
 
 			// std::cout << Row;
-			m_DataPoints.push_back(std::make_shared<Point2D>(Row));
+			Rows.push_back(Row);
+		}
+
+		Resize(Rows.size(), 2);
+		m_isLabeled = true;
+		for (uint64_t i = 0; i < m_NumDataPoints; ++i)
+		{
+			SetFeature(i, 0, Rows[i].m_x);
+			SetFeature(i, 1, Rows[i].m_y);
+			GetLabels()[i] = Rows[i].m_ClassLabel;
+			m_isLabeled = m_isLabeled && Rows[i].m_ClassLabel >= 0;
 		}
-		m_NumClassLabels = ClassSet.size();
-		m_NumDataPoints = m_DataPoints.size();
-		std::cout << "[ INFO ]: Finished reading input data (Total: " << m_NumDataPoints << "). Total number of classes: " << m_NumClassLabels << std::endl;
+		m_NumClasses = ClassSet.size();
+		std::cout << "[ INFO ]: Finished reading input data (Total: " << m_NumDataPoints << "). Total number of classes: " << m_NumClasses << std::endl;
 	};
 };
 
@@ -6,49 +6,88 @@
 #include "PointSet2D.hpp"
 #include "AAFeatureResponse2D.hpp"
 #include "HistogramStats.hpp"
+#include "CompiledForest.hpp"
+#include "ForestShard.hpp"
 
-bool g_isTrainMode;
+std::string g_Mode;
 std::string g_DataFileName;
-PointSet2D g_Point2DData;
+std::shared_ptr<PointSet2D> g_Point2DData;
 
 // Training members
 std::string g_ParamFileName;
 std::string g_OutputForestFName;
+std::string g_ReportFName; // Optional JSON training report
 
 // Testing members
 std::string g_InputForestFName;
+Kaadugal::VPFloat g_EarlyExitMargin = -1.0; // Optional. Test with early exit if not negative (see DecisionForest::TestBatchEarlyExit())
+
+// Compiling members
+std::string g_CompiledForestFName;
+
+// Sharded training members
+int g_ShardIndex = 0;
+int g_NumShards = 1;
+std::string g_OutputShardFName;
 
 void PrintUsage(char * argv[])
 {
-	std::cout << "[ USAGE ]: " << argv[0] << " (train <CONFIG_FILE_PATH> <OUTPUT_FOREST_PATH> | test <INPUT_FOREST_PATH>)  <DATA_FILE>" << std::endl;
+	std::cout << "[ USAGE ]: " << argv[0] << " (train <CONFIG_FILE_PATH> <OUTPUT_FOREST_PATH> | test <INPUT_FOREST_PATH> | testcompiled <COMPILED_FOREST_PATH>)  <DATA_FILE>" << std::endl;
+	std::cout << "[ USAGE ]: " << argv[0] << " train <CONFIG_FILE_PATH> <OUTPUT_FOREST_PATH> <DATA_FILE> <OUTPUT_REPORT_JSON>" << std::endl;
+	std::cout << "[ USAGE ]: " << argv[0] << " test <INPUT_FOREST_PATH> <DATA_FILE> <EARLY_EXIT_CONFIDENCE_MARGIN>" << std::endl;
+	std::cout << "[ USAGE ]: " << argv[0] << " compile <INPUT_FOREST_PATH> <OUTPUT_COMPILED_FOREST_PATH>" << std::endl;
+	std::cout << "[ USAGE ]: " << argv[0] << " trainshard <CONFIG_FILE_PATH> <SHARD_INDEX> <NUM_SHARDS> <OUTPUT_SHARD_PATH> <DATA_FILE>" << std::endl;
 }
 
 bool ParseArguments(int argc, char * argv[])
 {
-	if (argc < 4 || argc > 5)
+	if (argc < 4 || argc > 7)
 	{
 		PrintUsage(argv);
 		return false;
 	}
-	if (std::string(argv[1]) != "train" && std::string(argv[1]) != "test")
+	g_Mode = argv[1];
+	if (g_Mode != "train" && g_Mode != "test" && g_Mode != "compile" && g_Mode != "testcompiled" && g_Mode != "trainshard")
 	{
 		PrintUsage(argv);
 		return false;
 	}
 
-	if (std::string(argv[1]) == "train" && argc == 5)
+	if (g_Mode == "train" && (argc == 5 || argc == 6))
 	{
 		g_ParamFileName = argv[2];
 		g_OutputForestFName = argv[3];
 		g_DataFileName = argv[4];
-		g_isTrainMode = true;
+		g_ReportFName = argc == 6 ? argv[5] : "";
+		return true;
+	}
+	if (g_Mode == "trainshard" && argc == 7)
+	{
+		g_ParamFileName = argv[2];
+		g_ShardIndex = std::atoi(argv[3]);
+		g_NumShards = std::atoi(argv[4]);
+		g_OutputShardFName = argv[5];
+		g_DataFileName = argv[6];
+		if (g_NumShards >= 1 && g_ShardIndex >= 0 && g_ShardIndex < g_NumShards)
+			return true;
+	}
+	if (g_Mode == "test" && (argc == 4 || argc == 5))
+	{
+		g_InputForestFName = argv[2];
+		g_DataFileName = argv[3];
+		g_EarlyExitMargin = argc == 5 ? std::atof(argv[4]) : -1.0;
 		return true;
 	}
-	if (std::string(argv[1]) == "test" && argc == 4)
+	if (g_Mode == "compile" && argc == 4)
 	{
 		g_InputForestFName = argv[2];
+		g_CompiledForestFName = argv[3];
+		return true;
+	}
+	if (g_Mode == "testcompiled" && argc == 4)
+	{
+		g_CompiledForestFName = argv[2];
 		g_DataFileName = argv[3];
-		g_isTrainMode = false;
 		return true;
 	}
 	PrintUsage(argv);
@@ -59,7 +98,7 @@ int Train(void)
 {
 	// Load parameters from file
 	Kaadugal::ForestBuilderParameters ForestParams(g_ParamFileName);
-	std::shared_ptr<Kaadugal::AbstractDataSet> Point2DDataPtr = std::make_shared<PointSet2D>(g_Point2DData);
+	std::shared_ptr<Kaadugal::AbstractDataSet> Point2DDataPtr = g_Point2DData;
 
 	// Build forest from training data
 	if (ForestParams.m_NumTrees == 1) // We need to build only one tree
@@ -68,6 +107,14 @@ int Train(void)
 		if (TreeBuilder.Build(Point2DDataPtr) == true)
 		{
 			std::cout << "One tree of the random forest successfully trained." << std::endl;
+			if (g_ReportFName.empty() == false)
+			{
+				Kaadugal::TrainingReport Report;
+				Report.m_Time = TreeBuilder.GetReport().m_Time;
+				Report.m_NumThreads = TreeBuilder.GetReport().m_NumThreads;
+				Report.m_Trees.push_back(TreeBuilder.GetReport());
+				Report.SaveJSON(g_ReportFName);
+			}
 
 			std::cout << "Writing tree to file..." << std::endl;
 			std::filebuf FileBuf;
@@ -91,6 +138,8 @@ int Train(void)
 		if (ForestBuilder.Build(Point2DDataPtr) == true)
 		{
 			std::cout << "Random Forest successfully trained." << std::endl;
+			if (g_ReportFName.empty() == false)
+				ForestBuilder.GetReport().SaveJSON(g_ReportFName);
 
 			std::cout << "Writing forest to file..." << std::endl;
 			std::filebuf FileBuf;
@@ -112,9 +161,39 @@ int Train(void)
 	return 0;
 }
 
-int Test(void)
+// Trains this shard's range of the trees and saves them as a forest shard. Merge the shards with the mergeshards
+// utility or let the shardtrain utility run all shards and merge them
+int TrainShard(void)
+{
+	Kaadugal::ForestBuilderParameters ForestParams(g_ParamFileName);
+	int FirstTree = 0, EndTree = 0;
+	Kaadugal::ForestShard::GetTreeRange(ForestParams.m_NumTrees, g_ShardIndex, g_NumShards, FirstTree, EndTree);
+	std::cout << "[ INFO ]: Training trees [" << FirstTree << ", " << EndTree << ") as shard " << g_ShardIndex << " of " << g_NumShards << "." << std::endl;
+	if (ForestParams.m_Seed == 0)
+		std::cout << "[ WARN ]: No Seed in config. Trees of this shard cannot be reproduced." << std::endl;
+	if (FirstTree >= EndTree)
+	{
+		std::cout << "[ WARN ]: More shards than trees. Nothing to train." << std::endl;
+		return -2;
+	}
+
+	Kaadugal::DecisionForestBuilder<AAFeatureResponse2D, HistogramStats> ForestBuilder(ForestParams);
+	if (ForestBuilder.Build(g_Point2DData, FirstTree, EndTree) == false)
+	{
+		std::cout << "[ ERROR ]: Unable to train forest shard." << std::endl;
+		return -2;
+	}
+
+	std::cout << "Writing forest shard to file..." << std::endl;
+	if (Kaadugal::ForestShard::Save(g_OutputShardFName, ForestBuilder.GetForest(), ForestBuilder.GetTreeIndices(), ForestParams, g_Point2DData->Size()) == false)
+		return -2;
+	std::cout << "Done." << std::endl;
+
+	return 0;
+}
+
+bool LoadForest(Kaadugal::DecisionForest<AAFeatureResponse2D, HistogramStats, Kaadugal::AbstractLeafData>& LoadedForest)
 {
-	Kaadugal::DecisionForest<AAFeatureResponse2D, HistogramStats, Kaadugal::AbstractLeafData> LoadedForest;
 	std::cout << "Loading forest from file..." << std::endl;
 	std::filebuf FileBuf;
 	FileBuf.open(g_InputForestFName, std::ios::in | std::ios::binary);
@@ -124,24 +203,93 @@ int Test(void)
 		LoadedForest.Deserialize(InForest);
 		FileBuf.close();
 		std::cout << "Done." << std::endl;
+		return true;
+	}
+
+	std::cout << "[ WARN ]: Unable to open forest file. Exiting." << std::endl;
+	return false;
+}
+
+int Test(void)
+{
+	Kaadugal::DecisionForest<AAFeatureResponse2D, HistogramStats, Kaadugal::AbstractLeafData> LoadedForest;
+	if (LoadForest(LoadedForest) == false)
+		return -2;
+
+	std::cout << "Now testing trained forest with data..." << std::endl;
+	int SuccessCtr = 0;
+	int DataSize = g_Point2DData->Size();
+	std::vector<HistogramStats> FinalStats(DataSize, HistogramStats(4));
+	if (g_EarlyExitMargin >= 0.0)
+	{
+		// A margin of 0 only stops once the remaining trees cannot change the winning class
+		std::vector<int> NumTreesEvaluated;
+		LoadedForest.TestBatchEarlyExit(*g_Point2DData, FinalStats, NumTreesEvaluated, g_EarlyExitMargin);
+		double SumTrees = 0.0;
+		for (int NumTrees : NumTreesEvaluated)
+			SumTrees += NumTrees;
+		std::cout << "Average number of trees evaluated: " << SumTrees / std::max(1, DataSize) << " of " << LoadedForest.GetNumTrees() << std::endl;
 	}
 	else
+		LoadedForest.TestBatch(*g_Point2DData, FinalStats);
+	for (int i = 0; i < DataSize; ++i)
+	{
+		// std::cout << "Winner: " << FinalStats[i].FindWinnerLabelIndex() << std::endl;
+		if (FinalStats[i].FindWinnerLabelIndex() == g_Point2DData->GetLabel(i))
+			SuccessCtr++;
+	}
+	std::cout << "Classification Accuracy: " << float(SuccessCtr) / float(DataSize) * 100.0 << std::endl;
+
+	return 0;
+}
+
+// Converts a forest in the stream format to the memory-mapped compiled format. Leaf payloads are class counts, so the
+// average over trees (CompiledForest::Predict()) has the same winner as the merged histograms of DecisionForest::Test()
+int Compile(void)
+{
+	Kaadugal::DecisionForest<AAFeatureResponse2D, HistogramStats, Kaadugal::AbstractLeafData> LoadedForest;
+	if (LoadForest(LoadedForest) == false)
+		return -2;
+	if (LoadedForest.GetNumTrees() <= 0)
 	{
-		std::cout << "[ WARN ]: Unable to open forest file. Exiting." << std::endl;
+		std::cout << "[ WARN ]: Forest has no trees. Exiting." << std::endl;
 		return -2;
 	}
 
-	std::cout << "Now testing trained forest with data..." << std::endl;
+	int NumClasses = LoadedForest.GetTree(0)->GetNode(0).GetStatistics().GetNumClasses();
+	Kaadugal::CompiledForest Compiled;
+	Compiled.Compile(LoadedForest, NumClasses,
+		[NumClasses](const HistogramStats& Stats, const Kaadugal::AbstractLeafData& LeafData, Kaadugal::VPFloat * Payload)
+		{
+			const std::vector<int>& Bins = Stats.GetBins();
+			for (int i = 0; i < std::min(NumClasses, int(Bins.size())); ++i)
+				Payload[i] = Kaadugal::VPFloat(Bins[i]);
+		});
+
+	std::cout << "Writing compiled forest to file..." << std::endl;
+	if (Compiled.Save(g_CompiledForestFName) == false)
+		return -2;
+	std::cout << "Done." << std::endl;
+
+	return 0;
+}
+
+int TestCompiled(void)
+{
+	std::cout << "Mapping compiled forest from file..." << std::endl;
+	Kaadugal::CompiledForest Compiled;
+	Compiled.Load(g_CompiledForestFName);
+	std::cout << "Done. " << Compiled.GetNumTrees() << " trees, " << Compiled.GetNumNodes() << " nodes." << std::endl;
+
+	std::cout << "Now testing compiled forest with data..." << std::endl;
 	int SuccessCtr = 0;
-	int DataSize = g_Point2DData.Size();
+	int DataSize = g_Point2DData->Size();
+	std::vector<Kaadugal::VPFloat> Counts(Compiled.GetPayloadSize()); // Average class counts of the leaves (see Compile())
 	for (int i = 0; i < DataSize; ++i)
 	{
-		std::shared_ptr<Kaadugal::AbstractDataPoint> TestPointPtr = std::dynamic_pointer_cast<Kaadugal::AbstractDataPoint>(g_Point2DData.Get(i));
-		std::shared_ptr<HistogramStats> FinalStatsPtr = std::make_shared<HistogramStats>(HistogramStats(4));
-		LoadedForest.Test(TestPointPtr, FinalStatsPtr);
-		// std::cout << "Winner: " << FinalStatsPtr->FindWinnerLabelIndex() << std::endl;
-		// std::cout << "Actual: " << std::dynamic_pointer_cast<Point2D>(g_Point2DData.Get(DataPtNum))->GetLabel() << std::endl;
-		if (FinalStatsPtr->FindWinnerLabelIndex() == std::dynamic_pointer_cast<Point2D>(g_Point2DData.Get(i))->GetLabel())
+		Kaadugal::VPFloat Features[] = { g_Point2DData->GetFeature(i, 0), g_Point2DData->GetFeature(i, 1) };
+		Compiled.Predict(Features, Counts.data());
+		if (std::distance(Counts.begin(), std::max_element(Counts.begin(), Counts.end())) == g_Point2DData->GetLabel(i))
 			SuccessCtr++;
 	}
 	std::cout << "Classification Accuracy: " << float(SuccessCtr) / float(DataSize) * 100.0 << std::endl;
@@ -165,9 +313,16 @@ int main(int argc, char * argv[])
 	if (ParseArguments(argc, argv) == false)
 		return -1;
 
-	g_Point2DData = PointSet2D(g_DataFileName);
-	if (g_isTrainMode)
+	if (g_Mode == "compile")
+		return Compile();
+
+	g_Point2DData = std::make_shared<PointSet2D>(g_DataFileName); // Text or binary (see convertdataset)
+	if (g_Mode == "train")
 		return Train();
+	else if (g_Mode == "trainshard")
+		return TrainShard();
+	else if (g_Mode == "testcompiled")
+		return TestCompiled();
 	else
 		return Test();
 
@@ -9,24 +9,25 @@ class AAFeatureResponse2D : public Kaadugal::AbstractFeatureResponse
 {
 private:
 	// NOTE: If new members are added, remember to add them to serialize/deserialize
-	std::uniform_int_distribution<int> m_UniDist; // Both inclusive
+	// Only the trained parameters are members so that testing does not touch any other state
 	int m_SelectedFeature;
 
-	int SelectFeature(void)
+	static int SelectFeature(void)
 	{
-		return m_UniDist(Kaadugal::Randomizer::Get().GetRNG());
+		std::uniform_int_distribution<int> UniDist(0, 1); // Both inclusive
+		return UniDist(Kaadugal::Randomizer::Get().GetRNG());
 	};
 
 public:
 	AAFeatureResponse2D(void)
-		: m_UniDist(0, 1) /* Both inclusive */
 	{
 		m_SelectedFeature = SelectFeature();
 	};
 
-	int GetSelectedFeature(void) { return m_SelectedFeature; };
+	int GetSelectedFeature(void) const { return m_SelectedFeature; };
+	virtual int GetFeatureColumn(void) const override { return m_SelectedFeature; }; // Features are (x, y)
 
-	virtual Kaadugal::VPFloat GetResponse(const std::shared_ptr<Kaadugal::AbstractDataPoint>& DataPoint) override
+	virtual Kaadugal::VPFloat GetResponse(const std::shared_ptr<Kaadugal::AbstractDataPoint>& DataPoint) const override
 	{
 		auto PointIn2D = std::dynamic_pointer_cast<Point2DRegress>(DataPoint);
 
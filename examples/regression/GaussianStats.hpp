@@ -187,12 +187,14 @@ public:
 		m_isAggregated = true;
 	};
 
-	void Reset(void)
+	virtual bool Reset(void) override
 	{
-		m_MeanParams = cv::Mat();
-		m_CovarianceMatrix = cv::Mat();
-
+		m_MeanParams.setTo(cv::Scalar(0));
+		m_CovarianceMatrix.setTo(cv::Scalar(0));
 		m_nDataPoints = 0;
+		m_isAggregated = true;
+
+		return true;
 	};
 
 	inline Kaadugal::VPFloat GetEntropy(void)
@@ -110,11 +110,13 @@ public:
 	m_isAggregated = true;
     };
 
-    void Reset(void) // Reset bin counts to 0
+    virtual bool Reset(void) override // Reset bin counts to 0
     {
-	m_DimClassBins.clear();
-	
+	std::fill(m_DimClassBins.begin(), m_DimClassBins.end(), 0);
 	m_nDataPoints = 0;
+	m_isAggregated = true;
+
+	return true;
     };
 
     inline Kaadugal::VPFloat GetProbability(int ClassLabel) const
@@ -5,6 +5,8 @@
 #include <ostream>
 #include <iostream>
 #include <istream>
+#include <vector>
+#include <cstdint>
 
 #include "KaadugalDefines.hpp"
 
@@ -35,7 +37,32 @@ namespace Kaadugal
 
 			return m_DataPoints[i];
 		};
-		virtual void Special(int NodeIndex = 0, const std::vector<int>& Index = std::vector<int>())
+
+		// Optional support for histogram-based split search (SplitSearch: Histogram) with axis-aligned feature responses
+		// Quantize() bins every feature into at most MaxBins (<= 256) bins once. Returns false if not supported
+		virtual bool Quantize(int MaxBins = 256) { return false; };
+		// Bin of Feature for every data point, nullptr if not quantized. Bin b holds the values in (Edges[b - 1], Edges[b]]
+		// with Edges from GetBinEdges(), so Value > Edges[j] if and only if Bin > j
+		virtual const uint8_t * GetBinnedFeature(int Feature) { return nullptr; };
+		virtual const std::vector<VPFloat> * GetBinEdges(int Feature) { return nullptr; };
+
+		// Optional contiguous class labels (0 to GetNumLabelClasses() - 1) of all data points for classification
+		// Lets the builder count labels with the kernels in LabelCounts.hpp (see AbstractStatistics::SetLabelCounts())
+		virtual const int * GetLabelData(void) { return nullptr; };
+		virtual int GetNumLabelClasses(void) { return 0; };
+
+		// Optional support for datasets that do not fit in memory (e.g. MappedDataSet). Breadth-first and hybrid training
+		// read them in chunks of consecutive data points and release every chunk after use so that the resident data
+		// stays within ForestBuilderParameters::m_DataMemoryBudget
+		// Bytes of a data point that are read from storage. 0 means the data is in memory
+		virtual uint64_t GetStoredBytesPerDataPoint(void) { return 0; };
+		// Data points [Begin, End) are not needed soon and their memory can be given back
+		virtual void Release(uint64_t Begin, uint64_t End) {};
+		// In-memory copy of the data points in Index (in that order). Returns nullptr if not supported
+		virtual std::shared_ptr<AbstractDataSet> Gather(const std::vector<int>& Index) { return nullptr; };
+
+		// Index points to the IndexSize indices of the data points that reached leaf NodeIndex. They are only valid during the call
+		virtual void Special(int NodeIndex = 0, const int * Index = nullptr, int IndexSize = 0)
 		{
 			std::cout << "[ WARN ]: AbstractDataPoint::doSpecial() - Not implemented." << std::endl; 
 		};
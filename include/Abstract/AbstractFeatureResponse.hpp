@@ -4,6 +4,7 @@
 #include <memory>
 #include <ostream>
 #include <istream>
+#include <stdexcept>
 
 #include "AbstractDataSet.hpp"
 
@@ -12,13 +13,77 @@ namespace Kaadugal
 	class AbstractFeatureResponse
 	{
 	public:
-		virtual VPFloat GetResponse(const std::shared_ptr<AbstractDataPoint>& DataPoint) = 0;
+		// Responses are const and must not change the feature response (e.g. no random state), so that one trained
+		// forest can be tested by many threads at once
+		virtual VPFloat GetResponse(const std::shared_ptr<AbstractDataPoint>& DataPoint) const = 0;
+		// Response of the data point at DataPointIndex in DataSet. This is what training uses
+		// Override for datasets that don't store data point objects (e.g. DenseDataSet) to avoid creating them
+		virtual VPFloat GetResponseAt(AbstractDataSet& DataSet, uint64_t DataPointIndex) const { return GetResponse(DataSet.Get(DataPointIndex)); };
+		// Responses of the data points Index[0, Size) of DataSet. Training calls this once per candidate and node
+		virtual void GetResponses(AbstractDataSet& DataSet, const int * Index, int Size, VPFloat * Responses) const
+		{
+			for (int k = 0; k < Size; ++k)
+				Responses[k] = GetResponseAt(DataSet, Index[k]);
+		};
+		// Called on each new candidate during training. Can be used to pick random parameters that depend on the
+		// dataset (e.g. the number of features). Responses that randomize themselves when constructed need not override
+		virtual void Randomize(AbstractDataSet& DataSet) {};
+		// False if responses cannot be computed on DataSet (e.g. it is not the type of dataset they were made for)
+		virtual bool isDataSetSupported(const AbstractDataSet& DataSet) const { return true; };
+		// For axis-aligned responses, i.e. the response is the value of one feature, the index of that feature
+		// -1 otherwise. Needed for compiling a forest for fast inference (see CompiledForest)
+		virtual int GetFeatureColumn(void) const { return -1; };
 
 		virtual void Serialize(std::ostream& OutputStream) const = 0;
 		virtual void Deserialize(std::istream& InputStream) = 0;
 
 		virtual void Special(void) {};
 	};
+
+	// Feature response bound to datasets of type D at compile time (CRTP). Derived implements
+	//     VPFloat ComputeResponse(const D& DataSet, uint64_t DataPointIndex) const
+	// which replaces GetResponseAt(), and optionally
+	//     void RandomizeResponse(const D& DataSet)
+	// which replaces Randomize(). The overrides below are final so the builders, which know the type of their
+	// feature responses, call ComputeResponse() without a virtual call and can inline it into the split search loops
+	// NOTE: DataSet must be a D. This is not checked for every data point. Randomize() checks it once per training
+	// candidate and batch testing once per batch (see isDataSetSupported())
+	template<class Derived, class D>
+	class StaticFeatureResponse : public AbstractFeatureResponse
+	{
+	public:
+		typedef D DataSetType;
+
+		virtual void Randomize(AbstractDataSet& DataSet) override final
+		{
+			const D * Data = dynamic_cast<const D *>(&DataSet);
+			if (Data == nullptr)
+				throw std::runtime_error("Feature response cannot be trained with this type of dataset. Exiting.");
+
+			static_cast<Derived *>(this)->RandomizeResponse(*Data);
+		};
+
+		// Nothing to randomize by default, e.g. for responses that randomize themselves when constructed
+		void RandomizeResponse(const D& DataSet) {};
+
+		virtual bool isDataSetSupported(const AbstractDataSet& DataSet) const override final
+		{
+			return dynamic_cast<const D *>(&DataSet) != nullptr;
+		};
+
+		virtual VPFloat GetResponseAt(AbstractDataSet& DataSet, uint64_t DataPointIndex) const override final
+		{
+			return static_cast<const Derived *>(this)->ComputeResponse(static_cast<const D&>(DataSet), DataPointIndex);
+		};
+
+		virtual void GetResponses(AbstractDataSet& DataSet, const int * Index, int Size, VPFloat * Responses) const override final
+		{
+			const Derived& Response = *static_cast<const Derived *>(this);
+			const D& Data = static_cast<const D&>(DataSet);
+			for (int k = 0; k < Size; ++k)
+				Responses[k] = Response.ComputeResponse(Data, Index[k]);
+		};
+	};
 } // namespace Kaadugal
 
 #endif // _ABSTRACTFEATURERESPONSE_HPP_
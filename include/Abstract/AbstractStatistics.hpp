@@ -4,6 +4,8 @@
 #include <memory>
 #include <ostream>
 #include <istream>
+#include <stdexcept>
+#include <type_traits>
 
 #include "DataSetIndex.hpp"
 
@@ -22,6 +24,37 @@ namespace Kaadugal
 
 		virtual void Aggregate(std::shared_ptr<DataSetIndex> DataSetIdx) = 0;
 		virtual void Merge(std::shared_ptr<AbstractStatistics> OtherStats) = 0; // Merging two stats together
+		// Adds a single data point to statistics that are already set up (e.g. aggregated over an empty DataSetIndex)
+		// Optional. Needed by the breadth-first builder which streams over the data with per-node counters
+		virtual void Accumulate(AbstractDataSet& DataSet, uint64_t DataPointIndex)
+		{
+			throw std::runtime_error("Accumulate() is not implemented for these statistics. Use depth-first training instead.");
+		};
+		// Removes OtherStats, which were aggregated over a subset of the data of these statistics
+		// Optional. Returns false if not supported. The builder then aggregates both children instead of
+		// aggregating the smaller one and subtracting it from the parent
+		virtual bool Subtract(std::shared_ptr<AbstractStatistics> OtherStats)
+		{
+			return false;
+		};
+		// Sets the statistics from class counts (NumClasses entries) of the labels from AbstractDataSet::GetLabelData()
+		// Optional. Returns false if not supported. Only label histograms can support this
+		virtual bool SetLabelCounts(const int * Counts, int NumClasses)
+		{
+			return false;
+		};
+		// Clears the statistics to those of no data points in place, keeping their storage and shape (e.g. the number of classes)
+		// Optional. Returns false if not supported. The builder then assigns statistics aggregated over no data points
+		virtual bool Reset(void)
+		{
+			return false;
+		};
+		// Class counts (NumClasses is set) if these statistics are a label histogram, nullptr otherwise
+		// Optional. Lets split objectives (see SplitObjective.hpp) work on counts instead of probabilities
+		virtual const int * GetLabelCounts(int& NumClasses) const
+		{
+			return nullptr;
+		};
 		virtual bool isAggregated(void) { return m_isAggregated; };
 		virtual bool isValid(void) { return m_isValid; };
 
@@ -34,6 +67,89 @@ namespace Kaadugal
 		bool m_isAggregated;
 		bool m_isValid;
 	};
+
+	// Statistics bound to datasets of type D at compile time (CRTP). Derived implements
+	//     void AggregateStats(const D& DataSet, const int * Index, int Size)
+	//     void AccumulateStats(const D& DataSet, uint64_t DataPointIndex)
+	//     void MergeStats(const Derived& OtherStats)
+	//     bool SubtractStats(const Derived& OtherStats) // Return false if not supported
+	// The virtual interface forwards to these after checking the type once. The builders call them directly
+	// (see isStaticStatistics) so merging bucket statistics needs neither a virtual call nor a cast
+	template<class Derived, class D>
+	class StaticStatistics : public AbstractStatistics
+	{
+	public:
+		typedef D DataSetType;
+
+		virtual void Aggregate(std::shared_ptr<DataSetIndex> DataSetIdx) override final
+		{
+			const D * DataSet = dynamic_cast<const D *>(DataSetIdx->GetDataSet().get());
+			if (DataSet == nullptr)
+				throw std::runtime_error("Statistics cannot be aggregated over this type of dataset. Exiting.");
+
+			static_cast<Derived *>(this)->AggregateStats(*DataSet, DataSetIdx->GetIndexData(), DataSetIdx->Size());
+		};
+
+		// NOTE: DataSet must be the D these statistics were aggregated over. This is not checked for every data point
+		virtual void Accumulate(AbstractDataSet& DataSet, uint64_t DataPointIndex) override final
+		{
+			static_cast<Derived *>(this)->AccumulateStats(static_cast<const D&>(DataSet), DataPointIndex);
+		};
+
+		virtual void Merge(std::shared_ptr<AbstractStatistics> OtherStats) override final
+		{
+			const Derived * DerivedOtherStats = dynamic_cast<const Derived *>(OtherStats.get());
+			if (DerivedOtherStats == nullptr)
+				throw std::runtime_error("Incoming statistics is null. Please check input. Exiting.");
+
+			static_cast<Derived *>(this)->MergeStats(*DerivedOtherStats);
+		};
+
+		virtual bool Subtract(std::shared_ptr<AbstractStatistics> OtherStats) override final
+		{
+			const Derived * DerivedOtherStats = dynamic_cast<const Derived *>(OtherStats.get());
+			if (DerivedOtherStats == nullptr)
+				return false;
+
+			return static_cast<Derived *>(this)->SubtractStats(*DerivedOtherStats);
+		};
+	};
+
+	// True if S derives from StaticStatistics, i.e. it can be merged and subtracted without the virtual interface
+	template<class S>
+	struct isStaticStatistics
+	{
+	private:
+		template<class Derived, class D>
+		static std::true_type Test(const StaticStatistics<Derived, D> *);
+		static std::false_type Test(...);
+
+	public:
+		static const bool value = decltype(Test(static_cast<const S *>(nullptr)))::value;
+	};
+
+	// Merge() and Subtract() of statistics of the same type. Statistics derived from StaticStatistics are called
+	// directly, others through the virtual interface with non-owning pointers (nothing is allocated or reference counted)
+	template<class S, bool isStatic = isStaticStatistics<S>::value>
+	struct StatisticsDispatch
+	{
+		// Merge() and Subtract() only read OtherStats
+		static void Merge(S& Stats, const S& OtherStats) { Stats.Merge(std::shared_ptr<S>(std::shared_ptr<S>(), const_cast<S *>(&OtherStats))); };
+		static bool Subtract(S& Stats, const S& OtherStats) { return Stats.Subtract(std::shared_ptr<S>(std::shared_ptr<S>(), const_cast<S *>(&OtherStats))); };
+	};
+
+	template<class S>
+	struct StatisticsDispatch<S, true>
+	{
+		static void Merge(S& Stats, const S& OtherStats) { Stats.MergeStats(OtherStats); };
+		static bool Subtract(S& Stats, const S& OtherStats) { return Stats.SubtractStats(OtherStats); };
+	};
+
+	template<class S>
+	inline void MergeStatistics(S& Stats, const S& OtherStats) { StatisticsDispatch<S>::Merge(Stats, OtherStats); };
+
+	template<class S>
+	inline bool SubtractStatistics(S& Stats, const S& OtherStats) { return StatisticsDispatch<S>::Subtract(Stats, OtherStats); };
 } // namespace Kaadugal
 
 #endif // _ABSTRACTSTATISTICS_HPP_
@@ -0,0 +1,69 @@
+#ifndef _AXISALIGNEDFEATURERESPONSE_HPP_
+#define _AXISALIGNEDFEATURERESPONSE_HPP_
+
+#include <stdexcept>
+
+#include "Abstract/AbstractFeatureResponse.hpp"
+#include "DenseDataSet.hpp"
+#include "Randomizer.hpp"
+
+namespace Kaadugal
+{
+	// Axis-aligned feature response for DenseDataSet. The response is the value of one feature (column)
+	class AxisAlignedFeatureResponse : public StaticFeatureResponse<AxisAlignedFeatureResponse, DenseDataSet>
+	{
+	private:
+		// NOTE: If new members are added, remember to add them to serialize/deserialize
+		int m_SelectedFeature;
+
+	public:
+		AxisAlignedFeatureResponse(void)
+			: m_SelectedFeature(0) // The feature is selected by Randomize() once the dataset is known
+		{
+
+		};
+
+		AxisAlignedFeatureResponse(int SelectedFeature)
+			: m_SelectedFeature(SelectedFeature)
+		{
+
+		};
+
+		int GetSelectedFeature(void) const { return m_SelectedFeature; };
+		virtual int GetFeatureColumn(void) const override { return m_SelectedFeature; };
+
+		// The type of the dataset is checked by StaticFeatureResponse::Randomize()
+		void RandomizeResponse(const DenseDataSet& DataSet)
+		{
+			if (DataSet.GetNumFeatures() == 0)
+				throw std::runtime_error("AxisAlignedFeatureResponse can only be trained with a non-empty DenseDataSet.");
+
+			std::uniform_int_distribution<int> UniDist(0, int(DataSet.GetNumFeatures()) - 1); // Both inclusive
+			m_SelectedFeature = UniDist(Randomizer::Get().GetRNG());
+		};
+
+		// NOTE: DataSet must be a DenseDataSet. This is checked once in Randomize() and not for every data point
+		inline VPFloat ComputeResponse(const DenseDataSet& DataSet, uint64_t DataPointIndex) const
+		{
+			return DataSet.GetFeature(DataPointIndex, m_SelectedFeature);
+		};
+
+		virtual VPFloat GetResponse(const std::shared_ptr<AbstractDataPoint>& DataPoint) const override
+		{
+			std::shared_ptr<DenseDataPoint> DensePoint = std::dynamic_pointer_cast<DenseDataPoint>(DataPoint);
+
+			return DensePoint->m_Features[m_SelectedFeature];
+		};
+
+		virtual void Serialize(std::ostream& OutputStream) const override
+		{
+			OutputStream.write((const char *)(&m_SelectedFeature), sizeof(int));
+		};
+		virtual void Deserialize(std::istream& InputStream) override
+		{
+			InputStream.read((char *)(&m_SelectedFeature), sizeof(int));
+		};
+	};
+} // namespace Kaadugal
+
+#endif // _AXISALIGNEDFEATURERESPONSE_HPP_
@@ -0,0 +1,346 @@
+#ifndef _COMPILEDFOREST_HPP_
+#define _COMPILEDFOREST_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
+#include <omp.h>
+
+#include "DecisionForest.hpp"
+#include "DenseDataSet.hpp"
+#include "MappedFile.hpp"
+
+namespace Kaadugal
+{
+	// Inference-only version of a trained forest with axis-aligned splits (see AbstractFeatureResponse::GetFeatureColumn())
+	// All trees are stored in flat arrays (structure-of-arrays), 12 bytes per node:
+	//   Split node: feature column, threshold and index of the left child (the right child is next to it)
+	//   Leaf node: feature column -1 and the index of its payload. Statistics, feature response objects and leaf data
+	//   are replaced by a fixed size payload (e.g. class counts) that is computed once when compiling
+	// Data points are rows of features, either a pointer to a row or a DenseDataSet
+	// A compiled forest is immutable. It is either compiled in memory or memory-mapped from a file written by Save()
+	// (see Load()). Copies share the same arrays
+	class CompiledForest
+	{
+	public:
+		// Version of the file format. Increment when the layout changes
+		static const uint32_t s_FileVersion = 1;
+
+	private:
+		// Nodes of tree t are [m_Root, m_Root + m_NumNodes) and its leaves use payloads [m_FirstPayload, m_FirstPayload + m_NumPayloads)
+		struct TreeRecord
+		{
+			int32_t m_Root;
+			int32_t m_NumNodes;
+			int32_t m_FirstPayload;
+			int32_t m_NumPayloads;
+		};
+
+		// File layout: header, tree offset table and the node and payload arrays. Every section starts at a multiple
+		// of s_SectionAlignment so that the mapped arrays are used in place. Values are in host byte order
+		struct FileHeader
+		{
+			char m_Magic[8];
+			uint32_t m_Version;
+			uint32_t m_ByteOrder; // s_ByteOrderMark as written by the host that saved the file
+			uint32_t m_FloatSize; // sizeof(VPFloat)
+			uint32_t m_PayloadSize;
+			uint32_t m_NumTrees;
+			uint32_t m_Reserved;
+			uint64_t m_NumNodes;
+			uint64_t m_NumPayloads;
+			uint64_t m_TreeTableOffset;
+			uint64_t m_FeatureColumnsOffset;
+			uint64_t m_ThresholdsOffset;
+			uint64_t m_ChildrenOffset;
+			uint64_t m_PayloadsOffset;
+			uint64_t m_FileSize;
+		};
+		static const uint32_t s_ByteOrderMark = 0x01020304;
+		static const uint64_t s_SectionAlignment = 64;
+		static const char * GetMagic(void) { return "KDGLCFST"; };
+
+		// Arrays of a forest compiled in memory
+		struct Storage
+		{
+			std::vector<TreeRecord> m_Trees;
+			std::vector<int32_t> m_FeatureColumns;
+			std::vector<VPFloat> m_Thresholds;
+			std::vector<int32_t> m_Children; // Left child for split nodes, payload index for leaf nodes
+			std::vector<VPFloat> m_LeafPayloads;
+		};
+
+		std::shared_ptr<const void> m_Owner; // Storage or MappedFile that owns the arrays below
+		const TreeRecord * m_Trees;
+		const int32_t * m_FeatureColumns;
+		const VPFloat * m_Thresholds;
+		const int32_t * m_Children;
+		const VPFloat * m_LeafPayloads;
+		int m_NumTrees;
+		int64_t m_NumNodes;
+		int64_t m_NumPayloads;
+		int m_PayloadSize;
+
+		static uint64_t AlignOffset(uint64_t Offset)
+		{
+			return (Offset + s_SectionAlignment - 1) / s_SectionAlignment * s_SectionAlignment;
+		};
+
+		static void WriteSection(std::ostream& OutputStream, uint64_t Offset, const void * Data, uint64_t Size)
+		{
+			uint64_t Position = uint64_t(OutputStream.tellp());
+			static const char Padding[s_SectionAlignment] = { 0 };
+			OutputStream.write(Padding, Offset - Position);
+			OutputStream.write((const char *)Data, Size);
+		};
+
+	public:
+		CompiledForest(void)
+			: m_Trees(nullptr)
+			, m_FeatureColumns(nullptr)
+			, m_Thresholds(nullptr)
+			, m_Children(nullptr)
+			, m_LeafPayloads(nullptr)
+			, m_NumTrees(0)
+			, m_NumNodes(0)
+			, m_NumPayloads(0)
+			, m_PayloadSize(0)
+		{
+
+		};
+
+		// LeafPayload(const S& Statistics, const R& LeafData, VPFloat * Payload) fills the PayloadSize values of a leaf
+		template<class T, class S, class R, class PayloadFunction>
+		void Compile(const DecisionForest<T, S, R>& Forest, int PayloadSize, PayloadFunction LeafPayload)
+		{
+			if (PayloadSize <= 0)
+				throw std::runtime_error("Payload size of compiled forest must be positive.");
+
+			std::shared_ptr<Storage> Arrays = std::make_shared<Storage>();
+			for (int t = 0; t < Forest.GetNumTrees(); ++t)
+			{
+				DecisionTree<T, S, R>& Tree = *Forest.GetTree(t);
+				if (Tree.isValid() == false)
+					throw std::runtime_error("Cannot compile forest with an invalid tree.");
+
+				// Nodes are laid out in breadth-first order with siblings next to each other
+				TreeRecord Record;
+				Record.m_Root = Arrays->m_FeatureColumns.size();
+				Record.m_FirstPayload = Arrays->m_LeafPayloads.size() / PayloadSize;
+				std::vector<int> TreeNodes(1, 0); // Tree node index of each compiled node of this tree
+				Arrays->m_FeatureColumns.push_back(-1);
+				Arrays->m_Thresholds.push_back(0.0);
+				Arrays->m_Children.push_back(-1);
+				for (int i = 0; i < int(TreeNodes.size()); ++i)
+				{
+					DecisionNode<T, S, R>& Node = Tree.GetNode(TreeNodes[i]);
+					int32_t Compiled = Record.m_Root + i;
+					if (Node.GetType() == Kaadugal::SplitNode)
+					{
+						int FeatureColumn = Node.GetFeatureResponse().GetFeatureColumn();
+						if (FeatureColumn < 0)
+							throw std::runtime_error("Cannot compile forest. Feature responses are not axis-aligned.");
+
+						Arrays->m_FeatureColumns[Compiled] = FeatureColumn;
+						Arrays->m_Thresholds[Compiled] = Node.GetThreshold();
+						Arrays->m_Children[Compiled] = Record.m_Root + TreeNodes.size();
+						TreeNodes.push_back(Node.GetLeftChild());
+						TreeNodes.push_back(Node.GetRightChild());
+						Arrays->m_FeatureColumns.resize(Arrays->m_FeatureColumns.size() + 2, -1);
+						Arrays->m_Thresholds.resize(Arrays->m_Thresholds.size() + 2, 0.0);
+						Arrays->m_Children.resize(Arrays->m_Children.size() + 2, -1);
+					}
+					else if (Node.GetType() == Kaadugal::LeafNode)
+					{
+						int32_t PayloadIndex = Arrays->m_LeafPayloads.size() / PayloadSize;
+						Arrays->m_LeafPayloads.resize(Arrays->m_LeafPayloads.size() + PayloadSize, 0.0);
+						LeafPayload(Node.GetStatistics(), Node.GetLeafData(), Arrays->m_LeafPayloads.data() + int64_t(PayloadIndex) * PayloadSize);
+						Arrays->m_Children[Compiled] = PayloadIndex;
+					}
+					else
+						throw std::runtime_error("Cannot compile forest. Tree has an invalid node.");
+				}
+				Record.m_NumNodes = TreeNodes.size();
+				Record.m_NumPayloads = Arrays->m_LeafPayloads.size() / PayloadSize - Record.m_FirstPayload;
+				Arrays->m_Trees.push_back(Record);
+			}
+
+			m_Owner = Arrays;
+			m_Trees = Arrays->m_Trees.data();
+			m_FeatureColumns = Arrays->m_FeatureColumns.data();
+			m_Thresholds = Arrays->m_Thresholds.data();
+			m_Children = Arrays->m_Children.data();
+			m_LeafPayloads = Arrays->m_LeafPayloads.data();
+			m_NumTrees = Arrays->m_Trees.size();
+			m_NumNodes = Arrays->m_FeatureColumns.size();
+			m_NumPayloads = Arrays->m_LeafPayloads.size() / PayloadSize;
+			m_PayloadSize = PayloadSize;
+		};
+
+		// Writes the versioned binary format that Load() maps
+		bool Save(const std::string& FileName) const
+		{
+			FileHeader Header;
+			std::memset(&Header, 0, sizeof(FileHeader));
+			std::memcpy(Header.m_Magic, GetMagic(), sizeof(Header.m_Magic));
+			Header.m_Version = s_FileVersion;
+			Header.m_ByteOrder = s_ByteOrderMark;
+			Header.m_FloatSize = sizeof(VPFloat);
+			Header.m_PayloadSize = m_PayloadSize;
+			Header.m_NumTrees = m_NumTrees;
+			Header.m_NumNodes = m_NumNodes;
+			Header.m_NumPayloads = m_NumPayloads;
+			Header.m_TreeTableOffset = AlignOffset(sizeof(FileHeader));
+			Header.m_FeatureColumnsOffset = AlignOffset(Header.m_TreeTableOffset + sizeof(TreeRecord) * m_NumTrees);
+			Header.m_ThresholdsOffset = AlignOffset(Header.m_FeatureColumnsOffset + sizeof(int32_t) * m_NumNodes);
+			Header.m_ChildrenOffset = AlignOffset(Header.m_ThresholdsOffset + sizeof(VPFloat) * m_NumNodes);
+			Header.m_PayloadsOffset = AlignOffset(Header.m_ChildrenOffset + sizeof(int32_t) * m_NumNodes);
+			Header.m_FileSize = Header.m_PayloadsOffset + sizeof(VPFloat) * m_NumPayloads * m_PayloadSize;
+
+			std::ofstream OutputStream(FileName, std::ios::out | std::ios::trunc | std::ios::binary);
+			if (!OutputStream.is_open())
+			{
+				std::cout << "[ WARN ]: Unable to open file " << FileName << " to save compiled forest." << std::endl;
+				return false;
+			}
+			OutputStream.write((const char *)(&Header), sizeof(FileHeader));
+			WriteSection(OutputStream, Header.m_TreeTableOffset, m_Trees, sizeof(TreeRecord) * m_NumTrees);
+			WriteSection(OutputStream, Header.m_FeatureColumnsOffset, m_FeatureColumns, sizeof(int32_t) * m_NumNodes);
+			WriteSection(OutputStream, Header.m_ThresholdsOffset, m_Thresholds, sizeof(VPFloat) * m_NumNodes);
+			WriteSection(OutputStream, Header.m_ChildrenOffset, m_Children, sizeof(int32_t) * m_NumNodes);
+			WriteSection(OutputStream, Header.m_PayloadsOffset, m_LeafPayloads, sizeof(VPFloat) * m_NumPayloads * m_PayloadSize);
+
+			return OutputStream.good();
+		};
+
+		// Maps a file written by Save(). Nothing is parsed or copied, so loading takes constant time and pages
+		// (e.g. of a single tree, see GetTreeRoot()) are only read when inference touches them
+		// Only the header is checked. Throws if the file is not a compatible compiled forest
+		void Load(const std::string& FileName)
+		{
+			std::shared_ptr<MappedFile> File = std::make_shared<MappedFile>(FileName);
+			if (File->GetSize() < sizeof(FileHeader))
+				throw std::runtime_error("File " + FileName + " is not a compiled forest.");
+
+			const char * Data = File->GetData();
+			const FileHeader& Header = *(const FileHeader *)Data;
+			if (std::memcmp(Header.m_Magic, GetMagic(), sizeof(Header.m_Magic)) != 0)
+				throw std::runtime_error("File " + FileName + " is not a compiled forest.");
+			if (Header.m_Version != s_FileVersion)
+				throw std::runtime_error("Compiled forest " + FileName + " has unsupported version " + std::to_string(Header.m_Version) + ".");
+			if (Header.m_ByteOrder != s_ByteOrderMark || Header.m_FloatSize != sizeof(VPFloat))
+				throw std::runtime_error("Compiled forest " + FileName + " was saved on an incompatible platform or with a different VPFloat.");
+
+			uint64_t NumNodes = Header.m_NumNodes;
+			uint64_t PayloadValues = Header.m_NumPayloads * Header.m_PayloadSize;
+			bool isValid = Header.m_FileSize <= File->GetSize() && Header.m_PayloadSize > 0
+				&& Header.m_NumNodes <= uint64_t(std::numeric_limits<int32_t>::max())
+				&& Header.m_TreeTableOffset + sizeof(TreeRecord) * Header.m_NumTrees <= Header.m_FileSize
+				&& Header.m_FeatureColumnsOffset + sizeof(int32_t) * NumNodes <= Header.m_FileSize
+				&& Header.m_ThresholdsOffset + sizeof(VPFloat) * NumNodes <= Header.m_FileSize
+				&& Header.m_ChildrenOffset + sizeof(int32_t) * NumNodes <= Header.m_FileSize
+				&& Header.m_PayloadsOffset + sizeof(VPFloat) * PayloadValues <= Header.m_FileSize;
+			uint64_t Offsets[] = { Header.m_TreeTableOffset, Header.m_FeatureColumnsOffset, Header.m_ThresholdsOffset, Header.m_ChildrenOffset, Header.m_PayloadsOffset };
+			for (uint64_t Offset : Offsets)
+				isValid &= Offset % s_SectionAlignment == 0;
+			if (!isValid)
+				throw std::runtime_error("Compiled forest " + FileName + " is truncated or corrupt.");
+
+			m_Owner = File;
+			m_Trees = (const TreeRecord *)(Data + Header.m_TreeTableOffset);
+			m_FeatureColumns = (const int32_t *)(Data + Header.m_FeatureColumnsOffset);
+			m_Thresholds = (const VPFloat *)(Data + Header.m_ThresholdsOffset);
+			m_Children = (const int32_t *)(Data + Header.m_ChildrenOffset);
+			m_LeafPayloads = (const VPFloat *)(Data + Header.m_PayloadsOffset);
+			m_NumTrees = Header.m_NumTrees;
+			m_NumNodes = NumNodes;
+			m_NumPayloads = Header.m_NumPayloads;
+			m_PayloadSize = Header.m_PayloadSize;
+		};
+
+		int GetNumTrees(void) const { return m_NumTrees; };
+		int64_t GetNumNodes(void) const { return m_NumNodes; };
+		int GetPayloadSize(void) const { return m_PayloadSize; };
+		int32_t GetTreeRoot(int t) const { return m_Trees[t].m_Root; };
+		int32_t GetTreeNumNodes(int t) const { return m_Trees[t].m_NumNodes; };
+
+		// Payload of the leaf reached in tree t by a data point with the given features
+		inline const VPFloat * GetLeafPayload(int t, const VPFloat * Features) const
+		{
+			int32_t Node = m_Trees[t].m_Root;
+			while (m_FeatureColumns[Node] >= 0)
+				Node = m_Children[Node] + (Features[m_FeatureColumns[Node]] > m_Thresholds[Node] ? 0 : 1); // Same logic as in training
+
+			return m_LeafPayloads + int64_t(m_Children[Node]) * m_PayloadSize;
+		};
+
+		// Output (PayloadSize values) is the average of the leaf payloads of all trees
+		void Predict(const VPFloat * Features, VPFloat * Output) const
+		{
+			std::fill(Output, Output + m_PayloadSize, VPFloat(0.0));
+			int NumTrees = GetNumTrees();
+			for (int t = 0; t < NumTrees; ++t)
+			{
+				const VPFloat * Payload = GetLeafPayload(t, Features);
+				for (int k = 0; k < m_PayloadSize; ++k)
+					Output[k] += Payload[k];
+			}
+			for (int k = 0; k < m_PayloadSize; ++k)
+				Output[k] /= VPFloat(NumTrees);
+		};
+
+		// Predicts the data points [Begin, End) of a DenseDataSet. Output is resized to (End - Begin) * PayloadSize
+		// Same blocked, tree-major order as DecisionForest::TestBatch()
+		void PredictBatch(const DenseDataSet& DataSet, std::vector<VPFloat>& Output, uint64_t Begin = 0, uint64_t End = std::numeric_limits<uint64_t>::max(), int NumThreads = 0) const
+		{
+			End = std::min(End, DataSet.GetNumDataPoints());
+			Output.assign(Begin < End ? (End - Begin) * m_PayloadSize : 0, 0.0);
+			if (Begin >= End)
+				return;
+			if (NumThreads <= 0)
+				NumThreads = omp_get_max_threads();
+
+			int NumTrees = GetNumTrees();
+			int NumFeatures = DataSet.GetNumFeatures();
+			const int64_t BlockSize = 256;
+			int64_t NumBlocks = (int64_t(End - Begin) + BlockSize - 1) / BlockSize;
+#pragma omp parallel num_threads(NumThreads)
+			{
+				std::vector<VPFloat> Rows(BlockSize * NumFeatures); // Row-major copy of the block
+#pragma omp for schedule(dynamic)
+				for (int64_t Block = 0; Block < NumBlocks; ++Block)
+				{
+					uint64_t BlockBegin = Begin + Block * BlockSize;
+					uint64_t BlockEnd = std::min(BlockBegin + BlockSize, End);
+					for (int f = 0; f < NumFeatures; ++f)
+					{
+						const VPFloat * Column = DataSet.GetColumn(f);
+						for (uint64_t i = BlockBegin; i < BlockEnd; ++i)
+							Rows[(i - BlockBegin) * NumFeatures + f] = Column[i];
+					}
+
+					for (int t = 0; t < NumTrees; ++t)
+					{
+						for (uint64_t i = BlockBegin; i < BlockEnd; ++i)
+						{
+							const VPFloat * Payload = GetLeafPayload(t, Rows.data() + (i - BlockBegin) * NumFeatures);
+							VPFloat * Out = Output.data() + (i - Begin) * m_PayloadSize;
+							for (int k = 0; k < m_PayloadSize; ++k)
+								Out[k] += Payload[k];
+						}
+					}
+
+					for (uint64_t i = (BlockBegin - Begin) * m_PayloadSize; i < (BlockEnd - Begin) * m_PayloadSize; ++i)
+						Output[i] /= VPFloat(NumTrees);
+				}
+			}
+		};
+	};
+} // namespace Kaadugal
+
+#endif // _COMPILEDFOREST_HPP_
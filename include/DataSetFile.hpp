@@ -0,0 +1,219 @@
+#ifndef _DATASETFILE_HPP_
+#define _DATASETFILE_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <omp.h>
+
+#include "DenseDataSet.hpp"
+
+namespace Kaadugal
+{
+	// Which per data point values a dataset file holds besides the features
+	enum LabelType
+	{
+		NoLabels = 0,
+		ClassLabels, // int labels (classification)
+		Targets // VPFloat targets (regression)
+	};
+
+	// Binary file format of DenseDataSet. The file is loaded into memory with Load() or memory-mapped (see MappedDataSet)
+	// Layout: header, NumFeatures columns of ColumnStride values and the labels or targets. Columns and sections start
+	// at multiples of s_SectionAlignment bytes. Values are in host byte order
+	class DataSetFile
+	{
+	public:
+		// Version of the file format. Increment when the layout changes
+		static const uint32_t s_FileVersion = 2;
+
+		struct Header
+		{
+			char m_Magic[8];
+			uint32_t m_Version;
+			uint32_t m_ByteOrder; // s_ByteOrderMark as written by the host that saved the file
+			uint32_t m_FloatSize; // sizeof(VPFloat)
+			uint32_t m_LabelType; // See LabelType
+			int32_t m_NumClasses;
+			uint32_t m_Reserved;
+			uint64_t m_NumDataPoints;
+			uint64_t m_NumFeatures;
+			uint64_t m_ColumnStride;
+			uint64_t m_FeaturesOffset;
+			uint64_t m_LabelsOffset; // 0 if there are no labels
+			uint64_t m_TargetsOffset; // 0 if there are no targets
+			uint64_t m_FileSize;
+		};
+
+	private:
+		static const uint32_t s_ByteOrderMark = 0x01020304;
+		static const uint64_t s_SectionAlignment = 64;
+		static const uint64_t s_LoadChunkSize = uint64_t(8) << 20; // Bytes read by one thread at a time
+		static const char * GetMagic(void) { return "KDGLDSET"; };
+
+		static uint64_t AlignOffset(uint64_t Offset)
+		{
+			return (Offset + s_SectionAlignment - 1) / s_SectionAlignment * s_SectionAlignment;
+		};
+
+		static void Pad(std::ostream& OutputStream, uint64_t Offset)
+		{
+			static const char Padding[s_SectionAlignment] = { 0 };
+			OutputStream.write(Padding, Offset - uint64_t(OutputStream.tellp()));
+		};
+
+	public:
+		// True if the file starts like a dataset file. Does not validate the rest
+		static bool isDataSetFile(const std::string& FileName)
+		{
+			char Magic[8] = { 0 };
+			std::ifstream InputStream(FileName, std::ios::in | std::ios::binary);
+			InputStream.read(Magic, sizeof(Magic));
+
+			return InputStream.good() && std::memcmp(Magic, GetMagic(), sizeof(Magic)) == 0;
+		};
+
+		// Checks a header read from a file of FileSize bytes. Throws if it is not a compatible dataset file
+		static void Validate(const Header& FileHeader, uint64_t FileSize, const std::string& FileName)
+		{
+			if (FileSize < sizeof(Header) || std::memcmp(FileHeader.m_Magic, GetMagic(), sizeof(FileHeader.m_Magic)) != 0)
+				throw std::runtime_error("File " + FileName + " is not a Kaadugal dataset.");
+			if (FileHeader.m_Version != s_FileVersion)
+				throw std::runtime_error("Dataset " + FileName + " has unsupported version " + std::to_string(FileHeader.m_Version) + ".");
+			if (FileHeader.m_ByteOrder != s_ByteOrderMark || FileHeader.m_FloatSize != sizeof(VPFloat))
+				throw std::runtime_error("Dataset " + FileName + " was saved on an incompatible platform or with a different VPFloat.");
+
+			bool isLabeled = FileHeader.m_LabelType == ClassLabels;
+			bool isTargeted = FileHeader.m_LabelType == Targets;
+			bool isValid = FileHeader.m_LabelType <= Targets && FileHeader.m_FileSize <= FileSize && FileHeader.m_NumClasses >= 0
+				&& FileHeader.m_ColumnStride >= FileHeader.m_NumDataPoints
+				&& FileHeader.m_FeaturesOffset + sizeof(VPFloat) * FileHeader.m_ColumnStride * FileHeader.m_NumFeatures <= FileHeader.m_FileSize
+				&& (FileHeader.m_LabelsOffset != 0) == isLabeled && (FileHeader.m_TargetsOffset != 0) == isTargeted
+				&& FileHeader.m_LabelsOffset + sizeof(int) * FileHeader.m_NumDataPoints * isLabeled <= FileHeader.m_FileSize
+				&& FileHeader.m_TargetsOffset + sizeof(VPFloat) * FileHeader.m_NumDataPoints * isTargeted <= FileHeader.m_FileSize
+				&& FileHeader.m_FeaturesOffset % s_SectionAlignment == 0 && FileHeader.m_LabelsOffset % s_SectionAlignment == 0
+				&& FileHeader.m_TargetsOffset % s_SectionAlignment == 0;
+			if (!isValid)
+				throw std::runtime_error("Dataset " + FileName + " is truncated or corrupt.");
+		};
+
+		// Writes the features of a dataset and its labels or targets (see LabelType)
+		static bool Save(const DenseDataSet& DataSet, const std::string& FileName, LabelType Labels)
+		{
+			const uint64_t ValuesPerAlignment = s_SectionAlignment / sizeof(VPFloat);
+			Header FileHeader;
+			std::memset(&FileHeader, 0, sizeof(Header));
+			std::memcpy(FileHeader.m_Magic, GetMagic(), sizeof(FileHeader.m_Magic));
+			FileHeader.m_Version = s_FileVersion;
+			FileHeader.m_ByteOrder = s_ByteOrderMark;
+			FileHeader.m_FloatSize = sizeof(VPFloat);
+			FileHeader.m_LabelType = Labels;
+			FileHeader.m_NumClasses = Labels == ClassLabels ? DataSet.GetNumClasses() : 0;
+			FileHeader.m_NumDataPoints = DataSet.GetNumDataPoints();
+			FileHeader.m_NumFeatures = DataSet.GetNumFeatures();
+			FileHeader.m_ColumnStride = (FileHeader.m_NumDataPoints + ValuesPerAlignment - 1) / ValuesPerAlignment * ValuesPerAlignment;
+			FileHeader.m_FeaturesOffset = AlignOffset(sizeof(Header));
+			FileHeader.m_FileSize = FileHeader.m_FeaturesOffset + sizeof(VPFloat) * FileHeader.m_ColumnStride * FileHeader.m_NumFeatures;
+			if (Labels == ClassLabels)
+			{
+				FileHeader.m_LabelsOffset = AlignOffset(FileHeader.m_FileSize);
+				FileHeader.m_FileSize = FileHeader.m_LabelsOffset + sizeof(int) * FileHeader.m_NumDataPoints;
+			}
+			if (Labels == Targets)
+			{
+				FileHeader.m_TargetsOffset = AlignOffset(FileHeader.m_FileSize);
+				FileHeader.m_FileSize = FileHeader.m_TargetsOffset + sizeof(VPFloat) * FileHeader.m_NumDataPoints;
+			}
+
+			std::ofstream OutputStream(FileName, std::ios::out | std::ios::trunc | std::ios::binary);
+			if (!OutputStream.is_open())
+			{
+				std::cout << "[ WARN ]: Unable to open file " << FileName << " to save dataset." << std::endl;
+				return false;
+			}
+			OutputStream.write((const char *)(&FileHeader), sizeof(Header));
+			for (uint64_t f = 0; f < FileHeader.m_NumFeatures; ++f)
+			{
+				Pad(OutputStream, FileHeader.m_FeaturesOffset + sizeof(VPFloat) * FileHeader.m_ColumnStride * f);
+				OutputStream.write((const char *)(DataSet.GetColumn(f)), sizeof(VPFloat) * FileHeader.m_NumDataPoints);
+			}
+			if (Labels == ClassLabels)
+			{
+				Pad(OutputStream, FileHeader.m_LabelsOffset);
+				OutputStream.write((const char *)(DataSet.GetLabels()), sizeof(int) * FileHeader.m_NumDataPoints);
+			}
+			if (Labels == Targets)
+			{
+				Pad(OutputStream, FileHeader.m_TargetsOffset);
+				OutputStream.write((const char *)(DataSet.GetTargets()), sizeof(VPFloat) * FileHeader.m_NumDataPoints);
+			}
+
+			return OutputStream.good();
+		};
+
+		// Reads a dataset file into memory. Storage is allocated once and filled by all threads in parallel chunks
+		// Values that the file does not hold are 0. Returns the type of labels in the file. Throws on errors
+		static LabelType Load(const std::string& FileName, DenseDataSet& DataSet)
+		{
+			std::ifstream InputStream(FileName, std::ios::in | std::ios::binary | std::ios::ate);
+			if (!InputStream.is_open())
+				throw std::runtime_error("Unable to open dataset " + FileName + ".");
+			uint64_t FileSize = uint64_t(InputStream.tellg());
+			Header FileHeader;
+			std::memset(&FileHeader, 0, sizeof(Header));
+			InputStream.seekg(0);
+			InputStream.read((char *)(&FileHeader), sizeof(Header));
+			Validate(FileHeader, FileSize, FileName);
+			InputStream.close();
+
+			DataSet.Resize(FileHeader.m_NumDataPoints, FileHeader.m_NumFeatures);
+			DataSet.SetNumClasses(FileHeader.m_NumClasses);
+
+			// Contiguous byte ranges of the file and where they go
+			struct Chunk
+			{
+				uint64_t m_Offset;
+				char * m_Destination;
+				uint64_t m_Size;
+			};
+			std::vector<Chunk> Chunks;
+			auto AddSection = [&Chunks](uint64_t Offset, void * Destination, uint64_t Size)
+			{
+				for (uint64_t Begin = 0; Begin < Size; Begin += s_LoadChunkSize)
+					Chunks.push_back(Chunk{ Offset + Begin, (char *)Destination + Begin, std::min(s_LoadChunkSize, Size - Begin) });
+			};
+			for (uint64_t f = 0; f < FileHeader.m_NumFeatures; ++f)
+				AddSection(FileHeader.m_FeaturesOffset + sizeof(VPFloat) * FileHeader.m_ColumnStride * f, DataSet.GetColumn(f), sizeof(VPFloat) * FileHeader.m_NumDataPoints);
+			if (FileHeader.m_LabelType == ClassLabels)
+				AddSection(FileHeader.m_LabelsOffset, DataSet.GetLabels(), sizeof(int) * FileHeader.m_NumDataPoints);
+			if (FileHeader.m_LabelType == Targets)
+				AddSection(FileHeader.m_TargetsOffset, DataSet.GetTargets(), sizeof(VPFloat) * FileHeader.m_NumDataPoints);
+
+			bool isGood = true;
+#pragma omp parallel
+			{
+				std::ifstream ChunkStream(FileName, std::ios::in | std::ios::binary);
+#pragma omp for schedule(dynamic)
+				for (int64_t c = 0; c < int64_t(Chunks.size()); ++c)
+				{
+					ChunkStream.seekg(Chunks[c].m_Offset);
+					ChunkStream.read(Chunks[c].m_Destination, Chunks[c].m_Size);
+					if (!ChunkStream.good())
+					{
+#pragma omp atomic write
+						isGood = false;
+					}
+				}
+			}
+			if (!isGood)
+				throw std::runtime_error("Unable to read dataset " + FileName + ".");
+
+			return LabelType(FileHeader.m_LabelType);
+		};
+	};
+} // namespace Kaadugal
+
+#endif // _DATASETFILE_HPP_
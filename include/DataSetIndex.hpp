@@ -14,7 +14,11 @@ namespace Kaadugal
 		std::shared_ptr<AbstractDataSet> m_BaseDataSet;
 		// Contains indices of data that an instance of this class has access to
 		// By default, it has access to nothing
-		std::vector<int> m_Index;
+		// The index buffer can be shared between many instances each of which only sees the range [m_Begin, m_End)
+		// This is used for partitioning data in place during training without copying indices
+		std::shared_ptr<std::vector<int>> m_Index;
+		int m_Begin;
+		int m_End;
 
 	public:
 		DataSetIndex(std::shared_ptr<AbstractDataSet> DataSet, const std::vector<int>& Index)
@@ -22,21 +26,51 @@ namespace Kaadugal
 			m_BaseDataSet = DataSet;
 			if (uint64_t(Index.size()) > m_BaseDataSet->Size())
 				std::cout << "[ WARN ]: Index size (" << Index.size() << ") exceeds dataset size (" << m_BaseDataSet->Size() << ")." << std::endl;
-			m_Index = Index;
+			m_Index = std::make_shared<std::vector<int>>(Index);
+			m_Begin = 0;
+			m_End = int(Index.size());
 		};
 
-		virtual int Size(void) { return int(m_Index.size()); };
+		// View of the range [Begin, End) of a (shared) index buffer. Does not copy indices
+		DataSetIndex(std::shared_ptr<AbstractDataSet> DataSet, std::shared_ptr<std::vector<int>> IndexBuffer, int Begin, int End)
+			: m_BaseDataSet(DataSet)
+			, m_Index(IndexBuffer)
+			, m_Begin(Begin)
+			, m_End(End)
+		{
+
+		};
+
+		// Moves this view to the range [Begin, End) of its index buffer in DataSet. Lets a view be reused without allocation
+		void SetView(const std::shared_ptr<AbstractDataSet>& DataSet, int Begin, int End)
+		{
+			m_BaseDataSet = DataSet;
+			m_Begin = Begin;
+			m_End = End;
+		};
+
+		virtual int Size(void) { return m_End - m_Begin; };
 		// Get index in original dataset
 		int GetDataPointIndex(int i)
 		{
 			if (i >= Size())
 				return -1;
 
-			return m_Index[i];
+			return (*m_Index)[m_Begin + i];
 		};
 
 		std::shared_ptr<AbstractDataPoint> GetDataPoint(int i) { return m_BaseDataSet->Get(GetDataPointIndex(i)); };
 		std::shared_ptr<AbstractDataSet> GetDataSet(void) { return m_BaseDataSet; };
-		const std::vector<int>& GetIndex(void) { return m_Index; };
+		// Copy of the indices this instance sees. Use GetIndexData() and Size() to avoid the copy
+		std::vector<int> CopyIndex(void) { return std::vector<int>(m_Index->begin() + m_Begin, m_Index->begin() + m_End); };
+
+		// Direct access to the range of the index buffer this instance sees. Reordering is allowed, use with care
+		int * GetIndexData(void) { return m_Index->data() + m_Begin; };
+
+		// View of the range [Begin, End) of this instance (relative to this instance) sharing the same index buffer
+		std::shared_ptr<DataSetIndex> GetSubset(int Begin, int End)
+		{
+			return std::make_shared<DataSetIndex>(m_BaseDataSet, m_Index, m_Begin + Begin, m_Begin + End);
+		};
 	};
 } // namespace Kaadugal
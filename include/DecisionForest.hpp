@@ -4,6 +4,11 @@
 #include <memory>
 #include <ostream>
 #include <istream>
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <omp.h>
 
 #include "DecisionTree.hpp"
 #include "Abstract/AbstractDataSet.hpp"
@@ -14,18 +19,71 @@ namespace Kaadugal
 	// T: AbstractFeatureResponse which is the feature response function or weak learner
 	// S: AbstractStatistics which contains some statistics about node from training
 	// R: AbstractLeafData, arbitrary data stored if this is a leaf node
+	// Testing (Test(), TestBatch() and TestBatchEarlyExit()) is const, so one forest can be tested by any number of
+	// threads at once. Only adding or loading trees needs exclusive access
 	template<class T, class S, class R>
 	class DecisionForest
 	{
 	private:
 		int m_nTrees;
 		std::vector<std::shared_ptr<DecisionTree<T, S, R>>> m_Trees;
+		// Most votes that trees t, t+1, ... can still add to a class (see TestBatchEarlyExit()). Has m_nTrees + 1 entries
+		// The maximum is used for trees whose statistics are not class histograms, so early exit never triggers
+		std::vector<int64_t> m_RemainingVotes;
+
+		// True once the class with most votes in Stats cannot be overtaken when up to RemainingVotes more votes are
+		// added to any class, or (ConfidenceMargin > 0) its probability exceeds that of the runner-up by ConfidenceMargin
+		static bool isVoteDecided(const S& Stats, int64_t RemainingVotes, VPFloat ConfidenceMargin)
+		{
+			int NumClasses = 0;
+			const int * Counts = Stats.GetLabelCounts(NumClasses);
+			if (Counts == nullptr || NumClasses <= 0)
+				return false;
+
+			int64_t Top = 0;
+			int64_t RunnerUp = 0;
+			int64_t Total = 0;
+			for (int c = 0; c < NumClasses; ++c)
+			{
+				Total += Counts[c];
+				if (Counts[c] > Top)
+				{
+					RunnerUp = Top;
+					Top = Counts[c];
+				}
+				else
+					RunnerUp = std::max(RunnerUp, int64_t(Counts[c]));
+			}
+			// Strictly more so that ties between classes cannot be decided differently by the remaining trees
+			if (Top - RunnerUp > RemainingVotes)
+				return true;
+
+			// Strictly more here too, so that ties never stop testing
+			return ConfidenceMargin > 0.0 && Total > 0 && VPFloat(Top - RunnerUp) > ConfidenceMargin * VPFloat(Total);
+		};
 
 	public:
+		DecisionForest(void)
+			: m_nTrees(0)
+			, m_RemainingVotes(1, 0)
+		{
+
+		};
+
 		void AddTree(std::shared_ptr<DecisionTree<T, S, R>> TreePtr)
 		{
 			m_Trees.push_back(TreePtr);
 			m_nTrees = m_Trees.size();
+
+			int64_t TreeVotes = TreePtr->GetMaxLeafVotes();
+			m_RemainingVotes.push_back(0);
+			for (int t = 0; t < m_nTrees; ++t)
+			{
+				if (TreeVotes < 0 || m_RemainingVotes[t] == std::numeric_limits<int64_t>::max())
+					m_RemainingVotes[t] = std::numeric_limits<int64_t>::max();
+				else
+					m_RemainingVotes[t] += TreeVotes;
+			}
 		};
 
 		const std::shared_ptr<DecisionTree<T, S, R>> GetTree(int i) const
@@ -35,7 +93,7 @@ namespace Kaadugal
 
 		int GetNumTrees(void) const { return m_nTrees; };
 
-		void Test(std::shared_ptr<AbstractDataPoint> DataPointPtr, std::shared_ptr<S> ForestLeafStats, std::shared_ptr<R> LeafData = nullptr)
+		void Test(std::shared_ptr<AbstractDataPoint> DataPointPtr, std::shared_ptr<S> ForestLeafStats, std::shared_ptr<R> LeafData = nullptr) const
 		{
 			for (int i = 0; i < m_nTrees; ++i)
 			{
@@ -56,6 +114,108 @@ namespace Kaadugal
 			}
 		};
 
+		// Tests the data points [Begin, End) of DataSet and merges the leaf statistics of all trees into Results[i - Begin]
+		// Results must be allocated by the caller (e.g. with empty statistics) and are not cleared. Optionally, leaf data
+		// is merged into LeafData in the same way. Data points are processed in blocks by parallel threads and within a
+		// block one tree is applied to all data points before the next (tree-major) so that the tree stays in cache
+		void TestBatch(AbstractDataSet& DataSet, std::vector<S>& Results, uint64_t Begin = 0, uint64_t End = std::numeric_limits<uint64_t>::max()
+			, std::vector<R> * LeafData = nullptr, int NumThreads = 0) const
+		{
+			End = std::min(End, DataSet.Size());
+			if (Begin >= End)
+				return;
+			uint64_t NumDataPoints = End - Begin;
+			if (uint64_t(Results.size()) < NumDataPoints || (LeafData != nullptr && uint64_t(LeafData->size()) < NumDataPoints))
+				throw std::runtime_error("Output for batch testing is smaller than the number of data points.");
+			if (m_nTrees > 0 && m_Trees[0]->GetNode(0).GetFeatureResponse().isDataSetSupported(DataSet) == false)
+				throw std::runtime_error("Forest cannot be tested on this type of dataset.");
+			if (NumThreads <= 0)
+				NumThreads = omp_get_max_threads();
+
+			const int64_t BlockSize = 1024;
+			int64_t NumBlocks = (int64_t(NumDataPoints) + BlockSize - 1) / BlockSize;
+			std::vector<int> LeafIndices(BlockSize * NumThreads);
+#pragma omp parallel for schedule(dynamic) num_threads(NumThreads)
+			for (int64_t Block = 0; Block < NumBlocks; ++Block)
+			{
+				int * BlockLeafIndices = LeafIndices.data() + BlockSize * omp_get_thread_num();
+				uint64_t BlockBegin = Begin + Block * BlockSize;
+				uint64_t BlockEnd = std::min(BlockBegin + BlockSize, End);
+				for (int t = 0; t < m_nTrees; ++t)
+				{
+					const DecisionTree<T, S, R>& Tree = *m_Trees[t];
+					for (uint64_t i = BlockBegin; i < BlockEnd; ++i)
+						BlockLeafIndices[i - BlockBegin] = Tree.GetLeafNodeIndex(DataSet, i);
+
+					for (uint64_t i = BlockBegin; i < BlockEnd; ++i)
+					{
+						const DecisionNode<T, S, R>& Leaf = Tree.GetNode(BlockLeafIndices[i - BlockBegin]);
+						// Nothing is allocated or reference counted (see MergeStatistics())
+						MergeStatistics(Results[i - Begin], Leaf.GetStatistics());
+						if (LeafData != nullptr)
+							(*LeafData)[i - Begin].Merge(std::shared_ptr<R>(std::shared_ptr<R>(), const_cast<R *>(&Leaf.GetLeafData()))); // Only read
+					}
+				}
+			}
+		};
+
+		// Same as TestBatch() for classification, but trees are applied in order and testing of a data point stops once
+		// the class with most votes cannot change anymore (the remaining trees are bounded by their largest leaves)
+		// The winning class is the same as when testing with all trees. Only the probabilities are from fewer trees
+		// If ConfidenceMargin is positive, testing also stops once the probability of the winning class exceeds that
+		// of the runner-up by ConfidenceMargin. This can change decisions. NumTreesEvaluated[i - Begin] is the number
+		// of trees that tested data point i. Statistics must be class histograms (AbstractStatistics::GetLabelCounts())
+		// otherwise all trees are evaluated
+		void TestBatchEarlyExit(AbstractDataSet& DataSet, std::vector<S>& Results, std::vector<int>& NumTreesEvaluated, VPFloat ConfidenceMargin = 0.0
+			, uint64_t Begin = 0, uint64_t End = std::numeric_limits<uint64_t>::max(), int NumThreads = 0) const
+		{
+			End = std::min(End, DataSet.Size());
+			if (Begin >= End)
+				return;
+			uint64_t NumDataPoints = End - Begin;
+			if (uint64_t(Results.size()) < NumDataPoints)
+				throw std::runtime_error("Output for batch testing is smaller than the number of data points.");
+			if (m_nTrees > 0 && m_Trees[0]->GetNode(0).GetFeatureResponse().isDataSetSupported(DataSet) == false)
+				throw std::runtime_error("Forest cannot be tested on this type of dataset.");
+			if (NumThreads <= 0)
+				NumThreads = omp_get_max_threads();
+			NumTreesEvaluated.assign(NumDataPoints, m_nTrees);
+
+			const int64_t BlockSize = 1024;
+			int64_t NumBlocks = (int64_t(NumDataPoints) + BlockSize - 1) / BlockSize;
+			std::vector<int> LeafIndices(BlockSize * NumThreads);
+			std::vector<int> ActiveOffsets(BlockSize * NumThreads); // Data points of a block that are still tested
+#pragma omp parallel for schedule(dynamic) num_threads(NumThreads)
+			for (int64_t Block = 0; Block < NumBlocks; ++Block)
+			{
+				int * BlockLeafIndices = LeafIndices.data() + BlockSize * omp_get_thread_num();
+				int * Active = ActiveOffsets.data() + BlockSize * omp_get_thread_num();
+				uint64_t BlockBegin = Begin + Block * BlockSize;
+				int NumActive = int(std::min(BlockBegin + BlockSize, End) - BlockBegin);
+				for (int a = 0; a < NumActive; ++a)
+					Active[a] = int(BlockBegin - Begin) + a;
+
+				for (int t = 0; t < m_nTrees && NumActive > 0; ++t)
+				{
+					const DecisionTree<T, S, R>& Tree = *m_Trees[t];
+					for (int a = 0; a < NumActive; ++a)
+						BlockLeafIndices[a] = Tree.GetLeafNodeIndex(DataSet, Begin + Active[a]);
+
+					int NumStillActive = 0;
+					for (int a = 0; a < NumActive; ++a)
+					{
+						S& Stats = Results[Active[a]];
+						MergeStatistics(Stats, Tree.GetNode(BlockLeafIndices[a]).GetStatistics());
+						if (isVoteDecided(Stats, m_RemainingVotes[t + 1], ConfidenceMargin))
+							NumTreesEvaluated[Active[a]] = t + 1;
+						else
+							Active[NumStillActive++] = Active[a];
+					}
+					NumActive = NumStillActive;
+				}
+			}
+		};
+
 		void Serialize(std::ostream& OutputStream) const
 		{
 			OutputStream.write((const char *)(&m_nTrees), sizeof(int));
@@ -2,12 +2,15 @@
 #define _DECISIONFORESTBUILDER_HPP_
 
 #include <memory>
+#include <algorithm>
+#include <omp.h>
 
 #include "DecisionForest.hpp"
 #include "DecisionTreeBuilder.hpp"
 #include "DataSetIndex.hpp"
 #include "Randomizer.hpp"
 #include "Utilities.hpp"
+#include "TrainingReport.hpp"
 
 namespace Kaadugal
 {
@@ -22,22 +25,32 @@ namespace Kaadugal
 	// T: AbstractFeatureResponse which is the feature response function or weak learner
 	// S: AbstractStatistics which contains some statistics about node from training
 	// R: AbstractLeafData, arbitrary data stored if this is a leaf node
-	template<class T, class S, class R = AbstractLeafData>
+	// O: Split objective (see SplitObjective.hpp)
+	template<class T, class S, class R = AbstractLeafData, class O = InformationGain>
 	class DecisionForestBuilder
 	{
 	private:
 		std::shared_ptr<AbstractDataSet> m_DataSet;
 		std::unique_ptr<DataSetIndex> m_DataSetIndex;
-		std::vector<std::shared_ptr<DataSetIndex>> m_DataSubsetsIdx; // Each subset is passed to a tree for training
+		std::vector<std::shared_ptr<DataSetIndex>> m_DataSubsetsIdx; // Each subset is passed to a tree for training. Indexed by tree
 		const ForestBuilderParameters& m_Parameters; // Parameters also should never be modified
-		std::vector<DecisionTreeBuilder<T, S, R>> m_TreeBuilders;
+		std::vector<DecisionTreeBuilder<T, S, R, O>> m_TreeBuilders;
 		DecisionForest<T, S, R> m_Forest;
+		std::vector<int> m_TreeIndices; // Index of every tree of m_Forest among all m_Parameters.m_NumTrees trees
+		TrainingReport m_Report;
+		uint64_t m_Seed; // m_Parameters.m_Seed or a random seed. Tree i is keyed with GetTreeSeed(i)
 		bool m_isForestTrained;
 
 		uint64_t m_TimeStartedBuild;
 		uint64_t m_TimeFinishedBuild;
 
-		void RandomPartition(void)
+		uint64_t GetTreeSeed(int TreeIndex) const
+		{
+			return Randomizer::MixSeed(m_Seed, TreeIndex);
+		};
+
+		// Only the subsets of trees [FirstTree, EndTree) are needed. With a seed, they do not depend on the range
+		void RandomPartition(int FirstTree, int EndTree)
 		{
 			int SetSize = m_DataSet->Size();
 			// Create an indices set with all indices
@@ -47,7 +60,9 @@ namespace Kaadugal
 
 			// Contains index to all points in the data set
 			m_DataSetIndex = std::unique_ptr<DataSetIndex>(new DataSetIndex(m_DataSet, Indices));
+			m_DataSubsetsIdx.assign(m_Parameters.m_NumTrees, nullptr);
 
+			Randomizer::Get().SetStream(m_Seed, 0);
 			std::shuffle(Indices.begin(), Indices.end(), Randomizer::Get().GetRNG());
 			// for(int i = 0; i < SetSize; ++i)
 			// 	std::cout << Indices[i] << std::endl;
@@ -78,35 +93,35 @@ namespace Kaadugal
 					//     std::cout << SubIdx[i] << std::endl;
 					// std::cout << std::endl;
 
-					m_DataSubsetsIdx.push_back(std::make_shared<DataSetIndex>(DataSetIndex(m_DataSet, SubIdx)));
+					m_DataSubsetsIdx[i] = std::make_shared<DataSetIndex>(DataSetIndex(m_DataSet, SubIdx));
 				}
 			}
 			else if (SamplType == TreeDataSamplingType::Constant)
 			{
 				std::cout << "[ INFO ]: Passing all data to all trees." << std::endl;
 				// OPTION 2: Pass all the data to all the trees and let randomness take care
-				int NumSubsets = m_Parameters.m_NumTrees;
-				for (int i = 0; i < NumSubsets; ++i)
+				for (int i = FirstTree; i < EndTree; ++i)
 				{
+					Randomizer::Get().SetStream(GetTreeSeed(i), 0); // Stream 0 of a tree is for its data
 					std::vector<int> SubIdx = Indices;
 					std::shuffle(SubIdx.begin(), SubIdx.end(), Randomizer::Get().GetRNG()); // Shuffle just to be sure
 
-					m_DataSubsetsIdx.push_back(std::make_shared<DataSetIndex>(DataSetIndex(m_DataSet, SubIdx)));
+					m_DataSubsetsIdx[i] = std::make_shared<DataSetIndex>(DataSetIndex(m_DataSet, SubIdx));
 				}
 			}
 			else if (SamplType == TreeDataSamplingType::Bagging)
 			{
 				std::cout << "[ INFO ]: Using bagging to split data between trees." << std::endl;
 				// OPTION 3: Perform bagging with each tree getting SetSize bootstrap samples (i.e. sampled with replacement)
-				int NumSubsets = m_Parameters.m_NumTrees;
 				int SubsetSize = SetSize;
-				for (int i = 0; i < NumSubsets; ++i)
+				for (int i = FirstTree; i < EndTree; ++i)
 				{
+					Randomizer::Get().SetStream(GetTreeSeed(i), 0); // Stream 0 of a tree is for its data
 					std::vector<int> SubIdx;
 					for (int j = 0; j < SubsetSize; ++j)
 						SubIdx.push_back(Randomizer::GetRandomElement<int>(Indices)); // Random sampling *with* replacement
 
-					m_DataSubsetsIdx.push_back(std::make_shared<DataSetIndex>(DataSetIndex(m_DataSet, SubIdx)));
+					m_DataSubsetsIdx[i] = std::make_shared<DataSetIndex>(DataSetIndex(m_DataSet, SubIdx));
 				}
 			}
 		};
@@ -114,45 +129,118 @@ namespace Kaadugal
 	public:
 		DecisionForestBuilder(const ForestBuilderParameters& Parameters)
 			: m_Parameters(Parameters)
+			, m_Seed(Parameters.m_Seed != 0 ? Parameters.m_Seed : Randomizer::GetRandomSeed())
 			, m_isForestTrained(false)
 		{
 			for (int i = 0; i < m_Parameters.m_NumTrees; ++i)
-				m_TreeBuilders.push_back(DecisionTreeBuilder<T, S, R>(m_Parameters));
+			{
+				m_TreeBuilders.push_back(DecisionTreeBuilder<T, S, R, O>(m_Parameters));
+				m_TreeBuilders.back().SetSeed(GetTreeSeed(i));
+			}
 		};
 
-		bool Build(std::shared_ptr<AbstractDataSet> DataSet)
+		// Trains trees [FirstTree, EndTree) of the forest (all by default). Several processes can each train a range of the
+		// trees and merge them later (see ForestShard). With a seed, a tree is the same whichever range and with how many
+		// threads it is trained
+		bool Build(std::shared_ptr<AbstractDataSet> DataSet, int FirstTree = 0, int EndTree = -1)
 		{
+			if (EndTree < 0)
+				EndTree = m_Parameters.m_NumTrees;
+			FirstTree = std::max(0, FirstTree);
+			EndTree = std::min(EndTree, m_Parameters.m_NumTrees);
+			if (FirstTree >= EndTree)
+			{
+				std::cout << "[ WARN ]: No trees to train in range [" << FirstTree << ", " << EndTree << ")." << std::endl;
+				return false;
+			}
 			m_DataSet = DataSet;
 			if (uint64_t(m_Parameters.m_NumTrees) > m_DataSet->Size())
 			{
 				std::cout << "[ WARN ]: The number of trees (" << m_Parameters.m_NumTrees << ") is greater than the number of training samples (" << m_DataSet->Size() << "). Cannot train forest." << std::endl;
 				return false;
 			}
+			// Quantize once for all trees
+			if (m_Parameters.m_SplitSearch == SplitSearch::Histogram && m_DataSet->Quantize() == false)
+				std::cout << "[ WARN ]: Data set cannot be quantized. Using bucketed split search instead of histograms." << std::endl;
 
 			bool Success = true;
 
-			RandomPartition(); // Randomly partition data set into NumTrees subsets
+			RandomPartition(FirstTree, EndTree); // Randomly partition data set into NumTrees subsets
 
-			int nTreeBuilders = m_TreeBuilders.size();
+			int nTreeBuilders = EndTree - FirstTree;
+			for (int i = FirstTree; i < EndTree; ++i)
+				m_TreeBuilders[i].SetTreeIndex(i);
 			m_TimeStartedBuild = GetCurrentEpochTime();
-			for (int i = 0; i < nTreeBuilders; ++i)
+			if (m_Parameters.m_ParallelTrees && nTreeBuilders > 1)
 			{
-				std::cout << "[ INFO ]: Training tree number " << i << "..." << std::endl;
-				bool TreeSuccess = m_TreeBuilders[i].Build(m_DataSubsetsIdx[i]);
-				Success &= TreeSuccess;
-				if (TreeSuccess)
-					m_Forest.AddTree(m_TreeBuilders[i].GetTree());
-				else
-					std::cout << "[ ERROR ]: Problem training tree number " << i << "." << std::endl;
+				// Threads are split between trees (outer) and the nodes within each tree (inner, nested)
+				int NumThreads = std::max(1, std::min(m_Parameters.m_NumThreads, omp_get_max_threads()));
+				int NumTreeThreads = std::min(nTreeBuilders, NumThreads);
+				int NumNodeThreads = std::max(1, NumThreads / NumTreeThreads);
+				std::cout << "[ INFO ]: Training " << NumTreeThreads << " trees at a time with " << NumNodeThreads << " thread(s) each..." << std::endl;
+				if (NumNodeThreads > 1)
+					omp_set_max_active_levels(std::max(2, omp_get_max_active_levels()));
+
+				std::vector<char> TreeSuccess(nTreeBuilders, 0);
+#pragma omp parallel for schedule(dynamic, 1) num_threads(NumTreeThreads)
+				for (int t = 0; t < nTreeBuilders; ++t)
+				{
+					int i = FirstTree + t;
+					m_TreeBuilders[i].SetNumThreads(NumNodeThreads);
+					m_TreeBuilders[i].SetVerbose(false);
+#pragma omp critical(KaadugalOutput)
+					std::cout << "[ INFO ]: Training tree number " << i << "..." << std::endl;
+					TreeSuccess[t] = m_TreeBuilders[i].Build(m_DataSubsetsIdx[i]);
+					m_TreeBuilders[i].ReleaseWorkspaces(); // Every tree has its own builder, which stays alive until all trees are trained
+				}
+
+				// Add trees in order so that the forest does not depend on scheduling
+				for (int t = 0; t < nTreeBuilders; ++t)
+				{
+					int i = FirstTree + t;
+					Success &= TreeSuccess[t] != 0;
+					if (TreeSuccess[t])
+					{
+						m_Forest.AddTree(m_TreeBuilders[i].GetTree());
+						m_TreeIndices.push_back(i);
+					}
+					else
+						std::cout << "[ ERROR ]: Problem training tree number " << i << "." << std::endl;
+				}
+			}
+			else
+			{
+				for (int i = FirstTree; i < EndTree; ++i)
+				{
+					std::cout << "[ INFO ]: Training tree number " << i << "..." << std::endl;
+					bool TreeSuccess = m_TreeBuilders[i].Build(m_DataSubsetsIdx[i]);
+					m_TreeBuilders[i].ReleaseWorkspaces();
+					Success &= TreeSuccess;
+					if (TreeSuccess)
+					{
+						m_Forest.AddTree(m_TreeBuilders[i].GetTree());
+						m_TreeIndices.push_back(i);
+					}
+					else
+						std::cout << "[ ERROR ]: Problem training tree number " << i << "." << std::endl;
+				}
 			}
 			m_TimeFinishedBuild = GetCurrentEpochTime();
-			std::cout << "[ INFO ]: Forest training took: " << (m_TimeFinishedBuild - m_TimeStartedBuild) * 1e-6 << " s." << std::endl;
+			m_Report.m_Time = m_TimeFinishedBuild - m_TimeStartedBuild;
+			m_Report.m_NumThreads = std::max(1, std::min(m_Parameters.m_NumThreads, omp_get_max_threads()));
+			m_Report.m_Trees.clear();
+			for (int i = FirstTree; i < EndTree; ++i)
+				m_Report.m_Trees.push_back(m_TreeBuilders[i].GetReport());
+			std::cout << "[ INFO ]: Forest training took: " << m_Report.m_Time * 1e-6 << " s (thread utilization " << m_Report.GetThreadUtilization() << ")." << std::endl;
 
 			m_isForestTrained = Success;
 			return m_isForestTrained;
 		};
 
 		DecisionForest<T, S, R>& GetForest(void) { return m_Forest; };
+		const std::vector<int>& GetTreeIndices(void) const { return m_TreeIndices; };
+		// Profile of the trees trained by the last Build() (see TrainingReport::SaveJSON())
+		const TrainingReport& GetReport(void) const { return m_Report; };
 		bool DoneBuild(void) { return m_isForestTrained; };
 	};
 } // namespace Kaadugal
@@ -28,6 +28,7 @@ namespace Kaadugal
 		T m_FeatureResponse; // The feature response function
 		S m_Statistics; // Node statistics
 		R m_Data; // Arbitrary leaf data
+		int m_LeftChild; // Index of the left child in the tree's node array. Right child is at m_LeftChild + 1. -1 if none
 
 	public:
 		DecisionNode(void) // With no arguments, we construct an invalid node
@@ -36,6 +37,7 @@ namespace Kaadugal
 			, m_FeatureResponse(T())
 			, m_Statistics(S())
 			, m_Data(R())
+			, m_LeftChild(-1)
 		{
 
 		};
@@ -47,6 +49,7 @@ namespace Kaadugal
 			m_Statistics = RHS.m_Statistics;
 			m_Data = RHS.m_Data;
 			m_Type = RHS.m_Type;
+			m_LeftChild = RHS.m_LeftChild;
 		};
 
 		void Serialize(std::ostream& OutputStream) const
@@ -85,8 +88,16 @@ namespace Kaadugal
 			m_Data = Data; // Deep copy
 		};
 
+		// Children are always allocated in pairs so only the left child index is stored
+		void SetChildren(int LeftChild) { m_LeftChild = LeftChild; };
+		int GetLeftChild(void) const { return m_LeftChild; };
+		int GetRightChild(void) const { return m_LeftChild + 1; };
+
 		const R& GetLeafData(void) const { return m_Data; };
+		R& GetLeafData(void) { return m_Data; };
 		const S& GetStatistics(void) const { return m_Statistics; };
+		S& GetStatistics(void) { return m_Statistics; };
+		const T& GetFeatureResponse(void) const { return m_FeatureResponse; };
 		T& GetFeatureResponse(void) { return m_FeatureResponse; };
 		const VPFloat& GetThreshold(void) const { return m_Threshold; };
 		Kaadugal::NodeType GetType(void) const { return m_Type; };
@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <stdexcept>
+#include <algorithm>
+#include <cstdint>
 
 #include "DecisionNode.hpp"
 #include "Abstract/AbstractDataSet.hpp"
@@ -20,7 +22,11 @@ namespace Kaadugal
 		int m_MaxDecisionLevels; // The root node is level 0
 		int m_NumNodes;
 
-		int TraverseRecursive(const std::shared_ptr<AbstractDataPoint>& DataPointPtr, int NodeIndex)
+		// Serialized trees used to start with m_MaxDecisionLevels (never negative) followed by a dense array of
+		// 2^(l+1) - 1 nodes. The compact layout starts with this (negative) tag and stores child indices
+		static const int s_CompactLayoutTag = -1;
+
+		int TraverseRecursive(const std::shared_ptr<AbstractDataPoint>& DataPointPtr, int NodeIndex) const
 		{
 			int OutputNodeIndex = NodeIndex;
 			if (m_Nodes[NodeIndex].GetType() == Kaadugal::NodeType::LeafNode
@@ -30,9 +36,9 @@ namespace Kaadugal
 			}
 
 			if (m_Nodes[NodeIndex].GetFeatureResponse().GetResponse(DataPointPtr) > m_Nodes[NodeIndex].GetThreshold()) // Go left. This is same logic as in Tree builder, partition
-				OutputNodeIndex = TraverseRecursive(DataPointPtr, 2 * NodeIndex + 1);
+				OutputNodeIndex = TraverseRecursive(DataPointPtr, m_Nodes[NodeIndex].GetLeftChild());
 			else // Go right
-				OutputNodeIndex = TraverseRecursive(DataPointPtr, 2 * NodeIndex + 2);
+				OutputNodeIndex = TraverseRecursive(DataPointPtr, m_Nodes[NodeIndex].GetRightChild());
 
 			return OutputNodeIndex;
 		};
@@ -49,23 +55,58 @@ namespace Kaadugal
 				m_MaxDecisionLevels = MaxDecisionLevels;
 			}
 
-			// Following advice from Efficient Implementation of Decision Forests, Shotton et al. 2013
-			// While allocating for more nodes than needed (in case trees are unbalanced which is bad anyway)
-			// is wasteful memory-wise, it is efficient for access during testing.
+			// Only the root is allocated. Nodes are added in pairs with AddChildren() as the tree grows and split
+			// nodes store the index of their children. Deep unbalanced trees only need memory for the nodes
+			// they have instead of a dense array of 2^(l+1) - 1 nodes
+			m_Nodes.resize(1);
+			m_NumNodes = m_Nodes.size();
+		};
 
-			// NOTE: Will crash if this exceeds available system memory
-			m_Nodes.resize((1 << (MaxDecisionLevels + 1)) - 1); // 2^(l+1) - 1
+		// Appends two invalid nodes as children of NodeIndex and returns the index of the left one
+		// NOTE: This can reallocate the node array. Previously returned node references are invalidated
+		int AddChildren(int NodeIndex)
+		{
+			int LeftChild = m_Nodes.size();
+			m_Nodes.resize(LeftChild + 2);
+			m_Nodes[NodeIndex].SetChildren(LeftChild);
+			m_NumNodes = m_Nodes.size();
+
+			return LeftChild;
+		};
+
+		// Renumbers the nodes in breadth-first order (children left to right). Parallel training allocates nodes in the
+		// order in which threads happen to split them, so this makes the node array depend on the tree alone
+		void SortBreadthFirst(void)
+		{
+			std::vector<DecisionNode<T, S, R>> SortedNodes;
+			SortedNodes.reserve(m_Nodes.size());
+			SortedNodes.push_back(m_Nodes[0]);
+			for (int i = 0; i < int(SortedNodes.size()); ++i)
+			{
+				int LeftChild = SortedNodes[i].GetLeftChild();
+				if (LeftChild < 0)
+					continue;
+
+				SortedNodes[i].SetChildren(SortedNodes.size());
+				SortedNodes.push_back(m_Nodes[LeftChild]);
+				SortedNodes.push_back(m_Nodes[LeftChild + 1]);
+			}
+			m_Nodes.swap(SortedNodes);
 			m_NumNodes = m_Nodes.size();
 		};
 
 		void Serialize(std::ostream& OutputStream) const
 		{
+			int LayoutTag = s_CompactLayoutTag;
+			OutputStream.write((const char *)(&LayoutTag), sizeof(int));
 			OutputStream.write((const char *)(&m_MaxDecisionLevels), sizeof(int));
 			OutputStream.write((const char *)(&m_NumNodes), sizeof(int));
 			int nLeaves = 0;
 			for (int i = 0; i < m_NumNodes; ++i)
 			{
 				m_Nodes[i].Serialize(OutputStream);
+				int LeftChild = m_Nodes[i].GetLeftChild();
+				OutputStream.write((const char *)(&LeftChild), sizeof(int));
 				if (m_Nodes[i].GetType() == Kaadugal::LeafNode)
 					nLeaves++;
 			}
@@ -74,25 +115,73 @@ namespace Kaadugal
 
 		void Deserialize(std::istream& InputStream)
 		{
+			int LayoutTag = 0;
+			InputStream.read((char *)(&LayoutTag), sizeof(int));
+			if (LayoutTag >= 0) // Old dense layout. The first value is m_MaxDecisionLevels
+			{
+				m_MaxDecisionLevels = LayoutTag;
+				DeserializeDense(InputStream);
+				return;
+			}
+			if (LayoutTag != s_CompactLayoutTag)
+				throw std::runtime_error("Unknown tree layout in file.");
+
 			InputStream.read((char *)(&m_MaxDecisionLevels), sizeof(int));
 			InputStream.read((char *)(&m_NumNodes), sizeof(int));
-			// NOTE: Will crash if this exceeds available system memory
 			int nLeaves = 0;
 			m_Nodes.resize(m_NumNodes);
 			for (int i = 0; i < m_NumNodes; ++i)
 			{
 				m_Nodes[i].Deserialize(InputStream);
+				int LeftChild = -1;
+				InputStream.read((char *)(&LeftChild), sizeof(int));
+				m_Nodes[i].SetChildren(LeftChild);
 				if (m_Nodes[i].GetType() == Kaadugal::LeafNode)
 					nLeaves++;
 			}
 			std::cout << "Number of leaves: " << nLeaves << std::endl;
 		};
 
-		const std::vector<DecisionNode<T, S, R>>& GetAllNodes(void) { return m_Nodes; };
+		// Reads nodes of the old dense layout (children of i at 2i+1 and 2i+2) and keeps only the reachable ones
+		void DeserializeDense(std::istream& InputStream)
+		{
+			int NumDenseNodes = 0;
+			InputStream.read((char *)(&NumDenseNodes), sizeof(int));
+			// NOTE: Will crash if this exceeds available system memory
+			std::vector<DecisionNode<T, S, R>> DenseNodes(NumDenseNodes);
+			for (int i = 0; i < NumDenseNodes; ++i)
+				DenseNodes[i].Deserialize(InputStream);
+
+			m_Nodes.clear();
+			int nLeaves = 0;
+			if (NumDenseNodes > 0)
+			{
+				std::vector<int> DenseIndices(1, 0); // Dense index of each compact node
+				m_Nodes.push_back(DenseNodes[0]);
+				for (int i = 0; i < int(m_Nodes.size()); ++i)
+				{
+					int DenseIndex = DenseIndices[i];
+					if (m_Nodes[i].GetType() == Kaadugal::LeafNode)
+						nLeaves++;
+					if (m_Nodes[i].GetType() != Kaadugal::SplitNode || 2 * DenseIndex + 2 >= NumDenseNodes)
+						continue;
+
+					m_Nodes[i].SetChildren(m_Nodes.size());
+					m_Nodes.push_back(DenseNodes[2 * DenseIndex + 1]);
+					m_Nodes.push_back(DenseNodes[2 * DenseIndex + 2]);
+					DenseIndices.push_back(2 * DenseIndex + 1);
+					DenseIndices.push_back(2 * DenseIndex + 2);
+				}
+			}
+			m_NumNodes = m_Nodes.size();
+			std::cout << "Number of leaves: " << nLeaves << " (converted from dense layout)" << std::endl;
+		};
+
+		const std::vector<DecisionNode<T, S, R>>& GetAllNodes(void) const { return m_Nodes; };
 		const DecisionNode<T, S, R>& GetNode(int i) const { return m_Nodes[i]; }; // Read-only
 		DecisionNode<T, S, R>& GetNode(int i) { return m_Nodes[i]; };
-		const int& GetNumNodes(void) { return m_NumNodes; };
-		const int& GetMaxDecisionLevels(void) { return m_MaxDecisionLevels; };
+		const int& GetNumNodes(void) const { return m_NumNodes; };
+		const int& GetMaxDecisionLevels(void) const { return m_MaxDecisionLevels; };
 
 		void SetNumNodes(int NumNodes)
 		{
@@ -108,7 +197,8 @@ namespace Kaadugal
 			m_Nodes[i] = Node;
 		};
 
-		const std::shared_ptr<S> Test(const std::shared_ptr<AbstractDataPoint>& DataPointPtr, std::shared_ptr<R> LeafData = nullptr)
+		// Testing is const and does not change the tree, so any number of threads can test one tree at once
+		const std::shared_ptr<S> Test(const std::shared_ptr<AbstractDataPoint>& DataPointPtr, std::shared_ptr<R> LeafData = nullptr) const
 		{
 			if (isValid() == false)
 				std::cout << "[ WARN ]: This tree is invalid. Cannot test data point." << std::endl;
@@ -121,11 +211,11 @@ namespace Kaadugal
 
 			// Iteration
 			int LeafNodeIdx = 0;
-			while (m_Nodes[LeafNodeIdx].GetType() != Kaadugal::NodeType::LeafNode)
+			while (m_Nodes[LeafNodeIdx].GetType() == Kaadugal::NodeType::SplitNode)
 			{
 				// Avoid branch misprediction by removing if condition
 				bool isGoLeft = m_Nodes[LeafNodeIdx].GetFeatureResponse().GetResponse(DataPointPtr) > m_Nodes[LeafNodeIdx].GetThreshold();
-				LeafNodeIdx = isGoLeft ? (2 * LeafNodeIdx + 1) : (2 * LeafNodeIdx + 2);
+				LeafNodeIdx = m_Nodes[LeafNodeIdx].GetLeftChild() + (isGoLeft ? 0 : 1);
 			}
 
 			//// OPTIMIZATION TESTS
@@ -153,7 +243,42 @@ namespace Kaadugal
 			return TreeLeafStatsPtr;
 		};
 
-		int TestRecursive(const std::shared_ptr<AbstractDataPoint>& DataPointPtr, int NodeIndex, S& TreeLeafStats)
+		// Largest number of votes (data points) of a leaf if the statistics are class histograms (see
+		// AbstractStatistics::GetLabelCounts()), -1 otherwise. Bounds how much the tree can change a forest vote
+		int64_t GetMaxLeafVotes(void) const
+		{
+			int64_t MaxVotes = 0;
+			for (int i = 0; i < m_NumNodes; ++i)
+			{
+				if (m_Nodes[i].GetType() != Kaadugal::NodeType::LeafNode)
+					continue;
+				int NumClasses = 0;
+				const int * Counts = m_Nodes[i].GetStatistics().GetLabelCounts(NumClasses);
+				if (Counts == nullptr)
+					return -1;
+				int64_t Votes = 0;
+				for (int c = 0; c < NumClasses; ++c)
+					Votes += Counts[c];
+				MaxVotes = std::max(MaxVotes, Votes);
+			}
+
+			return MaxVotes;
+		};
+
+		// Index of the leaf node reached by the data point at DataPointIndex in DataSet. Nothing is copied
+		int GetLeafNodeIndex(AbstractDataSet& DataSet, uint64_t DataPointIndex) const
+		{
+			int LeafNodeIdx = 0;
+			while (m_Nodes[LeafNodeIdx].GetType() == Kaadugal::NodeType::SplitNode)
+			{
+				bool isGoLeft = m_Nodes[LeafNodeIdx].GetFeatureResponse().GetResponseAt(DataSet, DataPointIndex) > m_Nodes[LeafNodeIdx].GetThreshold();
+				LeafNodeIdx = m_Nodes[LeafNodeIdx].GetLeftChild() + (isGoLeft ? 0 : 1);
+			}
+
+			return LeafNodeIdx;
+		};
+
+		int TestRecursive(const std::shared_ptr<AbstractDataPoint>& DataPointPtr, int NodeIndex, S& TreeLeafStats) const
 		{
 			//// Sanity check
 			//if (m_Nodes[NodeIndex].GetType() == Kaadugal::NodeType::Invalid) // Termination condition
@@ -175,13 +300,13 @@ namespace Kaadugal
 			// std::cout << "Threshold: " << m_Nodes[NodeIndex].GetThreshold() << std::endl << std::endl;
 			//m_Nodes[NodeIndex].GetFeatureResponse().Special();
 			if (m_Nodes[NodeIndex].GetFeatureResponse().GetResponse(DataPointPtr) > m_Nodes[NodeIndex].GetThreshold()) // Go left. This is same logic as in Tree builder, partition
-				return TestRecursive(DataPointPtr, 2 * NodeIndex + 1, TreeLeafStats);
+				return TestRecursive(DataPointPtr, m_Nodes[NodeIndex].GetLeftChild(), TreeLeafStats);
 
-			return TestRecursive(DataPointPtr, 2 * NodeIndex + 2, TreeLeafStats);
+			return TestRecursive(DataPointPtr, m_Nodes[NodeIndex].GetRightChild(), TreeLeafStats);
 		};
 
 		// Return the node index for the leaf or the first invalid node reached by the data point
-		int TraverseToFrontier(std::shared_ptr<AbstractDataPoint> DataPointPtr)
+		int TraverseToFrontier(const std::shared_ptr<AbstractDataPoint>& DataPointPtr) const
 		{
 			if (GetNumNodes() <= 0)
 				std::cout << "[ WARN ]: No nodes in this tree. Check config." << std::endl;
@@ -191,7 +316,7 @@ namespace Kaadugal
 			return FrontierIndex;
 		};
 
-		bool isValid(void)
+		bool isValid(void) const
 		{
 			if (GetNumNodes() <= 0)
 				return false;
@@ -2,8 +2,10 @@
 
 #include <memory>
 #include <map>
+#include <algorithm>
 #include <omp.h>
 #include <chrono> // This does not work with MSVC 2010 or GCC old versions
+#include <sstream>
 
 #include "DecisionTree.hpp"
 #include "Abstract/AbstractDataSet.hpp"
@@ -11,6 +13,10 @@
 #include "DataSetIndex.hpp"
 #include "Randomizer.hpp"
 #include "Utilities.hpp"
+#include "LabelCounts.hpp"
+#include "SplitObjective.hpp"
+#include "TrainingReport.hpp"
+#include "SplitWorkspace.hpp"
 
 // TODO: Avoid using push_back()?
 namespace Kaadugal
@@ -18,18 +24,22 @@ namespace Kaadugal
 	// T: AbstractFeatureResponse which is the feature response function or weak learner
 	// S: AbstractStatistics which contains some statistics about node from training
 	// R: AbstractLeafData, arbitrary data stored if this is a leaf node
-	template<class T, class S, class R = AbstractLeafData>
+	// O: Split objective, e.g. InformationGain or GiniImpurity (see SplitObjective.hpp)
+	template<class T, class S, class R = AbstractLeafData, class O = InformationGain>
 	class DecisionTreeBuilder
 	{
 	private:
 		std::shared_ptr<DecisionTree<T, S, R>> m_Tree;
 		// std::shared_ptr<DataSetIndex> m_PartitionedDataSetIdx;
 		const ForestBuilderParameters& m_Parameters; // Parameters also should never be modified
+		O m_Objective;
 		bool m_isTreeTrained;
 
 		// Members for bread-first building
 		std::vector<int> m_FrontierNodes; // Is not strictly the frontier but a subset with all non-built nodes
 		std::vector<int> m_DataDeepestNodeIndex; // Stores the node index of the (currently) lowest node that a data point reaches. Same size as the number of data points
+		std::vector<int> m_FrontierSlots; // Maps node index to its position in m_FrontierNodes, -1 if the node is not in the frontier
+		std::vector<uint64_t> m_NodeKeys; // Random stream of each node (see GetChildKey()), indexed by node
 
 		// When training tree separately, we need a pointer to the data
 		std::shared_ptr<AbstractDataSet> m_DataSet;
@@ -38,27 +48,29 @@ namespace Kaadugal
 		int m_ReachedMaxDepth;
 		uint64_t m_TimeStartedBuild;
 		uint64_t m_TimeFinishedBuild;
-		std::vector<VPFloat> m_TreeLevelTimes; // Store time for training each tree level
-
-		// Structure needed for OpenMP accumulator variable
-		struct OptParamsStruct
+		TreeReport m_Report; // Time, counts and phases of every level (see GetReport())
+
+		// Key of the random streams of this tree. Every random draw of training comes from the stream of its node and
+		// candidate (see Randomizer::SetStream()) so the tree does not depend on the number of threads or scheduling
+		// Stream 0 is for the whole tree (substream 0: its data, 1: leaves), nodes use their keys (see GetChildKey())
+		uint64_t m_Seed;
+
+		// Threads used for work within a node. Lower than m_Parameters.m_NumThreads when trees are trained in parallel
+		int m_NumThreads;
+		bool m_isVerbose; // Print progress at each depth. Disabled when trees are trained in parallel
+		std::vector<SplitWorkspace<S>> m_Workspaces; // One per thread, kept between trees (see GetWorkspace(), ReleaseWorkspaces())
+		std::shared_ptr<S> m_EmptyStats; // Statistics of no data points of the current tree. Accumulators start from them
+
+		// Depth-first nodes with fewer data points than this are built serially by one thread (no tasks)
+		static const int s_MinTaskDataSize = 2048;
+		static const uint64_t s_ScatteredReadBytes = 2 << 20; // Storage that one scattered read of out-of-core data may map (a huge page)
+		static const uint64_t s_RootNodeKey = 1;
+		static const int64_t s_MaxAccumulatorInts = int64_t(1) << 22; // Breadth-first bucket accumulators of all threads: 16 MB of class counts. Statistics count as 4 ints
+
+		// Random stream key of a child. Keys follow the path from the root so they do not depend on node indices
+		static uint64_t GetChildKey(uint64_t ParentKey, bool isRight)
 		{
-		public:
-			OptParamsStruct(void)
-			{
-				s_isValid = false;
-			};
-
-			OptParamsStruct(const VPFloat& Thresh, const T& FeatureResponse, const bool isValid)
-				: s_Threshold(Thresh)
-				, s_FeatureResponse(FeatureResponse)
-				, s_isValid(isValid)
-			{
-
-			};
-			VPFloat s_Threshold;
-			T s_FeatureResponse;
-			bool s_isValid;
+			return Randomizer::MixSeed(ParentKey, isRight ? 1 : 0);
 		};
 
 	public:
@@ -67,41 +79,71 @@ namespace Kaadugal
 
 		DecisionTreeBuilder(const ForestBuilderParameters& Parameters)
 			: m_Parameters(Parameters)
+			, m_Objective(Parameters)
 			, m_isTreeTrained(false)
 			, m_ReachedMaxDepth(0)
+			, m_Seed(Parameters.m_Seed != 0 ? Parameters.m_Seed : Randomizer::GetRandomSeed())
+			, m_NumThreads(Parameters.m_NumThreads)
+			, m_isVerbose(true)
 			, m_NumLeafNodes(0)
 			, m_NumSplitNodes(0)
 		{
-			m_TreeLevelTimes.resize(m_Parameters.m_MaxLevels + 1, 0.0); // Zero indexed. 0.0 time means that level was never reached
+			m_Report.m_Levels.resize(m_Parameters.m_MaxLevels + 1); // Zero indexed
+		};
+
+		void SetNumThreads(int NumThreads) { m_NumThreads = std::max(1, NumThreads); };
+		void SetVerbose(bool isVerbose) { m_isVerbose = isVerbose; };
+		void SetTreeIndex(int TreeIndex) { m_Report.m_TreeIndex = TreeIndex; };
+		// Seed of this tree. Defaults to the seed in the parameters or a random one if that is 0
+		void SetSeed(uint64_t Seed) { m_Seed = Seed; };
+		// Build() keeps the scratch memory of its threads so that later trees of this builder do not allocate it again. This frees it
+		void ReleaseWorkspaces(void)
+		{
+			m_Workspaces.clear();
+			m_EmptyStats.reset();
 		};
 
 		bool Build(std::shared_ptr<DataSetIndex> PartitionedDataSetIdx)
 		{
 			m_Tree = std::shared_ptr<DecisionTree<T, S, R>>(new DecisionTree<T, S, R>(m_Parameters.m_MaxLevels));
 			bool Success = true;
+			m_ReachedMaxDepth = 0; // A builder may build several trees
+			m_NumLeafNodes = 0;
+			m_NumSplitNodes = 0;
+			m_Report.m_Levels.assign(m_Parameters.m_MaxLevels + 1, LevelReport());
+			m_Report.m_NumThreads = std::max(1, std::min(m_NumThreads, omp_get_max_threads()));
+			PrepareWorkspaces(PartitionedDataSetIdx);
+			m_Report.m_NumDataPoints = PartitionedDataSetIdx->Size();
 			m_TimeStartedBuild = GetCurrentEpochTime();
 			if (m_Parameters.m_TrainMethod == TrainMethod::DFS)
 			{
-				std::cout << "[ INFO ]: At depth: " << std::flush;
-				Success = BuildTreeDepthFirst(PartitionedDataSetIdx, 0, 0);
+				if (PartitionedDataSetIdx->GetDataSet()->GetStoredBytesPerDataPoint() > 0)
+					std::cout << "[ WARN ]: Depth-first training reads out-of-core data in random order. Use BFS or Hybrid instead." << std::endl;
+				if (m_isVerbose)
+					std::cout << "[ INFO ]: At depth: " << std::flush;
+				// The tree gets its own contiguous index buffer which is partitioned in place as the tree grows
+				auto IndexBuffer = std::make_shared<std::vector<int>>(PartitionedDataSetIdx->CopyIndex());
+				auto TreeDataSetIdx = std::make_shared<DataSetIndex>(PartitionedDataSetIdx->GetDataSet(), IndexBuffer, 0, int(IndexBuffer->size()));
+				Success = BuildSubtreesDepthFirst(std::vector<std::shared_ptr<DataSetIndex>>(1, TreeDataSetIdx), std::vector<int>(1, 0), std::vector<uint64_t>(1, uint64_t(s_RootNodeKey)), 0);
 			}
 			if (m_Parameters.m_TrainMethod == TrainMethod::BFS)
 				Success = BuildTreeBreadthFirst(PartitionedDataSetIdx);
 			if (m_Parameters.m_TrainMethod == TrainMethod::Hybrid)
-				Success = BuildTreeHybrid();
+				Success = BuildTreeHybrid(PartitionedDataSetIdx);
+			m_Tree->SortBreadthFirst();
 
 			m_TimeFinishedBuild = GetCurrentEpochTime();
-			std::cout << ": Finished in " << (m_TimeFinishedBuild - m_TimeStartedBuild) * 1e-6 << " s." << std::endl;
-			std::cout << "[ INFO ]: Times at each level (seconds) " << std::endl;
-
-			VPFloat TotalTime = 0.0;
-			for (unsigned int i = 0; i < m_TreeLevelTimes.size(); ++i)
-			{
-				VPFloat LevelTime = VPFloat(m_TreeLevelTimes[i]) * 1e-6;
-				TotalTime += LevelTime;
-				std::cout << LevelTime << " ";
-			}
-			std::cout << " (Total = " << TotalTime << " s)" << std::endl;
+			m_Report.m_Time = m_TimeFinishedBuild - m_TimeStartedBuild;
+			m_Report.m_ReachedMaxDepth = m_ReachedMaxDepth;
+			// Trees may be trained in parallel so print the summary in one piece. Details are in the training report
+			std::ostringstream Summary;
+			if (m_isVerbose)
+				Summary << ": ";
+			else
+				Summary << "[ INFO ]: Tree reached depth " << m_ReachedMaxDepth << ". ";
+			Summary << "Finished in " << m_Report.m_Time * 1e-6 << " s (thread utilization " << m_Report.GetThreadUtilization() << ")." << std::endl;
+#pragma omp critical(KaadugalOutput)
+			std::cout << Summary.str() << std::flush;
 
 			m_isTreeTrained = Success;
 			return m_isTreeTrained;
@@ -117,12 +159,15 @@ namespace Kaadugal
 				std::cout << "[ WARN ]: The number of training samples (" << SetSize << ") is too low. Cannot train this tree." << std::endl;
 				return false;
 			}
+			if (m_Parameters.m_SplitSearch == SplitSearch::Histogram && m_DataSet->Quantize() == false)
+				std::cout << "[ WARN ]: Data set cannot be quantized. Using bucketed split search instead of histograms." << std::endl;
 
 			// Randomize the data
 			// Create an indices set with all indices
 			std::vector<int> Indices;
 			for (int i = 0; i < SetSize; ++i)
 				Indices.push_back(i);
+			Randomizer::Get().SetStream(m_Seed, 0, 0);
 			std::shuffle(Indices.begin(), Indices.end(), Randomizer::Get().GetRNG());
 
 			// Contains index to all points in the data set BUT they are randomized
@@ -130,18 +175,66 @@ namespace Kaadugal
 			return m_isTreeTrained;
 		};
 
-		bool BuildTreeDepthFirst(std::shared_ptr<DataSetIndex> PartitionedDataSetIdx, int NodeIndex, int CurrentNodeDepth)
+		// Builds the given subtrees depth-first with a team of m_NumThreads threads. Each subtree is an OpenMP task
+		// and BuildTreeDepthFirst() spawns more tasks for large children so that threads work on whole subtrees
+		// NodeKeys are the random streams of the subtree roots. SubtreeStats are their statistics if already known (may be empty)
+		bool BuildSubtreesDepthFirst(const std::vector<std::shared_ptr<DataSetIndex>>& SubtreeDataSetIdx, const std::vector<int>& NodeIndices, const std::vector<uint64_t>& NodeKeys, int CurrentNodeDepth
+			, const std::vector<std::shared_ptr<S>>& SubtreeStats = std::vector<std::shared_ptr<S>>())
+		{
+			int NumThreads = std::max(1, std::min(m_NumThreads, omp_get_max_threads()));
+			int NumSubtrees = SubtreeDataSetIdx.size();
+			bool Success = true;
+#pragma omp parallel num_threads(NumThreads)
+#pragma omp single
+			{
+				for (int i = 0; i < NumSubtrees; ++i)
+				{
+#pragma omp task shared(Success, SubtreeDataSetIdx, NodeIndices, NodeKeys, SubtreeStats)
+					{
+						if (!BuildTreeDepthFirst(SubtreeDataSetIdx[i], NodeIndices[i], NodeKeys[i], CurrentNodeDepth, SubtreeStats.empty() ? nullptr : SubtreeStats[i]))
+						{
+#pragma omp atomic write
+							Success = false;
+						}
+					}
+				}
+			} // All tasks are complete at the implicit barrier
+
+			return Success;
+		};
+
+		// Must be called from within BuildSubtreesDepthFirst() since it relies on the enclosing parallel region for tasks
+		// NodeStats are the statistics of this node computed by the parent. They are aggregated here if null
+		bool BuildTreeDepthFirst(std::shared_ptr<DataSetIndex> PartitionedDataSetIdx, int NodeIndex, uint64_t NodeKey, int CurrentNodeDepth, std::shared_ptr<S> NodeStats = nullptr)
 		{
-			if (m_ReachedMaxDepth < CurrentNodeDepth)
+			int ReachedMaxDepth;
+#pragma omp atomic read
+			ReachedMaxDepth = m_ReachedMaxDepth;
+			if (ReachedMaxDepth < CurrentNodeDepth)
 			{
-				m_ReachedMaxDepth = CurrentNodeDepth;
-				std::cout << CurrentNodeDepth << " " << std::flush;
+#pragma omp critical(KaadugalOutput)
+				if (m_ReachedMaxDepth < CurrentNodeDepth)
+				{
+#pragma omp atomic write
+					m_ReachedMaxDepth = CurrentNodeDepth;
+					if (m_isVerbose)
+						std::cout << CurrentNodeDepth << " " << std::flush;
+				}
 			}
 			// Start time for node time computation
 			uint64_t NodeStartTime = GetCurrentEpochTime();
 
-			S ParentNodeStats(PartitionedDataSetIdx);
+			if (NodeStats == nullptr)
+			{
+				uint64_t StatsStartTime = GetCurrentEpochTime();
+				NodeStats = std::make_shared<S>(PartitionedDataSetIdx);
+				AddPhase(CurrentNodeDepth, PhaseStatistics, StatsStartTime, 1);
+			}
+			S& ParentNodeStats = *NodeStats;
 			int DataSetSize = PartitionedDataSetIdx->Size();
+			AddLevelCount(CurrentNodeDepth, &LevelReport::m_NumDataPoints, DataSetSize);
+			AbstractDataSet& DataSet = *PartitionedDataSetIdx->GetDataSet();
+			const int * Index = PartitionedDataSetIdx->GetIndexData(); // Data point indices of this node in the dataset
 			// std::cout << ParentNodeStats.GetProbability(0) << std::endl;
 
 			// Check if incoming data is fewer than 3 data points. If so then just create a leaf node
@@ -149,9 +242,8 @@ namespace Kaadugal
 			if (DataSetSize < std::max(3, m_Parameters.m_MinDataSetSize))
 			{
 				//std::cout << "[ INFO ]: Fewer than 2 data points in reached this node. Making leaf node..." << std::endl;
-				PartitionedDataSetIdx->GetDataSet()->Special(NodeIndex, PartitionedDataSetIdx->GetIndex());
-				ParentNodeStats.Special();
-				MakeLeafNode(ParentNodeStats, NodeIndex, CurrentNodeDepth, NodeStartTime, PartitionedDataSetIdx);
+				MakeSpecialLeafNode(ParentNodeStats, NodeIndex, PartitionedDataSetIdx, CurrentNodeDepth);
+				AddLevelTime(CurrentNodeDepth, NodeStartTime);
 
 				return true;
 			}
@@ -159,105 +251,42 @@ namespace Kaadugal
 			if (CurrentNodeDepth >= m_Tree->GetMaxDecisionLevels()) // Both are zero-indexed
 			{
 				//std::cout << "[ INFO ]: Terminating splitting at maximum tree depth." << std::endl;
-				PartitionedDataSetIdx->GetDataSet()->Special(NodeIndex, PartitionedDataSetIdx->GetIndex());
-				ParentNodeStats.Special();
-				MakeLeafNode(ParentNodeStats, NodeIndex, CurrentNodeDepth, NodeStartTime, PartitionedDataSetIdx);
+				MakeSpecialLeafNode(ParentNodeStats, NodeIndex, PartitionedDataSetIdx, CurrentNodeDepth);
+				AddLevelTime(CurrentNodeDepth, NodeStartTime);
 
 				return true;
 			}
 
-			// Initialize optimal values
-			VPFloat OptObjVal = -1.0; // Negative values are not possible since this is an energy
+			AddLevelCount(CurrentNodeDepth, &LevelReport::m_NumCandidates, m_Parameters.m_NumCandidateFeatures);
 			T OptFeatureResponse; // This creates an empty feature response with random response
 			VPFloat OptThreshold = 0.0;
+			VPFloat OptObjVal = FindBestSplit(ParentNodeStats, PartitionedDataSetIdx, NodeKey, CurrentNodeDepth, OptFeatureResponse, OptThreshold);
 			std::shared_ptr<DataSetIndex> OptLeftPartitionIdx;
 			std::shared_ptr<DataSetIndex> OptRightPartitionIdx;
-			S OptLeftNodeStats;
-			S OptRightNodeStats;
-
-			std::vector<VPFloat> ObjValAccum(m_Parameters.m_NumCandidateFeatures, -1.0);
-			std::vector<OptParamsStruct> OptParamsStructAccum(m_Parameters.m_NumCandidateFeatures);
-			omp_set_dynamic(0); // Explicitly disable dynamic teams
-			omp_set_num_threads(std::min(m_Parameters.m_NumThreads, omp_get_max_threads()));
-#pragma omp parallel for
-			for (int i = 0; i < m_Parameters.m_NumCandidateFeatures; ++i)
-			{
-				T FeatureResponse; // This creates an empty feature response with random response
-				std::vector<VPFloat> Responses;
-				Responses.resize(DataSetSize);
-				for (int k = 0; k < DataSetSize; ++k)
-					Responses[k] = FeatureResponse.GetResponse(PartitionedDataSetIdx->GetDataPoint(k)); // TODO: Can be parallelized/made more efficient?
-
-				const std::vector<VPFloat>& Thresholds = SelectThresholds(Responses, PartitionedDataSetIdx->Size());
-				int NumThresholds = Thresholds.size();
-
-				VPFloat LocObjVal = -1.0;
-				OptParamsStruct LocObjValStruct;
-				for (int j = 0; j < NumThresholds; ++j)
-				{
-					// First partition data based on current splitting candidates
-					std::pair<std::shared_ptr<DataSetIndex>, std::shared_ptr<DataSetIndex>> Subsets = Partition(PartitionedDataSetIdx, Responses, Thresholds[j]);
-
-					S LeftNodeStats(Subsets.first);
-					S RightNodeStats(Subsets.second);
-
-					// Then compute some objective function value. Examples: information gain, Geni index
-					VPFloat ObjVal = GetObjectiveValue(ParentNodeStats, LeftNodeStats, RightNodeStats);
-
-					if (ObjVal > LocObjVal)
-					{
-						LocObjVal = ObjVal;
-						LocObjValStruct = OptParamsStruct(Thresholds[j], FeatureResponse, true);
-					}
-				}
-
-				//if (LocObjVal < 0.0)
-				//	std::cout << "NumThresholds: " << NumThresholds << std::endl;
-				ObjValAccum[i] = LocObjVal;
-				OptParamsStructAccum[i] = LocObjValStruct;
-			}
-
-			int AccumSize = ObjValAccum.size();
-			for (int ii = 0; ii < AccumSize; ++ii)
-			{
-				if (OptParamsStructAccum[ii].s_isValid == false)
-					continue;
-
-				if (ObjValAccum[ii] > OptObjVal)
-				{
-					OptObjVal = ObjValAccum[ii];
-					OptFeatureResponse = OptParamsStructAccum[ii].s_FeatureResponse;
-					OptThreshold = OptParamsStructAccum[ii].s_Threshold;
-				}
-			}
 
 			//if (OptObjVal < 0.0)
 			//{
 			//	std::cout << "RUNTIME ERROR in BuildTreeDepthFirst() - OptObjVal is negative." << std::endl; // For windows
 			//	//std::cout << "Number of data points at this leaf: " << DataSetSize << std::endl;
 			//	//std::cout << "m_Parameters.m_NumCandidateFeatures: " << m_Parameters.m_NumCandidateFeatures << std::endl;
-			//	//std::cout << "ObjVal Accumulator: " << std::endl;
-			//	//for (int ii = 0; ii < AccumSize; ++ii)
-			//	//	std::cout << ObjValAccum[ii] << ", ";
-			//	//std::cout << std::endl;
 			//	throw std::runtime_error("Optimum objective value is negative. Cannot proceed.");
 			//}
 
+			uint64_t PhaseStartTime = GetCurrentEpochTime();
 			std::vector<VPFloat> DataResponses(DataSetSize);
-#pragma omp parallel for
+#pragma omp taskloop default(shared) grainsize(s_MinTaskDataSize) if(DataSetSize >= 4 * s_MinTaskDataSize)
 			for (int k = 0; k < DataSetSize; ++k)
-				DataResponses[k] = OptFeatureResponse.GetResponse(PartitionedDataSetIdx->GetDataPoint(k));
+				DataResponses[k] = OptFeatureResponse.GetResponseAt(DataSet, Index[k]);
+			AddPhase(CurrentNodeDepth, PhaseResponses, PhaseStartTime, DataSetSize);
 
 			//OptFeatureResponse.Special();
 
-			std::pair<std::shared_ptr<DataSetIndex>, std::shared_ptr<DataSetIndex>> Subsets = Partition(PartitionedDataSetIdx, DataResponses, OptThreshold);
-			S LeftNodeStats(Subsets.first);
-			S RightNodeStats(Subsets.second);
-
-			OptLeftPartitionIdx = Subsets.first;
-			OptRightPartitionIdx = Subsets.second;
-			OptLeftNodeStats = LeftNodeStats;
-			OptRightNodeStats = RightNodeStats;
+			// Partition the index range of this node in place. Children get views of the two halves
+			PhaseStartTime = GetCurrentEpochTime();
+			int NumLeft = PartitionInPlace(PartitionedDataSetIdx, DataResponses, OptThreshold);
+			AddPhase(CurrentNodeDepth, PhasePartition, PhaseStartTime, 1);
+			OptLeftPartitionIdx = PartitionedDataSetIdx->GetSubset(0, NumLeft);
+			OptRightPartitionIdx = PartitionedDataSetIdx->GetSubset(NumLeft, DataSetSize);
 
 			// std::cout << "\n--------------------------------\n" << "Depth Level: " << CurrentNodeDepth << "\n--------------------------------\n";
 			// {
@@ -286,199 +315,803 @@ namespace Kaadugal
 			if (OptObjVal == 0.0 || OptObjVal < m_Parameters.m_MinGain)
 			{
 				//std::cout << "[ INFO ]: No gain or very small gain (" << OptObjVal << ") for all splitting candidates. Making leaf node..." << std::endl;
-				PartitionedDataSetIdx->GetDataSet()->Special(NodeIndex, PartitionedDataSetIdx->GetIndex());
-				ParentNodeStats.Special();
-				MakeLeafNode(ParentNodeStats, NodeIndex, CurrentNodeDepth, NodeStartTime, PartitionedDataSetIdx);
+				MakeSpecialLeafNode(ParentNodeStats, NodeIndex, PartitionedDataSetIdx, CurrentNodeDepth);
+				AddLevelTime(CurrentNodeDepth, NodeStartTime);
 
 				return true;
 			}
 
 			// Now free to make a split node
-			m_Tree->GetNode(NodeIndex).MakeSplitNode(ParentNodeStats, OptFeatureResponse, OptThreshold);
-			m_NumSplitNodes++;
+			int LeftChild = MakeSplitNode(ParentNodeStats, NodeIndex, OptFeatureResponse, OptThreshold, CurrentNodeDepth);
 			// std::cout << "[ INFO ]: Creating split node..." << std::endl;
+			std::shared_ptr<S> LeftNodeStats;
+			std::shared_ptr<S> RightNodeStats;
+			PhaseStartTime = GetCurrentEpochTime();
+			MakeChildStatistics(ParentNodeStats, OptLeftPartitionIdx, OptRightPartitionIdx, LeftNodeStats, RightNodeStats);
+			AddPhase(CurrentNodeDepth, PhaseStatistics, PhaseStartTime, 2);
+			AddLevelTime(CurrentNodeDepth, NodeStartTime);
 
 			// Now recurse :)
-			// Since we store the decision tree as a full binary tree (in
-			// breadth-first order) we can easily get the left and right children indices
-			bool Success = true;
-			uint64_t NodeEndTime = GetCurrentEpochTime();
-			m_TreeLevelTimes[CurrentNodeDepth] += NodeEndTime - NodeStartTime;
+			// The children were allocated next to each other by MakeSplitNode()
+			// The left subtree becomes a task if it is large enough, the right one is built by this thread
+			bool LeftSuccess = true;
+#pragma omp task shared(LeftSuccess) if(OptLeftPartitionIdx->Size() >= s_MinTaskDataSize)
+			LeftSuccess = BuildTreeDepthFirst(OptLeftPartitionIdx, LeftChild, GetChildKey(NodeKey, false), CurrentNodeDepth + 1, LeftNodeStats);
+			bool RightSuccess = BuildTreeDepthFirst(OptRightPartitionIdx, LeftChild + 1, GetChildKey(NodeKey, true), CurrentNodeDepth + 1, RightNodeStats);
+#pragma omp taskwait
+
+			return LeftSuccess && RightSuccess;
+		};
 
-			Success &= BuildTreeDepthFirst(OptLeftPartitionIdx, 2 * NodeIndex + 1, CurrentNodeDepth + 1);
-			Success &= BuildTreeDepthFirst(OptRightPartitionIdx, 2 * NodeIndex + 2, CurrentNodeDepth + 1);
+		// Finds the best of the m_NumCandidateFeatures random feature responses of the node with data DataSetIdx and
+		// random stream NodeKey. Candidates of large nodes are evaluated by tasks. Idle threads pick them up along with
+		// other subtrees. Returns the objective value of the best split, -1 if no candidate could be evaluated
+		// Workspaces must have been prepared for the tree of the node (see PrepareWorkspaces()), then this does not allocate
+		VPFloat FindBestSplit(S& ParentStats, std::shared_ptr<DataSetIndex> DataSetIdx, uint64_t NodeKey, int Depth
+			, T& OptFeatureResponse, VPFloat& OptThreshold)
+		{
+			AbstractDataSet& DataSet = *DataSetIdx->GetDataSet();
+			int DataSetSize = DataSetIdx->Size();
+			VPFloat OptObjVal = -1.0; // Negative values are not possible since this is an energy
+			int OptCandidate = -1;
+#pragma omp taskloop default(shared) grainsize(1) if(DataSetSize >= s_MinTaskDataSize)
+			for (int i = 0; i < m_Parameters.m_NumCandidateFeatures; ++i)
+			{
+				// All random draws of this candidate, whichever thread evaluates it
+				Randomizer::Get().SetStream(m_Seed, NodeKey, i);
+				T FeatureResponse; // This creates an empty feature response with random response
+				FeatureResponse.Randomize(DataSet);
 
-			return Success;
+				VPFloat LocObjVal = -1.0;
+				VPFloat LocThreshold = 0.0;
+				if (EvaluateCandidate(ParentStats, m_EmptyStats.get(), DataSetIdx, FeatureResponse, GetWorkspace(), LocObjVal, LocThreshold, Depth))
+				{
+					// The first candidate with the best objective value wins, like in a serial scan
+#pragma omp critical(KaadugalBestCandidate)
+					if (LocObjVal > OptObjVal || (LocObjVal == OptObjVal && i < OptCandidate))
+					{
+						OptObjVal = LocObjVal;
+						OptCandidate = i;
+						OptFeatureResponse = FeatureResponse;
+						OptThreshold = LocThreshold;
+					}
+				}
+			}
+
+			return OptObjVal;
 		};
 
-		void MakeLeafNode(S& NodeStats, int NodeIndex, int CurrentNodeDepth, uint64_t NodeStartTime, std::shared_ptr<DataSetIndex> LeafDataSetIdx)
+		// Finds the best threshold of one candidate feature response of a node with data DataSetIdx. Scratch memory comes
+		// from Workspace, which must not be used by another thread at the same time. EmptyStats are the starting point
+		// for bin statistics of quantized features (SplitSearch::Histogram, may be null otherwise)
+		// Returns false if no threshold could be evaluated
+		bool EvaluateCandidate(S& ParentStats, const S * EmptyStats, std::shared_ptr<DataSetIndex> DataSetIdx, T& FeatureResponse, SplitWorkspace<S>& Workspace
+			, VPFloat& OptObjVal, VPFloat& OptThreshold, int Depth)
+		{
+			AbstractDataSet& DataSet = *DataSetIdx->GetDataSet();
+			const int * Index = DataSetIdx->GetIndexData();
+			int DataSetSize = DataSetIdx->Size();
+
+			// Quantized axis-aligned features only need a scan over their bins
+			const uint8_t * Bins = nullptr;
+			int FeatureColumn = FeatureResponse.GetFeatureColumn();
+			if (m_Parameters.m_SplitSearch == SplitSearch::Histogram && FeatureColumn >= 0 && EmptyStats != nullptr)
+				Bins = DataSet.GetBinnedFeature(FeatureColumn);
+			if (Bins != nullptr)
+				return FindBestThresholdHistogram(ParentStats, *EmptyStats, DataSet, Index, DataSetSize, Bins, *DataSet.GetBinEdges(FeatureColumn), Workspace, OptObjVal, OptThreshold, Depth);
+
+			uint64_t PhaseStartTime = GetCurrentEpochTime();
+			std::vector<VPFloat>& Responses = Workspace.m_Responses;
+			Responses.resize(DataSetSize);
+			FeatureResponse.GetResponses(DataSet, Index, DataSetSize, Responses.data());
+			AddPhase(Depth, PhaseResponses, PhaseStartTime, DataSetSize);
+
+			PhaseStartTime = GetCurrentEpochTime();
+			std::vector<VPFloat>& Thresholds = Workspace.m_Thresholds;
+			SelectThresholds(Responses, DataSetSize, Workspace.m_Quantiles, Thresholds);
+			int NumThresholds = Thresholds.size();
+			AddPhase(Depth, PhaseThresholds, PhaseStartTime, 1);
+
+			if (m_Parameters.m_SplitSearch == SplitSearch::Bucketed || m_Parameters.m_SplitSearch == SplitSearch::Histogram) // Histogram falls back to buckets for features that are not quantized
+				return FindBestThresholdBucketed(ParentStats, DataSetIdx, Responses, Thresholds, Workspace, OptObjVal, OptThreshold, Depth);
+
+			bool isValid = false;
+			for (int j = 0; j < NumThresholds; ++j)
+			{
+				// First partition data based on current splitting candidates
+				PhaseStartTime = GetCurrentEpochTime();
+				Partition(DataSetIdx, Responses, Thresholds[j], Workspace);
+				AddPhase(Depth, PhasePartition, PhaseStartTime, 1);
+
+				PhaseStartTime = GetCurrentEpochTime();
+				Workspace.m_LeftStats.Aggregate(Workspace.m_LeftIdx);
+				Workspace.m_RightStats.Aggregate(Workspace.m_RightIdx);
+				AddPhase(Depth, PhaseStatistics, PhaseStartTime, 2);
+
+				// Then compute some objective function value. Examples: information gain, Geni index
+				PhaseStartTime = GetCurrentEpochTime();
+				VPFloat ObjVal = GetObjectiveValue(ParentStats, Workspace.m_LeftStats, Workspace.m_RightStats);
+				AddPhase(Depth, PhaseObjective, PhaseStartTime, 1);
+
+				if (ObjVal > OptObjVal)
+				{
+					OptObjVal = ObjVal;
+					OptThreshold = Thresholds[j];
+					isValid = true;
+				}
+			}
+
+			return isValid;
+		};
+
+		// Scratch memory of the calling thread while a tree is built (see SplitWorkspace)
+		SplitWorkspace<S>& GetWorkspace(void)
+		{
+			return m_Workspaces[omp_get_thread_num()];
+		};
+
+		// Most thresholds of a candidate. Quantized features have up to 255 bin edges (see SplitSearch::Histogram)
+		int GetMaxThresholds(void) const
+		{
+			if (m_Parameters.m_SplitSearch == SplitSearch::Histogram)
+				return std::max(m_Parameters.m_NumCandidateThresholds, 255);
+			return m_Parameters.m_NumCandidateThresholds;
+		};
+
+		// Bucket accumulators of a breadth-first level are shared by NumThreads threads and take AccumulatorInts ints each
+		// If there are too many, candidates are processed in batches of features and, if even one feature of all
+		// NumSplitSlots nodes is too many, of nodes too. A thread accumulates at most NumBuckets * FeatureBatchSize * SlotBatchSize
+		// buckets, which is at most NumBuckets * max(1, MaxAccumulators / (NumBuckets * NumThreads))
+		static void GetFrontierBatchSizes(int NumSplitSlots, int NumFeatures, int NumBuckets, int NumThreads, int64_t AccumulatorInts
+			, int& FeatureBatchSize, int& SlotBatchSize)
+		{
+			const int64_t MaxAccumulators = std::max(int64_t(1), s_MaxAccumulatorInts / AccumulatorInts);
+			int64_t AccumulatorsPerNode = int64_t(NumBuckets) * NumThreads;
+			FeatureBatchSize = int(std::max(int64_t(1), std::min(int64_t(NumFeatures), MaxAccumulators / (AccumulatorsPerNode * NumSplitSlots))));
+			SlotBatchSize = int(std::max(int64_t(1), std::min(int64_t(NumSplitSlots), MaxAccumulators / (AccumulatorsPerNode * FeatureBatchSize))));
+		};
+
+		// Sizes the workspace of every thread for a tree with data DataSetIdx so that split evaluation does not allocate
+		// Statistics are shaped like m_EmptyStats (e.g. the number of classes) and accumulators are sized for the most
+		// buckets that depth-first histograms or a breadth-first level accumulate. Buffers over the data points of a node
+		// grow with the first nodes of the first tree. Workspaces are kept until ReleaseWorkspaces()
+		void PrepareWorkspaces(std::shared_ptr<DataSetIndex> DataSetIdx)
+		{
+			std::shared_ptr<AbstractDataSet> DataSet = DataSetIdx->GetDataSet();
+			m_EmptyStats = std::make_shared<S>(std::make_shared<DataSetIndex>(DataSet, std::vector<int>()));
+			m_Workspaces.resize(m_Report.m_NumThreads);
+
+			int NumBuckets = GetMaxThresholds() + 1;
+			int NumClasses = std::max(0, DataSet->GetNumLabelClasses());
+			bool isLabelCounted = DataSet->GetLabelData() != nullptr && NumClasses > 0 && m_Workspaces[0].isLabelCountable(NumClasses);
+			int64_t NumAccumulators = m_Parameters.m_SplitSearch == SplitSearch::Histogram ? NumBuckets : 0;
+			int64_t NumAccumulatorCounts = int64_t(NumBuckets) * NumClasses;
+			if (m_Parameters.m_TrainMethod != TrainMethod::DFS)
+			{
+				// Breadth-first levels split at most this many nodes. Each one of them with all its candidates
+				int NumFeatures = m_Parameters.m_NumCandidateFeatures;
+				int MaxSplitSlots = std::max(1, DataSetIdx->Size() / std::max(3, m_Parameters.m_MinDataSetSize));
+				if (m_Parameters.m_MaxLevels < 30)
+					MaxSplitSlots = std::min(MaxSplitSlots, 1 << m_Parameters.m_MaxLevels);
+				const int64_t MaxAccumulators = std::max(int64_t(1), s_MaxAccumulatorInts / (isLabelCounted ? NumClasses : 4));
+				int64_t MaxBatchCandidates = std::min(int64_t(MaxSplitSlots) * NumFeatures, std::max(int64_t(1), MaxAccumulators / (int64_t(NumBuckets) * m_Report.m_NumThreads)));
+				int64_t FrontierAccumulators = int64_t(NumBuckets) * MaxBatchCandidates;
+				if (!isLabelCounted)
+					NumAccumulators = std::max(NumAccumulators, FrontierAccumulators);
+				else if (DataSet->GetStoredBytesPerDataPoint() > 0) // Out-of-core labels are counted while streaming (see BuildTreeFrontier())
+					NumAccumulatorCounts = std::max(NumAccumulatorCounts, FrontierAccumulators * NumClasses);
+			}
+
+			for (SplitWorkspace<S>& Workspace : m_Workspaces)
+			{
+				Workspace.m_Accumulators.assign(NumAccumulators, *m_EmptyStats);
+				Workspace.m_BucketStats.assign(NumBuckets, *m_EmptyStats);
+				Workspace.m_CumulativeStats.assign(NumBuckets, *m_EmptyStats);
+				Workspace.m_LeftStats = *m_EmptyStats;
+				Workspace.m_RightStats = *m_EmptyStats;
+				Workspace.m_BucketCounts.reserve(NumAccumulatorCounts);
+				Workspace.m_Quantiles.reserve(m_Parameters.m_NumCandidateThresholds + 1);
+				Workspace.m_Thresholds.reserve(NumBuckets);
+				Workspace.m_BucketOffsets.reserve(NumBuckets + 1);
+				Workspace.m_BucketFill.reserve(NumBuckets + 1);
+				Workspace.m_BinSlots.reserve(NumBuckets);
+			}
+		};
+
+		// Statistics of both children of a split. Only the smaller child is aggregated over its data if the statistics
+		// support Subtract(). The larger one is the parent minus its sibling
+		void MakeChildStatistics(const S& ParentStats, std::shared_ptr<DataSetIndex> LeftDataSetIdx, std::shared_ptr<DataSetIndex> RightDataSetIdx
+			, std::shared_ptr<S>& LeftStats, std::shared_ptr<S>& RightStats)
+		{
+			bool isLeftSmaller = LeftDataSetIdx->Size() <= RightDataSetIdx->Size();
+			std::shared_ptr<S>& SmallerStats = isLeftSmaller ? LeftStats : RightStats;
+			std::shared_ptr<S>& LargerStats = isLeftSmaller ? RightStats : LeftStats;
+			SmallerStats = std::make_shared<S>(isLeftSmaller ? LeftDataSetIdx : RightDataSetIdx);
+			LargerStats = std::make_shared<S>(ParentStats);
+			if (SubtractStatistics(*LargerStats, *SmallerStats) == false)
+				*LargerStats = S(isLeftSmaller ? RightDataSetIdx : LeftDataSetIdx);
+		};
+
+		void AddLevelTime(int CurrentNodeDepth, uint64_t NodeStartTime)
+		{
+			uint64_t NodeTime = GetCurrentEpochTime() - NodeStartTime;
+#pragma omp atomic
+			m_Report.m_Levels[CurrentNodeDepth].m_Time += NodeTime;
+		};
+
+		// Adds the time since StartTime and Count operations to a phase of a level. Called by any thread
+		void AddPhase(int Depth, TrainingPhase Phase, uint64_t StartTime, uint64_t Count)
+		{
+			uint64_t Time = GetCurrentEpochTime() - StartTime;
+			LevelReport& Level = m_Report.m_Levels[Depth];
+#pragma omp atomic
+			Level.m_PhaseTimes[Phase] += Time;
+#pragma omp atomic
+			Level.m_PhaseCounts[Phase] += Count;
+		};
+
+		// Adds to a counter of a level, e.g. &LevelReport::m_NumCandidates. Called by any thread
+		void AddLevelCount(int Depth, uint64_t LevelReport::* Counter, uint64_t Count)
+		{
+			uint64_t& Value = m_Report.m_Levels[Depth].*Counter;
+#pragma omp atomic
+			Value += Count;
+		};
+
+		// Nodes are only modified within critical sections since AddChildren() can reallocate the node array
+		// while depth-first tasks build other subtrees
+		void MakeLeafNode(S& NodeStats, int NodeIndex, std::shared_ptr<DataSetIndex> LeafDataSetIdx, int Depth)
 		{
 			R LeafData;
 			LeafData.Construct(LeafDataSetIdx); // Construct arbitrary leaf data
-			m_Tree->GetNode(NodeIndex).MakeLeafNode(NodeStats, LeafData); // Leaf node can be "endowed" with arbitrary data
-			uint64_t NodeEndTime = GetCurrentEpochTime();
-			m_TreeLevelTimes[CurrentNodeDepth] += NodeEndTime - NodeStartTime;
+#pragma omp critical(KaadugalTree)
+			{
+				// Leaves get a dummy feature response which may randomize itself when constructed
+				Randomizer::Get().SetStream(m_Seed, 0, 1);
+				m_Tree->GetNode(NodeIndex).MakeLeafNode(NodeStats, LeafData); // Leaf node can be "endowed" with arbitrary data
+			}
+#pragma omp atomic
 			m_NumLeafNodes++;
+			AddLevelCount(Depth, &LevelReport::m_NumLeafNodes, 1);
+		};
+
+		// Returns the index of the left child. The right child is next to it
+		int MakeSplitNode(S& NodeStats, int NodeIndex, const T& FeatureResponse, VPFloat Threshold, int Depth)
+		{
+			int LeftChild = -1;
+#pragma omp critical(KaadugalTree)
+			{
+				m_Tree->GetNode(NodeIndex).MakeSplitNode(NodeStats, FeatureResponse, Threshold);
+				LeftChild = m_Tree->AddChildren(NodeIndex);
+			}
+#pragma omp atomic
+			m_NumSplitNodes++;
+			AddLevelCount(Depth, &LevelReport::m_NumSplitNodes, 1);
+
+			return LeftChild;
 		};
 
-		bool BuildTreeBreadthFirst(std::shared_ptr<DataSetIndex> DataSetIdx)
+		// With isHybrid, nodes are handed to the depth-first builder once isDepthFirstNode() says so
+		bool BuildTreeBreadthFirst(std::shared_ptr<DataSetIndex> DataSetIdx, bool isHybrid = false)
 		{
+			// Out-of-core data is streamed in storage order
+			std::shared_ptr<AbstractDataSet> DataSet = DataSetIdx->GetDataSet();
+			if (DataSet->GetStoredBytesPerDataPoint() > 0)
+			{
+				std::vector<int> SortedIndex = DataSetIdx->CopyIndex();
+				std::sort(SortedIndex.begin(), SortedIndex.end());
+				DataSetIdx = std::make_shared<DataSetIndex>(DataSet, SortedIndex);
+			}
+
 			// All the incoming data reaches the root for sure
-			m_DataDeepestNodeIndex.resize(DataSetIdx->Size(), 0); // Later this is updated inside BuildTreeFrontier()
-			UpdateFrontierNodes(); // Update before starting. Later this is called inside BuildTreeFrontier()
+			m_DataDeepestNodeIndex.assign(DataSetIdx->Size(), 0); // Later this is updated inside BuildTreeFrontier()
+			m_FrontierSlots.assign(m_Tree->GetNumNodes(), -1);
+			m_NodeKeys.assign(m_Tree->GetNumNodes(), uint64_t(s_RootNodeKey));
+			m_FrontierNodes.clear();
+			UpdateFrontierNodes(); // Update before starting. Later this is called after each BuildTreeFrontier()
 
-			std::cout << "[ INFO ]: At depth: " << std::flush;
-			for (int i = 0; i < m_Tree->GetMaxDecisionLevels(); ++i)
+			if (m_isVerbose)
+				std::cout << "[ INFO ]: At depth: " << std::flush;
+			for (int i = 0; i <= m_Tree->GetMaxDecisionLevels() && m_FrontierNodes.size() > 0; ++i)
 			{
 				uint64_t NodeStartTime = GetCurrentEpochTime();
-				std::cout << i << " " << std::flush;
-				BuildTreeFrontier(DataSetIdx);
-				UpdateFrontierNodes();
+				if (m_isVerbose)
+					std::cout << i << " " << std::flush;
+				m_ReachedMaxDepth = i;
+				uint64_t DepthFirstTime = BuildTreeFrontier(DataSetIdx, i, isHybrid);
+				if (m_FrontierNodes.size() > 0) // All nodes might have gone depth-first. Otherwise UpdateFrontierNodes() would restart at the root
+					UpdateFrontierNodes();
 				uint64_t NodeEndTime = GetCurrentEpochTime();
-				m_TreeLevelTimes[i] += NodeEndTime - NodeStartTime;
+				m_Report.m_Levels[i].m_Time += NodeEndTime - NodeStartTime - DepthFirstTime; // Depth-first subtrees record their own times
 			}
+			DataSet->Release(0, DataSet->Size());
 
 			return true;
 		};
 
-		void BuildTreeFrontier(std::shared_ptr<DataSetIndex> DataSetIdx)
+		// Number of data points in a chunk of a streaming pass. Out-of-core datasets are read in chunks that fit
+		// into the memory budget. Data in memory is processed in one chunk
+		int GetStreamChunkSize(AbstractDataSet& DataSet, int DataSetSize) const
 		{
-			int64_t DataSetSize = DataSetIdx->Size();
+			uint64_t BytesPerDataPoint = DataSet.GetStoredBytesPerDataPoint();
+			if (BytesPerDataPoint == 0)
+				return std::max(1, DataSetSize);
 
-			// Check if incoming data is fewer than 3 data points at the root. If so then just create a leaf node
-			// It's 3 (instead of 2) because otherwise the SelectThresholds() could return 1 which is problematic
-			if (DataSetSize < std::max(3, m_Parameters.m_MinDataSetSize))
+			uint64_t Budget = uint64_t(m_Parameters.m_DataMemoryBudget) << 20;
+			return int(std::max(uint64_t(1), std::min(uint64_t(std::max(1, DataSetSize)), Budget / BytesPerDataPoint)));
+		};
+
+		// Releases the data points at positions [Begin, End) of an index sorted in storage order
+		static void ReleaseChunk(std::shared_ptr<DataSetIndex> DataSetIdx, int Begin, int End)
+		{
+			if (Begin < End)
+				DataSetIdx->GetDataSet()->Release(DataSetIdx->GetDataPointIndex(Begin), uint64_t(DataSetIdx->GetDataPointIndex(End - 1)) + 1);
+		};
+
+		// Builds all nodes of the frontier (all at depth CurrentDepth) with a few passes over the data.
+		// Each data point is advanced by one level per call using m_DataDeepestNodeIndex, the frontier slot
+		// of a node is looked up in m_FrontierSlots and split candidates are evaluated with per-thread
+		// bucket statistics that every data point is accumulated into (see FindBestThresholdFromBuckets())
+		// Class labels of in-memory data are counted per candidate over the data of its node instead
+		// For hybrid training, nodes are built depth-first if isDepthFirstNode(). Returns the time spent on those
+		// Out-of-core data is streamed in chunks (see GetStreamChunkSize()) that are released after every pass
+		uint64_t BuildTreeFrontier(std::shared_ptr<DataSetIndex> DataSetIdx, int CurrentDepth, bool isHybrid = false)
+		{
+			std::shared_ptr<AbstractDataSet> DataSet = DataSetIdx->GetDataSet();
+			int DataSetSize = DataSetIdx->Size();
+			int ChunkSize = GetStreamChunkSize(*DataSet, DataSetSize);
+			int NumFrontierNodes = m_FrontierNodes.size();
+			int NumFeatures = m_Parameters.m_NumCandidateFeatures;
+			int NumThreads = std::max(1, std::min(m_NumThreads, omp_get_max_threads()));
+			m_FrontierSlots.resize(m_Tree->GetNumNodes(), -1); // Nodes were added since the last level
+			for (int Slot = 0; Slot < NumFrontierNodes; ++Slot)
+				m_FrontierSlots[m_FrontierNodes[Slot]] = Slot;
+
+			// Pass 1: Advance data points that reached a node split in the previous level to its child
+			std::vector<int> DataSlots(DataSetSize, -1);
+			for (int ChunkBegin = 0; ChunkBegin < DataSetSize; ChunkBegin += ChunkSize)
 			{
-				m_Tree->GetNode(0).MakeLeafNode(S(DataSetIdx)); // Leaf node can be "endowed" with arbitrary data. TODO: Need to handle arbitrary leaf data
-				return;
+				int ChunkEnd = std::min(DataSetSize, ChunkBegin + ChunkSize);
+#pragma omp parallel num_threads(NumThreads)
+				{
+					uint64_t PassStartTime = GetCurrentEpochTime();
+#pragma omp for nowait
+					for (int i = ChunkBegin; i < ChunkEnd; ++i)
+					{
+						int NodeIndex = m_DataDeepestNodeIndex[i];
+						if (NodeIndex < 0) // Data of a subtree that was built depth-first
+							continue;
+						DecisionNode<T, S, R>& Node = m_Tree->GetNode(NodeIndex);
+						if (Node.GetType() == Kaadugal::NodeType::SplitNode)
+						{
+							bool isGoLeft = Node.GetFeatureResponse().GetResponseAt(*DataSet, DataSetIdx->GetDataPointIndex(i)) > Node.GetThreshold(); // Same logic as in partition and testing
+							NodeIndex = Node.GetLeftChild() + (isGoLeft ? 0 : 1);
+							m_DataDeepestNodeIndex[i] = NodeIndex;
+						}
+						DataSlots[i] = m_FrontierSlots[NodeIndex];
+					}
+					AddPhase(CurrentDepth, PhasePartition, PassStartTime, 0);
+				}
+				ReleaseChunk(DataSetIdx, ChunkBegin, ChunkEnd);
+			}
+
+			// Group the data of each frontier node contiguously in one index buffer (counting sort)
+			uint64_t PhaseStartTime = GetCurrentEpochTime();
+			std::vector<int> SlotOffsets(NumFrontierNodes + 1, 0);
+			for (int i = 0; i < DataSetSize; ++i)
+			{
+				if (DataSlots[i] >= 0)
+					SlotOffsets[DataSlots[i] + 1]++;
+			}
+			for (int Slot = 0; Slot < NumFrontierNodes; ++Slot)
+				SlotOffsets[Slot + 1] += SlotOffsets[Slot];
+			auto FrontierIndex = std::make_shared<std::vector<int>>(SlotOffsets[NumFrontierNodes]);
+			std::vector<int> SlotFill(SlotOffsets.begin(), SlotOffsets.end() - 1);
+			for (int i = 0; i < DataSetSize; ++i)
+			{
+				if (DataSlots[i] >= 0)
+					(*FrontierIndex)[SlotFill[DataSlots[i]]++] = DataSetIdx->GetDataPointIndex(i);
 			}
+			AddPhase(CurrentDepth, PhasePartition, PhaseStartTime, NumFrontierNodes);
 
-			// Using large integers - uint64_t
-			int64_t NumCandidateThresholds = DataSetSize>m_Parameters.m_NumCandidateThresholds ? m_Parameters.m_NumCandidateThresholds : (DataSetSize - 1);
-			int64_t NumSplitCandidates = m_Parameters.m_NumCandidateFeatures * NumCandidateThresholds;
-			int64_t NumFrontierNodes = m_FrontierNodes.size();
-			// NOTE: This is different from Criminisi et al. We create a 3D matrix here.
-			// TODO: Most likely run out of memory if this is not done in smaller batches. Frontier must be small
-			// Also we use a single vector to denote the 3D matrix so that they are all contiguous in memory (heap as all vectors are)
-			// Dimensions are Rows (i, FeatureResponses) x Cols (j, Thresholds) x Depth (k, Frontier nodes)
-			std::vector<S> AllParentNodeStatistics(NumFrontierNodes);
-			std::vector<S> AllLeftNodeStatistics(NumSplitCandidates*NumFrontierNodes);
-			std::vector<S> AllRightNodeStatistics(NumSplitCandidates*NumFrontierNodes);
-			std::vector<T> AllFeatureResponses(m_Parameters.m_NumCandidateFeatures*NumFrontierNodes); // Rows are features, 3 dimension is frontier
-			// TODO: Change to shared_ptr?
-			std::vector<VPFloat> AllThresholds(NumSplitCandidates*NumFrontierNodes); // Rows are features, cols are thresholds, 3 dimension is frontier. It is stored column-first, row-next and 3D last
-			std::vector<std::vector<VPFloat>> AllResponses(m_Parameters.m_NumCandidateFeatures*NumFrontierNodes); // Rows are features, 3 dimension is frontier
-			std::vector<int> FrontierDataSize(NumFrontierNodes, 0);
-
-			for (int kk = 0; kk < DataSetSize; ++kk)
-			{
-				int ReachedFrontier = m_Tree->TraverseToFrontier(DataSetIdx->GetDataPoint(kk)); // Find which node this data point reaches
-				if (std::find(m_FrontierNodes.begin(), m_FrontierNodes.end(), ReachedFrontier) == m_FrontierNodes.end())
-					continue; // Since the above ReachedFrontier might NOT reach the current "frontier", continue to the next data point
-
-				FrontierDataSize[ReachedFrontier]++;
-				std::vector<int> LoneDataIdx(1, kk);
-				if (AllParentNodeStatistics[ReachedFrontier].isValid())
+			// Parent statistics and leaf creation. Remaining nodes are split candidates
+			std::vector<std::shared_ptr<DataSetIndex>> SlotDataSetIdx(NumFrontierNodes);
+			std::vector<S> ParentNodeStats(NumFrontierNodes);
+#pragma omp parallel for schedule(dynamic) num_threads(NumThreads)
+			for (int Slot = 0; Slot < NumFrontierNodes; ++Slot)
+			{
+				uint64_t StatsStartTime = GetCurrentEpochTime();
+				SlotDataSetIdx[Slot] = std::make_shared<DataSetIndex>(DataSet, FrontierIndex, SlotOffsets[Slot], SlotOffsets[Slot + 1]);
+				ParentNodeStats[Slot] = S(SlotDataSetIdx[Slot]);
+				AddPhase(CurrentDepth, PhaseStatistics, StatsStartTime, 1);
+			}
+
+			std::vector<int> SplitSlots; // Frontier slots of nodes that we try to split
+			std::vector<int> CandidateIndex(NumFrontierNodes, -1); // Frontier slot to index in SplitSlots
+			std::vector<char> isDepthFirstSlot(NumFrontierNodes, 0);
+			std::vector<std::shared_ptr<DataSetIndex>> DepthFirstDataSetIdx;
+			std::vector<int> DepthFirstNodes;
+			std::vector<uint64_t> DepthFirstKeys;
+			std::vector<std::shared_ptr<S>> DepthFirstStats;
+			for (int Slot = 0; Slot < NumFrontierNodes; ++Slot)
+			{
+				// Fewer than 3 data points or maximum depth. See BuildTreeDepthFirst()
+				if (SlotDataSetIdx[Slot]->Size() < std::max(3, m_Parameters.m_MinDataSetSize) || CurrentDepth >= m_Tree->GetMaxDecisionLevels())
 				{
-					auto NewStats = std::make_shared<S>(S(std::make_shared<DataSetIndex>(DataSetIndex(DataSetIdx->GetDataSet(), LoneDataIdx))));
-					AllParentNodeStatistics[ReachedFrontier].Merge(NewStats);
+					MakeSpecialLeafNode(ParentNodeStats[Slot], m_FrontierNodes[Slot], SlotDataSetIdx[Slot], CurrentDepth);
+					continue;
 				}
-				else
-					AllParentNodeStatistics[ReachedFrontier] = S(std::make_shared<DataSetIndex>(DataSetIndex(DataSetIdx->GetDataSet(), LoneDataIdx)));
-
-				for (int ii = 0; ii < m_Parameters.m_NumCandidateFeatures; ++ii)
+				if (isHybrid && isDepthFirstNode(SlotDataSetIdx[Slot]->Size(), CurrentDepth))
 				{
-					int64_t FeatureIdx = ReachedFrontier*m_Parameters.m_NumCandidateFeatures + ii;
-					AllResponses[FeatureIdx].push_back(AllFeatureResponses[FeatureIdx].GetResponse(DataSetIdx->GetDataPoint(kk)));
+					// The node's data is contiguous in FrontierIndex and can be partitioned in place
+					DepthFirstDataSetIdx.push_back(SlotDataSetIdx[Slot]);
+					DepthFirstNodes.push_back(m_FrontierNodes[Slot]);
+					DepthFirstKeys.push_back(m_NodeKeys[m_FrontierNodes[Slot]]);
+					DepthFirstStats.push_back(std::make_shared<S>(ParentNodeStats[Slot]));
+					isDepthFirstSlot[Slot] = 1;
+					continue;
 				}
+				CandidateIndex[Slot] = SplitSlots.size();
+				SplitSlots.push_back(Slot);
 			}
+			for (int Slot = 0; Slot < NumFrontierNodes; ++Slot)
+			{
+				if (!isDepthFirstSlot[Slot]) // Depth-first subtrees count their own data points
+					AddLevelCount(CurrentDepth, &LevelReport::m_NumDataPoints, SlotDataSetIdx[Slot]->Size());
+			}
+			DataSet->Release(0, DataSet->Size());
 
-			for (int jj = 0; jj < NumFrontierNodes; ++jj)
+			// Depth-first subtrees read their data in random order. For out-of-core data, batches of subtrees with
+			// at most a chunk of data points are built on an in-memory copy of their data (see AbstractDataSet::Gather())
+			bool isOutOfCore = DataSet->GetStoredBytesPerDataPoint() > 0;
+			uint64_t DepthFirstTime = 0;
+			for (int BatchBegin = 0, BatchEnd = 0; BatchBegin < int(DepthFirstNodes.size()); BatchBegin = BatchEnd)
 			{
-				for (int ii = 0; ii < m_Parameters.m_NumCandidateFeatures; ++ii)
+				int BatchSize = 0;
+				for (BatchEnd = BatchBegin; BatchEnd < int(DepthFirstNodes.size()) && (!isOutOfCore || BatchEnd == BatchBegin || BatchSize + DepthFirstDataSetIdx[BatchEnd]->Size() <= ChunkSize); ++BatchEnd)
+					BatchSize += DepthFirstDataSetIdx[BatchEnd]->Size();
+
+				uint64_t StartTime = GetCurrentEpochTime();
+				std::vector<std::shared_ptr<DataSetIndex>> BatchDataSetIdx(DepthFirstDataSetIdx.begin() + BatchBegin, DepthFirstDataSetIdx.begin() + BatchEnd);
+				if (isOutOfCore)
 				{
-					int64_t FeatureIdx = jj*m_Parameters.m_NumCandidateFeatures + ii;
-					std::vector<VPFloat> Thresholds = SelectThresholds(AllResponses[FeatureIdx], FrontierDataSize[jj]);
-					// TODO: This is wasteful, move around pointers instead
-					for (int ll = 0; ll < NumCandidateThresholds; ++ll)
-						AllThresholds[jj*NumSplitCandidates + ii*NumCandidateThresholds + ll] = Thresholds[ll];
+					std::vector<int> BatchIndex;
+					BatchIndex.reserve(BatchSize);
+					for (auto& SubtreeDataSetIdx : BatchDataSetIdx)
+						BatchIndex.insert(BatchIndex.end(), SubtreeDataSetIdx->GetIndexData(), SubtreeDataSetIdx->GetIndexData() + SubtreeDataSetIdx->Size());
+					std::shared_ptr<AbstractDataSet> Gathered = DataSet->Gather(BatchIndex);
+					if (Gathered != nullptr)
+					{
+						auto GatheredIndex = std::make_shared<std::vector<int>>(BatchSize);
+						for (int i = 0; i < BatchSize; ++i)
+							(*GatheredIndex)[i] = i;
+						for (int i = 0, Offset = 0; i < int(BatchDataSetIdx.size()); Offset += BatchDataSetIdx[i++]->Size())
+							BatchDataSetIdx[i] = std::make_shared<DataSetIndex>(Gathered, GatheredIndex, Offset, Offset + BatchDataSetIdx[i]->Size());
+					}
 				}
+				BuildSubtreesDepthFirst(BatchDataSetIdx, std::vector<int>(DepthFirstNodes.begin() + BatchBegin, DepthFirstNodes.begin() + BatchEnd)
+					, std::vector<uint64_t>(DepthFirstKeys.begin() + BatchBegin, DepthFirstKeys.begin() + BatchEnd), CurrentDepth
+					, std::vector<std::shared_ptr<S>>(DepthFirstStats.begin() + BatchBegin, DepthFirstStats.begin() + BatchEnd));
+				DepthFirstTime += GetCurrentEpochTime() - StartTime;
+				DataSet->Release(0, DataSet->Size());
+			}
+			int NumSplitSlots = SplitSlots.size();
+			for (int i = 0; i < DataSetSize; ++i)
+			{
+				if (DataSlots[i] >= 0 && isDepthFirstSlot[DataSlots[i]])
+					m_DataDeepestNodeIndex[i] = -1; // Done with this data point
 			}
 
-			for (int DatItr = 0; DatItr < DataSetSize; ++DatItr) // TODO: Candidate for parallelization
+			if (NumSplitSlots > 0)
 			{
-				int ReachedFrontier = m_Tree->TraverseToFrontier(DataSetIdx->GetDataPoint(DatItr)); // Find which node this data point reaches
-				if (std::find(m_FrontierNodes.begin(), m_FrontierNodes.end(), ReachedFrontier) == m_FrontierNodes.end())
-					continue; // Since the above ReachedFrontier might NOT reach the current "frontier", continue to the next data point
+				// Random candidate feature responses and their thresholds for all nodes
+				// Thresholds are selected from the responses of a few randomly sampled data points of each node
+				// For quantized features (SplitSearch::Histogram) the thresholds are the bin edges and the bins are known
+				int NumSampledThresholds = m_Parameters.m_NumCandidateThresholds;
+				bool isHistogram = m_Parameters.m_SplitSearch == SplitSearch::Histogram;
+				int MaxThresholds = GetMaxThresholds();
+				int NumBuckets = MaxThresholds + 1;
+				std::vector<T> AllFeatureResponses(NumSplitSlots * NumFeatures);
+				std::vector<VPFloat> AllThresholds(int64_t(NumSplitSlots) * NumFeatures * MaxThresholds, 0.0);
+				std::vector<int> AllNumThresholds(NumSplitSlots * NumFeatures, 0);
+				std::vector<const uint8_t *> AllBins(NumSplitSlots * NumFeatures, nullptr);
+				// Each sampled response of out-of-core data may map a whole block of storage, so candidates are
+				// sampled in batches that fit into the memory budget and released after every batch
+				int NumCandidates = NumSplitSlots * NumFeatures;
+				AddLevelCount(CurrentDepth, &LevelReport::m_NumCandidates, NumCandidates);
+				int CandBatchSize = NumCandidates;
+				if (DataSet->GetStoredBytesPerDataPoint() > 0)
+					CandBatchSize = int(std::max(uint64_t(1), (uint64_t(m_Parameters.m_DataMemoryBudget) << 20) / (s_ScatteredReadBytes * (NumSampledThresholds + 1))));
+				for (int CandBegin = 0; CandBegin < NumCandidates; CandBegin += CandBatchSize)
+				{
+					int CandEnd = std::min(NumCandidates, CandBegin + CandBatchSize);
+#pragma omp parallel for schedule(dynamic) num_threads(NumThreads)
+					for (int Cand = CandBegin; Cand < CandEnd; ++Cand)
+					{
+						uint64_t CandStartTime = GetCurrentEpochTime();
+						int Slot = SplitSlots[Cand / NumFeatures];
+						std::shared_ptr<DataSetIndex> NodeDataSetIdx = SlotDataSetIdx[Slot];
+						int NodeSize = NodeDataSetIdx->Size();
+						Randomizer::Get().SetStream(m_Seed, m_NodeKeys[m_FrontierNodes[Slot]], Cand % NumFeatures); // Same stream as depth-first
+						AllFeatureResponses[Cand] = T(); // Responses may randomize themselves when constructed
+						AllFeatureResponses[Cand].Randomize(*DataSet);
+						int FeatureColumn = AllFeatureResponses[Cand].GetFeatureColumn();
+						if (isHistogram && FeatureColumn >= 0 && (AllBins[Cand] = DataSet->GetBinnedFeature(FeatureColumn)) != nullptr)
+						{
+							const std::vector<VPFloat>& BinEdges = *DataSet->GetBinEdges(FeatureColumn);
+							AllNumThresholds[Cand] = BinEdges.size();
+							std::copy(BinEdges.begin(), BinEdges.end(), AllThresholds.begin() + int64_t(Cand) * MaxThresholds);
+							AddPhase(CurrentDepth, PhaseThresholds, CandStartTime, 1);
+							continue;
+						}
+
+						SplitWorkspace<S>& Workspace = GetWorkspace();
+						std::vector<VPFloat>& Quantiles = Workspace.m_Quantiles;
+						Quantiles.clear();
+						if (NodeSize > NumSampledThresholds)
+						{
+							std::uniform_int_distribution<int> UniDist(0, NodeSize - 1); // Both inclusive
+							for (int i = 0; i < NumSampledThresholds + 1; ++i)
+								Quantiles.push_back(AllFeatureResponses[Cand].GetResponseAt(*DataSet, NodeDataSetIdx->GetDataPointIndex(UniDist(Randomizer::Get().GetRNG()))));
+						}
+						else
+						{
+							for (int i = 0; i < NodeSize; ++i)
+								Quantiles.push_back(AllFeatureResponses[Cand].GetResponseAt(*DataSet, NodeDataSetIdx->GetDataPointIndex(i)));
+						}
+
+						std::vector<VPFloat>& Thresholds = Workspace.m_Thresholds;
+						SelectThresholdsFromQuantiles(Quantiles, Thresholds);
+						AllNumThresholds[Cand] = Thresholds.size();
+						std::copy(Thresholds.begin(), Thresholds.end(), AllThresholds.begin() + int64_t(Cand) * MaxThresholds);
+						AddPhase(CurrentDepth, PhaseThresholds, CandStartTime, 1);
+					}
+					DataSet->Release(0, DataSet->Size()); // Sampled responses are scattered
+				}
 
-				for (int FeatCtr = 0; FeatCtr < m_Parameters.m_NumCandidateFeatures; ++FeatCtr)
+				// Bucket statistics for every (node, candidate, bucket) are accumulated with thread-local copies
+				// Label histograms are accumulated as flat class counts instead, like in FindBestThresholdBucketed(),
+				// and statistics are only set from them when the thresholds of a candidate are evaluated. In-memory
+				// label data is not streamed at all: the data of every node is contiguous in FrontierIndex, so each
+				// candidate counts the labels of its node with the SIMD kernel (see CountLabelsInBuckets())
+				// If there are too many accumulators we make several passes with a subset of the candidates, and if
+				// even one feature of all nodes is too many, with a subset of the nodes too
+				const int * Labels = DataSet->GetLabelData();
+				int NumClasses = DataSet->GetNumLabelClasses();
+				bool isLabelCounted = Labels != nullptr && NumClasses > 0 && m_Workspaces[0].isLabelCountable(NumClasses); // Not in a team of this tree
+				bool isCountedPerCandidate = isLabelCounted && !isOutOfCore;
+				int FeatureBatchSize = NumFeatures; // No accumulators if isCountedPerCandidate
+				int SlotBatchSize = NumSplitSlots;
+				if (!isCountedPerCandidate)
+					GetFrontierBatchSizes(NumSplitSlots, NumFeatures, NumBuckets, NumThreads, isLabelCounted ? NumClasses : 4, FeatureBatchSize, SlotBatchSize);
+
+				std::vector<VPFloat> OptObjVal(NumSplitSlots, -1.0);
+				std::vector<VPFloat> OptThreshold(NumSplitSlots, 0.0);
+				std::vector<int> OptFeature(NumSplitSlots, -1);
+				for (int SlotBegin = 0; SlotBegin < NumSplitSlots; SlotBegin += SlotBatchSize)
 				{
-					for (int ThreshCtr = 0; ThreshCtr < NumCandidateThresholds; ++ThreshCtr)
+					int SlotEnd = std::min(NumSplitSlots, SlotBegin + SlotBatchSize);
+					int NumBatchSlots = SlotEnd - SlotBegin;
+					for (int FeatureBegin = 0; FeatureBegin < NumFeatures; FeatureBegin += FeatureBatchSize)
 					{
-						int64_t FeatureIdx = ReachedFrontier*m_Parameters.m_NumCandidateFeatures + FeatCtr;
-						VPFloat Response = AllFeatureResponses[FeatureIdx].GetResponse(DataSetIdx->GetDataPoint(DatItr));
-						VPFloat Threshold = AllThresholds[ReachedFrontier*NumSplitCandidates + FeatCtr*NumCandidateThresholds + ThreshCtr];
+						int BatchSize = std::min(FeatureBatchSize, NumFeatures - FeatureBegin);
+						int64_t NumAccumulators = int64_t(NumBatchSlots) * BatchSize * NumBuckets;
+						std::vector<S*> ThreadBucketStats(NumThreads); // Bucket statistics of the workspace of every thread
+						std::vector<int*> ThreadBucketCounts(NumThreads); // Or class counts of every bucket if isLabelCounted
+						int NumTeamThreads = 1; // The runtime may give fewer threads than requested (nested teams, OMP_THREAD_LIMIT)
 
-						int64_t RowFirst3DIndex = ReachedFrontier*NumSplitCandidates + ThreshCtr*m_Parameters.m_NumCandidateFeatures + FeatCtr;
-						std::vector<int> LoneDataIdx(1, DatItr);
-						if (Response > Threshold) // Same logic as partitioning and testing the tree
+						if (!isCountedPerCandidate)
 						{
-							if (AllLeftNodeStatistics[RowFirst3DIndex].isValid())
+							// Pass 2: Stream over the data of all nodes that are split candidates
+#pragma omp parallel num_threads(NumThreads)
 							{
-								auto NewStats = std::make_shared<S>(S(std::make_shared<DataSetIndex>(DataSetIndex(DataSetIdx->GetDataSet(), LoneDataIdx))));
-								AllLeftNodeStatistics[RowFirst3DIndex].Merge(NewStats);
+								uint64_t PassStartTime = GetCurrentEpochTime();
+								uint64_t NumAccumulated = 0;
+								S * BucketStats = nullptr;
+								int * BucketCounts = nullptr;
+								if (isLabelCounted)
+								{
+									std::vector<int>& Counts = GetWorkspace().m_BucketCounts;
+									Counts.assign(NumAccumulators * NumClasses, 0);
+									BucketCounts = Counts.data();
+								}
+								else
+								{
+									BucketStats = GetWorkspace().GetAccumulators(NumAccumulators, *m_EmptyStats);
+								}
+								ThreadBucketStats[omp_get_thread_num()] = BucketStats;
+								ThreadBucketCounts[omp_get_thread_num()] = BucketCounts;
+#pragma omp master
+								NumTeamThreads = omp_get_num_threads();
+								for (int ChunkBegin = 0; ChunkBegin < DataSetSize; ChunkBegin += ChunkSize)
+								{
+									int ChunkEnd = std::min(DataSetSize, ChunkBegin + ChunkSize);
+#pragma omp for schedule(static)
+									for (int i = ChunkBegin; i < ChunkEnd; ++i)
+									{
+										if (DataSlots[i] < 0 || CandidateIndex[DataSlots[i]] < SlotBegin || CandidateIndex[DataSlots[i]] >= SlotEnd)
+											continue;
+
+										int SplitSlot = CandidateIndex[DataSlots[i]];
+										int DataPointIndex = DataSetIdx->GetDataPointIndex(i);
+										NumAccumulated += BatchSize;
+										for (int f = 0; f < BatchSize; ++f)
+										{
+											int Cand = SplitSlot * NumFeatures + FeatureBegin + f;
+											const VPFloat * Thresholds = AllThresholds.data() + int64_t(Cand) * MaxThresholds;
+											int Bucket = 0;
+											if (AllBins[Cand] != nullptr)
+												Bucket = AllBins[Cand][DataPointIndex];
+											else
+											{
+												VPFloat Response = AllFeatureResponses[Cand].GetResponseAt(*DataSet, DataPointIndex);
+												Bucket = int(std::lower_bound(Thresholds, Thresholds + AllNumThresholds[Cand], Response) - Thresholds);
+											}
+											int64_t Accumulator = (int64_t(SplitSlot - SlotBegin) * BatchSize + f) * NumBuckets + Bucket;
+											if (BucketCounts != nullptr)
+											{
+												if (unsigned(Labels[DataPointIndex]) >= unsigned(NumClasses))
+													throw std::runtime_error("Data point label is inconsistent with number of classes. Exiting.");
+												BucketCounts[Accumulator * NumClasses + Labels[DataPointIndex]]++;
+											}
+											else
+												BucketStats[Accumulator].Accumulate(*DataSet, DataPointIndex);
+										}
+									}
+#pragma omp single
+									ReleaseChunk(DataSetIdx, ChunkBegin, ChunkEnd);
+								}
+								AddPhase(CurrentDepth, PhaseStatistics, PassStartTime, NumAccumulated);
+							}
+
+							// Reduce thread-local statistics into the first thread's
+#pragma omp parallel num_threads(NumThreads)
+							{
+								uint64_t ReduceStartTime = GetCurrentEpochTime();
+								if (isLabelCounted)
+								{
+#pragma omp for nowait
+									for (int64_t k = 0; k < NumAccumulators * NumClasses; ++k)
+									{
+										for (int t = 1; t < NumTeamThreads; ++t)
+											ThreadBucketCounts[0][k] += ThreadBucketCounts[t][k];
+									}
+								}
+								else
+								{
+#pragma omp for nowait
+									for (int64_t k = 0; k < NumAccumulators; ++k)
+									{
+										for (int t = 1; t < NumTeamThreads; ++t)
+											MergeStatistics(ThreadBucketStats[0][k], ThreadBucketStats[t][k]);
+									}
+								}
+								AddPhase(CurrentDepth, PhaseStatistics, ReduceStartTime, 0);
 							}
-							else
-								AllLeftNodeStatistics[RowFirst3DIndex] = S(std::make_shared<DataSetIndex>(DataSetIndex(DataSetIdx->GetDataSet(), LoneDataIdx)));
 						}
-						else
+
+						// Find the best threshold of every candidate
+						std::vector<VPFloat> CandObjVal(NumBatchSlots * BatchSize, -1.0);
+						std::vector<VPFloat> CandThreshold(NumBatchSlots * BatchSize, 0.0);
+						std::vector<char> CandValid(NumBatchSlots * BatchSize, 0);
+#pragma omp parallel for schedule(dynamic) num_threads(NumThreads)
+						for (int k = 0; k < NumBatchSlots * BatchSize; ++k)
 						{
-							if (AllRightNodeStatistics[RowFirst3DIndex].isValid())
+							int SplitSlot = SlotBegin + k / BatchSize;
+							int Cand = SplitSlot * NumFeatures + FeatureBegin + k % BatchSize;
+							SplitWorkspace<S>& Workspace = GetWorkspace();
+							int NumThresholds = AllNumThresholds[Cand];
+							const VPFloat * Thresholds = AllThresholds.data() + int64_t(Cand) * MaxThresholds;
+							S * CandBucketStats = nullptr;
+							if (isLabelCounted)
 							{
-								auto NewStats = std::make_shared<S>(S(std::make_shared<DataSetIndex>(DataSetIndex(DataSetIdx->GetDataSet(), LoneDataIdx))));
-								AllRightNodeStatistics[RowFirst3DIndex].Merge(NewStats);
+								const int * BucketCounts = nullptr;
+								if (!isCountedPerCandidate)
+									BucketCounts = ThreadBucketCounts[0] + int64_t(k) * NumBuckets * NumClasses;
+								else if (NumThresholds > 0)
+								{
+									uint64_t CountStartTime = GetCurrentEpochTime();
+									const std::shared_ptr<DataSetIndex>& NodeDataSetIdx = SlotDataSetIdx[SplitSlots[SplitSlot]];
+									int NodeSize = NodeDataSetIdx->Size();
+									const int * NodeIndex = NodeDataSetIdx->GetIndexData();
+									std::vector<int>& Counts = Workspace.m_BucketCounts;
+									Counts.resize(int64_t(NumThresholds + 1) * NumClasses);
+									if (AllBins[Cand] != nullptr)
+									{
+										std::fill(Counts.begin(), Counts.end(), 0);
+										for (int i = 0; i < NodeSize; ++i)
+										{
+											int Label = Labels[NodeIndex[i]];
+											if (unsigned(Label) >= unsigned(NumClasses))
+												throw std::runtime_error("Data point label is inconsistent with number of classes. Exiting.");
+											Counts[AllBins[Cand][NodeIndex[i]] * NumClasses + Label]++;
+										}
+									}
+									else
+									{
+										std::vector<VPFloat>& Responses = Workspace.m_Responses;
+										Responses.resize(NodeSize);
+										AllFeatureResponses[Cand].GetResponses(*DataSet, NodeIndex, NodeSize, Responses.data());
+										CountLabelsInBuckets(Responses.data(), Labels, NodeIndex, NodeSize, Thresholds, NumThresholds, NumClasses, Counts.data());
+									}
+									BucketCounts = Counts.data();
+									AddPhase(CurrentDepth, PhaseStatistics, CountStartTime, NodeSize);
+								}
+								CandBucketStats = SplitWorkspace<S>::GetStats(Workspace.m_BucketStats, NumThresholds + 1);
+								for (int b = 0; BucketCounts != nullptr && b <= NumThresholds; ++b)
+									CandBucketStats[b].SetLabelCounts(BucketCounts + int64_t(b) * NumClasses, NumClasses);
 							}
 							else
-								AllRightNodeStatistics[RowFirst3DIndex] = S(std::make_shared<DataSetIndex>(DataSetIndex(DataSetIdx->GetDataSet(), LoneDataIdx)));
+								CandBucketStats = ThreadBucketStats[0] + int64_t(k) * NumBuckets;
+							CandValid[k] = FindBestThresholdFromBuckets(ParentNodeStats[SplitSlots[SplitSlot]], CandBucketStats
+								, Thresholds, NumThresholds, Workspace, CandObjVal[k], CandThreshold[k], CurrentDepth);
 						}
-					}
-				}
-			}
 
-			// Find optimal feature responses and thresholds and stuff
-			// Loop over each frontier 3D plane
-			std::vector<VPFloat> OptObjVal(NumFrontierNodes, 0.0);
-			std::vector<VPFloat> OptThreshold(NumFrontierNodes, 0.0);
-			std::vector<T> OptFeatureResponse(NumFrontierNodes);
-			for (int FrontierIdx = 0; FrontierIdx < NumFrontierNodes; ++FrontierIdx) // TODO: Candidate for parallelization
-			{
-				for (int FeatCtr = 0; FeatCtr < m_Parameters.m_NumCandidateFeatures; ++FeatCtr)
-				{
-					for (int ThreshCtr = 0; ThreshCtr < NumCandidateThresholds; ++ThreshCtr)
-					{
-						int64_t RowFirst3DIndex = FrontierIdx*NumSplitCandidates + ThreshCtr*m_Parameters.m_NumCandidateFeatures + FeatCtr;
-						VPFloat ObjVal = GetObjectiveValue(AllParentNodeStatistics[FrontierIdx], AllLeftNodeStatistics[RowFirst3DIndex], AllRightNodeStatistics[RowFirst3DIndex]);
-						if (ObjVal >= OptObjVal[FrontierIdx])
+						for (int k = 0; k < NumBatchSlots * BatchSize; ++k)
 						{
-							OptObjVal[FrontierIdx] = ObjVal;
-							OptFeatureResponse[FrontierIdx] = AllFeatureResponses[FrontierIdx*NumSplitCandidates + FeatCtr]; // This is 2D indexed
-							int64_t ColFirst3DIndex = FrontierIdx*NumSplitCandidates + FeatCtr*NumCandidateThresholds + ThreshCtr;
-							OptThreshold[FrontierIdx] = AllThresholds[ColFirst3DIndex];
+							int SplitSlot = SlotBegin + k / BatchSize;
+							if (CandValid[k] && CandObjVal[k] > OptObjVal[SplitSlot])
+							{
+								OptObjVal[SplitSlot] = CandObjVal[k];
+								OptThreshold[SplitSlot] = CandThreshold[k];
+								OptFeature[SplitSlot] = FeatureBegin + k % BatchSize;
+							}
 						}
 					}
 				}
 
-				// Check for leaf creation condition
-				// No gain or very small gain
-				if (OptObjVal[FrontierIdx] == 0.0 || OptObjVal[FrontierIdx] < m_Parameters.m_MinGain)
+				for (int SplitSlot = 0; SplitSlot < NumSplitSlots; ++SplitSlot)
 				{
-					m_Tree->GetNode(m_FrontierNodes[FrontierIdx]).MakeLeafNode(AllParentNodeStatistics[FrontierIdx]); // Leaf node can be "endowed" with arbitrary data. TODO: Need to handle arbitrary leaf data
-					continue;
+					int Slot = SplitSlots[SplitSlot];
+					// Check for leaf creation condition. No gain or very small gain
+					if (OptFeature[SplitSlot] < 0 || OptObjVal[SplitSlot] == 0.0 || OptObjVal[SplitSlot] < m_Parameters.m_MinGain)
+					{
+						MakeSpecialLeafNode(ParentNodeStats[Slot], m_FrontierNodes[Slot], SlotDataSetIdx[Slot], CurrentDepth);
+						continue;
+					}
+
+					// Now free to make a split node
+					int NodeIndex = m_FrontierNodes[Slot];
+					int LeftChild = MakeSplitNode(ParentNodeStats[Slot], NodeIndex, AllFeatureResponses[SplitSlot * NumFeatures + OptFeature[SplitSlot]], OptThreshold[SplitSlot], CurrentDepth);
+					m_NodeKeys.resize(LeftChild + 2); // Depth-first subtrees may have added nodes without keys
+					m_NodeKeys[LeftChild] = GetChildKey(m_NodeKeys[NodeIndex], false);
+					m_NodeKeys[LeftChild + 1] = GetChildKey(m_NodeKeys[NodeIndex], true);
 				}
+			}
 
-				// Now free to make a split node
-				m_Tree->GetNode(m_FrontierNodes[FrontierIdx]).MakeSplitNode(AllParentNodeStatistics[FrontierIdx], OptFeatureResponse[FrontierIdx], OptThreshold[FrontierIdx]);
+			for (int Slot = 0; Slot < NumFrontierNodes; ++Slot)
+				m_FrontierSlots[m_FrontierNodes[Slot]] = -1;
+
+			// Subtrees built depth-first are complete and leave the frontier
+			std::vector<int> BreadthFirstNodes;
+			for (int Slot = 0; Slot < NumFrontierNodes; ++Slot)
+			{
+				if (!isDepthFirstSlot[Slot])
+					BreadthFirstNodes.push_back(m_FrontierNodes[Slot]);
 			}
+			m_FrontierNodes = BreadthFirstNodes;
+
+			return DepthFirstTime;
+		};
+
+		// Decides when hybrid training switches from breadth-first to depth-first, i.e. when the data
+		// of a subtree is small enough to stay in cache or the node is deep enough
+		bool isDepthFirstNode(int NodeSize, int CurrentDepth) const
+		{
+			if (m_Parameters.m_HybridSwitchDepth >= 0 && CurrentDepth >= m_Parameters.m_HybridSwitchDepth)
+				return true;
+
+			return NodeSize <= m_Parameters.m_HybridSwitchSize;
+		};
+
+		// Leaf node after the dataset and statistics specific Special() hooks
+		void MakeSpecialLeafNode(S& NodeStats, int NodeIndex, std::shared_ptr<DataSetIndex> LeafDataSetIdx, int Depth)
+		{
+			// The dataset is shared by all tasks and there is no guarantee that its Special() is thread-safe
+#pragma omp critical(KaadugalSpecial)
+			LeafDataSetIdx->GetDataSet()->Special(NodeIndex, LeafDataSetIdx->GetIndexData(), LeafDataSetIdx->Size()); // View of the leaf indices, no copy
+			NodeStats.Special();
+			MakeLeafNode(NodeStats, NodeIndex, LeafDataSetIdx, Depth);
 		};
 
 		void UpdateFrontierNodes(void)
@@ -510,37 +1143,243 @@ namespace Kaadugal
 				if (m_Tree->GetNode(NodeIndex).GetType() == Kaadugal::NodeType::SplitNode)
 				{
 					// Add it's two children to the frontier
-					m_FrontierNodes.push_back(2 * NodeIndex + 1); // Left child
-					m_FrontierNodes.push_back(2 * NodeIndex + 2); // Right child
+					m_FrontierNodes.push_back(m_Tree->GetNode(NodeIndex).GetLeftChild()); // Left child
+					m_FrontierNodes.push_back(m_Tree->GetNode(NodeIndex).GetRightChild()); // Right child
 				}
 			}
 		};
 
 		std::pair<std::shared_ptr<DataSetIndex>, std::shared_ptr<DataSetIndex>> Partition(std::shared_ptr<DataSetIndex> ParentDataSetIdx, const std::vector<VPFloat>& Responses, VPFloat Threshold) const
 		{
-			std::vector<int> LeftSubsetPts;
-			std::vector<int> RightSubsetPts;
-			for (int i = 0; i < ParentDataSetIdx->Size(); ++i)
+			return Partition(ParentDataSetIdx, Responses, Threshold, std::make_shared<std::vector<int>>(), std::make_shared<std::vector<int>>());
+		};
+
+		// Same as above but fills the given index buffers (which keep their capacity) and returns views of them
+		std::pair<std::shared_ptr<DataSetIndex>, std::shared_ptr<DataSetIndex>> Partition(std::shared_ptr<DataSetIndex> ParentDataSetIdx, const std::vector<VPFloat>& Responses, VPFloat Threshold
+			, std::shared_ptr<std::vector<int>> LeftBuffer, std::shared_ptr<std::vector<int>> RightBuffer) const
+		{
+			LeftBuffer->clear();
+			RightBuffer->clear();
+			int DataSetSize = ParentDataSetIdx->Size();
+			const int * Index = ParentDataSetIdx->GetIndexData();
+			for (int i = 0; i < DataSetSize; ++i)
 			{
 				if (Responses[i] > Threshold) // Please use same logic when testing the tree
-					LeftSubsetPts.push_back(ParentDataSetIdx->GetDataPointIndex(i));
+					LeftBuffer->push_back(Index[i]);
 				else
-					RightSubsetPts.push_back(ParentDataSetIdx->GetDataPointIndex(i));
+					RightBuffer->push_back(Index[i]);
 			}
 
-			return std::make_pair(std::shared_ptr<DataSetIndex>(new DataSetIndex(ParentDataSetIdx->GetDataSet(), LeftSubsetPts))
-				, std::shared_ptr<DataSetIndex>(new DataSetIndex(ParentDataSetIdx->GetDataSet(), RightSubsetPts)));
+			return std::make_pair(std::make_shared<DataSetIndex>(ParentDataSetIdx->GetDataSet(), LeftBuffer, 0, int(LeftBuffer->size()))
+				, std::make_shared<DataSetIndex>(ParentDataSetIdx->GetDataSet(), RightBuffer, 0, int(RightBuffer->size())));
+		};
+
+		// Same as above but partitions into the buffers of Workspace and points its views (m_LeftIdx, m_RightIdx) at them
+		void Partition(std::shared_ptr<DataSetIndex> ParentDataSetIdx, const std::vector<VPFloat>& Responses, VPFloat Threshold, SplitWorkspace<S>& Workspace) const
+		{
+			std::vector<int>& LeftBuffer = *Workspace.m_LeftBuffer;
+			std::vector<int>& RightBuffer = *Workspace.m_RightBuffer;
+			LeftBuffer.clear();
+			RightBuffer.clear();
+			int DataSetSize = ParentDataSetIdx->Size();
+			const int * Index = ParentDataSetIdx->GetIndexData();
+			for (int i = 0; i < DataSetSize; ++i)
+			{
+				if (Responses[i] > Threshold) // Please use same logic when testing the tree
+					LeftBuffer.push_back(Index[i]);
+				else
+					RightBuffer.push_back(Index[i]);
+			}
+			Workspace.m_LeftIdx->SetView(ParentDataSetIdx->GetDataSet(), 0, int(LeftBuffer.size()));
+			Workspace.m_RightIdx->SetView(ParentDataSetIdx->GetDataSet(), 0, int(RightBuffer.size()));
+		};
+
+		// Partitions the index range of DataSetIdx in place (like quicksort) so that the data going left comes first.
+		// Responses are reordered along with the indices. Returns the number of data points going left
+		int PartitionInPlace(std::shared_ptr<DataSetIndex> DataSetIdx, std::vector<VPFloat>& Responses, VPFloat Threshold) const
+		{
+			int * Index = DataSetIdx->GetIndexData();
+			int Left = 0;
+			int Right = DataSetIdx->Size() - 1;
+			while (Left <= Right)
+			{
+				if (Responses[Left] > Threshold) // Please use same logic when testing the tree
+					Left++;
+				else
+				{
+					std::swap(Index[Left], Index[Right]);
+					std::swap(Responses[Left], Responses[Right]);
+					Right--;
+				}
+			}
+
+			return Left;
+		};
+
+		// Evaluates all thresholds of one candidate feature response with a single pass over its responses.
+		// Each response is dropped into the bucket between the (sorted) thresholds it falls in and the
+		// left/right statistics of every threshold are then built by cumulatively merging bucket statistics.
+		// This costs O(N log T + T) instead of O(N T) for partitioning at every threshold.
+		// Sorts Thresholds. Bucketing is timed as PhaseStatistics of level Depth
+		bool FindBestThresholdBucketed(S& ParentStats, std::shared_ptr<DataSetIndex> DataSetIdx, const std::vector<VPFloat>& Responses, std::vector<VPFloat>& Thresholds
+			, SplitWorkspace<S>& Workspace, VPFloat& OptObjVal, VPFloat& OptThreshold, int Depth)
+		{
+			int NumThresholds = Thresholds.size();
+			if (NumThresholds == 0)
+				return false;
+			uint64_t StatsStartTime = GetCurrentEpochTime();
+			std::sort(Thresholds.begin(), Thresholds.end());
+
+			// Bucket k has the responses with exactly k thresholds below them. So a response goes left
+			// (Response > Threshold, same logic as Partition()) for threshold j if and only if j < k
+			// Buckets are contiguous ranges of one index buffer (counting sort)
+			int DataSetSize = DataSetIdx->Size();
+			const int * Index = DataSetIdx->GetIndexData();
+			S * BucketStats = SplitWorkspace<S>::GetStats(Workspace.m_BucketStats, NumThresholds + 1);
+
+			// Label histograms are counted directly from the dataset labels with a SIMD kernel
+			AbstractDataSet& DataSet = *DataSetIdx->GetDataSet();
+			int NumClasses = DataSet.GetNumLabelClasses();
+			if (DataSet.GetLabelData() != nullptr && NumClasses > 0 && Workspace.isLabelCountable(NumClasses))
+			{
+				std::vector<int>& BucketCounts = Workspace.m_BucketCounts;
+				BucketCounts.resize(int64_t(NumThresholds + 1) * NumClasses);
+				CountLabelsInBuckets(Responses.data(), DataSet.GetLabelData(), Index, DataSetSize, Thresholds.data(), NumThresholds, NumClasses, BucketCounts.data());
+				for (int k = 0; k <= NumThresholds; ++k)
+					BucketStats[k].SetLabelCounts(BucketCounts.data() + int64_t(k) * NumClasses, NumClasses);
+				AddPhase(Depth, PhaseStatistics, StatsStartTime, NumThresholds + 1);
+
+				return FindBestThresholdFromBuckets(ParentStats, BucketStats, Thresholds.data(), NumThresholds, Workspace, OptObjVal, OptThreshold, Depth);
+			}
+
+			std::vector<int>& PointBuckets = Workspace.m_PointBuckets;
+			std::vector<int>& BucketOffsets = Workspace.m_BucketOffsets;
+			PointBuckets.resize(DataSetSize);
+			BucketOffsets.assign(NumThresholds + 2, 0);
+			for (int k = 0; k < DataSetSize; ++k)
+			{
+				PointBuckets[k] = int(std::lower_bound(Thresholds.begin(), Thresholds.end(), Responses[k]) - Thresholds.begin());
+				BucketOffsets[PointBuckets[k] + 1]++;
+			}
+			for (int k = 0; k <= NumThresholds; ++k)
+				BucketOffsets[k + 1] += BucketOffsets[k];
+
+			std::vector<int>& BucketBuffer = *Workspace.m_LeftBuffer;
+			std::vector<int>& BucketFill = Workspace.m_BucketFill;
+			BucketBuffer.resize(DataSetSize);
+			BucketFill.assign(BucketOffsets.begin(), BucketOffsets.end() - 1);
+			for (int k = 0; k < DataSetSize; ++k)
+				BucketBuffer[BucketFill[PointBuckets[k]]++] = Index[k];
+
+			for (int k = 0; k <= NumThresholds; ++k)
+			{
+				Workspace.m_LeftIdx->SetView(DataSetIdx->GetDataSet(), BucketOffsets[k], BucketOffsets[k + 1]);
+				BucketStats[k].Aggregate(Workspace.m_LeftIdx);
+			}
+			AddPhase(Depth, PhaseStatistics, StatsStartTime, NumThresholds + 1);
+
+			return FindBestThresholdFromBuckets(ParentStats, BucketStats, Thresholds.data(), NumThresholds, Workspace, OptObjVal, OptThreshold, Depth);
+		};
+
+		// Same as FindBestThresholdBucketed() for a quantized feature where the bin of every data point is already known
+		// and the bin edges are the thresholds. Bin statistics start from EmptyStats and data points are accumulated
+		bool FindBestThresholdHistogram(S& ParentStats, const S& EmptyStats, AbstractDataSet& DataSet, const int * Index, int DataSetSize
+			, const uint8_t * Bins, const std::vector<VPFloat>& BinEdges, SplitWorkspace<S>& Workspace, VPFloat& OptObjVal, VPFloat& OptThreshold, int Depth)
+		{
+			int NumThresholds = BinEdges.size();
+			if (NumThresholds == 0)
+				return false;
+			uint64_t StatsStartTime = GetCurrentEpochTime();
+
+			// Only non-empty bins get statistics. All edges between two non-empty bins give the same partition
+			// so only the smallest one is evaluated (the one a scan over all bin edges would pick on ties)
+			std::vector<int>& BinSlots = Workspace.m_BinSlots;
+			BinSlots.assign(NumThresholds + 1, -1);
+			for (int k = 0; k < DataSetSize; ++k)
+				BinSlots[Bins[Index[k]]] = 0;
+			std::vector<VPFloat>& Thresholds = Workspace.m_Thresholds;
+			Thresholds.clear();
+			int NumSlots = 0;
+			for (int b = 0, PrevBin = -1; b <= NumThresholds; ++b)
+			{
+				if (BinSlots[b] < 0)
+					continue;
+				if (PrevBin >= 0)
+					Thresholds.push_back(BinEdges[PrevBin]);
+				BinSlots[b] = NumSlots++;
+				PrevBin = b;
+			}
+			if (NumSlots < 2)
+			{
+				AddPhase(Depth, PhaseStatistics, StatsStartTime, 0);
+				return false;
+			}
+
+			S * BinStats = Workspace.GetAccumulators(NumSlots, EmptyStats);
+			for (int k = 0; k < DataSetSize; ++k)
+				BinStats[BinSlots[Bins[Index[k]]]].Accumulate(DataSet, Index[k]);
+			AddPhase(Depth, PhaseStatistics, StatsStartTime, NumSlots);
+
+			return FindBestThresholdFromBuckets(ParentStats, BinStats, Thresholds.data(), NumSlots - 1, Workspace, OptObjVal, OptThreshold, Depth);
+		};
+
+		// Given the statistics of the NumThresholds + 1 buckets between sorted thresholds (see FindBestThresholdBucketed())
+		// finds the threshold with the best objective value by cumulatively merging bucket statistics
+		// Timed as PhaseObjective of level Depth
+		bool FindBestThresholdFromBuckets(S& ParentStats, S * BucketStats, const VPFloat * Thresholds, int NumThresholds, SplitWorkspace<S>& Workspace
+			, VPFloat& OptObjVal, VPFloat& OptThreshold, int Depth)
+		{
+			if (NumThresholds == 0)
+				return false;
+			uint64_t ObjectiveStartTime = GetCurrentEpochTime();
+
+			// Right statistics for threshold j are the merged buckets 0..j, left ones are the merged buckets j+1..T
+			S * RightStats = SplitWorkspace<S>::GetStats(Workspace.m_CumulativeStats, NumThresholds);
+			RightStats[0] = BucketStats[0];
+			for (int j = 1; j < NumThresholds; ++j)
+			{
+				RightStats[j] = RightStats[j - 1];
+				MergeStatistics(RightStats[j], BucketStats[j]);
+			}
+
+			bool isValid = false;
+			S& LeftStats = Workspace.m_LeftStats;
+			LeftStats = BucketStats[NumThresholds];
+			for (int j = NumThresholds - 1; j >= 0; --j)
+			{
+				if (j < NumThresholds - 1)
+					MergeStatistics(LeftStats, BucketStats[j + 1]);
+
+				VPFloat ObjVal = GetObjectiveValue(ParentStats, LeftStats, RightStats[j]);
+				if (ObjVal >= OptObjVal) // >= since we go backwards and want the same threshold as Partition on ties
+				{
+					OptObjVal = ObjVal;
+					OptThreshold = Thresholds[j];
+					isValid = true;
+				}
+			}
+			AddPhase(Depth, PhaseObjective, ObjectiveStartTime, NumThresholds);
+
+			return isValid;
 		};
 
 		const std::vector<VPFloat> SelectThresholds(const std::vector<VPFloat>& Responses, const int DataSubsetSize)
+		{
+			std::vector<VPFloat> Quantiles;
+			std::vector<VPFloat> Thresholds;
+			SelectThresholds(Responses, DataSubsetSize, Quantiles, Thresholds);
+			return Thresholds;
+		};
+
+		// Same as above but fills the given vectors (which keep their capacity) with the sampled responses and thresholds
+		void SelectThresholds(const std::vector<VPFloat>& Responses, const int DataSubsetSize, std::vector<VPFloat>& Quantiles, std::vector<VPFloat>& Thresholds)
 		{
 			// std::cout << "Dataset Size: " << DataSubsetIdx->Size() << std::endl;
 			// std::cout << "Responses Size: " << Responses.size() << std::endl;
 			// Please see Efficient Implementation of Decision Forests, Shotton et al. 2013
 			// Section 21.3.3 explains how to implement this threshold selection using quantiles
 			// Also see the Sherwood Library from Microsoft Research
-			std::vector<VPFloat> Thresholds(m_Parameters.m_NumCandidateThresholds); // This is different from the Sherwood implementation. We don't use n+1
-			std::vector<VPFloat> Quantiles(m_Parameters.m_NumCandidateThresholds + 1); // TODO: Candidate for memory saving
+			Quantiles.resize(m_Parameters.m_NumCandidateThresholds + 1);
 
 			// This isn't ideal because if size of data subset is only a few above NumThresh, then Randomizer will repeat some values
 			if (DataSubsetSize > m_Parameters.m_NumCandidateThresholds)
@@ -553,16 +1392,34 @@ namespace Kaadugal
 			else
 			{
 				Quantiles.resize(Responses.size());
-				Thresholds.resize(Responses.size() - 1); // One less than quantiles
 				std::copy(Responses.begin(), Responses.end(), Quantiles.begin());
 			}
 
+			SelectThresholdsFromQuantiles(Quantiles, Thresholds);
+		};
+
+		// Computes one threshold less than the number of sampled responses (approximate quantiles). Sorts Quantiles
+		const std::vector<VPFloat> SelectThresholdsFromQuantiles(std::vector<VPFloat>& Quantiles)
+		{
+			std::vector<VPFloat> Thresholds;
+			SelectThresholdsFromQuantiles(Quantiles, Thresholds);
+			return Thresholds;
+		};
+
+		// Same as above but fills Thresholds (which keeps its capacity). Thresholds is empty if all responses are the same
+		void SelectThresholdsFromQuantiles(std::vector<VPFloat>& Quantiles, std::vector<VPFloat>& Thresholds)
+		{
+			Thresholds.resize(Quantiles.size() - 1); // This is different from the Sherwood implementation. We don't use n+1
+
 			// Now compute quantiles. See https://www.stat.auckland.ac.nz/~ihaka/787/lectures-quantiles-handouts.pdf
 			// if you don't know how to do this
 			std::sort(Quantiles.begin(), Quantiles.end());
 
 			if (Quantiles[0] == Quantiles[Quantiles.size() - 1])
-				return std::vector<VPFloat>(); // Looks like samples were all the same. This is bad
+			{
+				Thresholds.clear(); // Looks like samples were all the same. This is bad
+				return;
+			}
 
 			// Compute n candidate thresholds by sampling in between n+1 approximate quantiles
 			std::uniform_real_distribution<VPFloat> UniRealDist(0, 1); // [0, 1), NOTE the exclusive end
@@ -573,8 +1430,6 @@ namespace Kaadugal
 			// std::cout << "Before return:\n";
 			// for(int j = 0; j < Thresholds.size(); ++j)
 			// 	std::cout << "Thresh: " << Thresholds[j] << std::endl;
-
-			return Thresholds;
 		};
 
 		VPFloat GetObjectiveValue(S& ParentStats, S& LeftStats, S& RightStats)
@@ -591,20 +1446,13 @@ namespace Kaadugal
 				return 0.0;
 
 			// Assuming statistics are already aggregated
-			// NOTE: We are using information gain as the objective function
-			// Change this and use a template/abstract class, if needed
-			// See any of the Shotton et al. papers for this definition
-			VPFloat InformationGain = ParentStats.GetEntropy()
-				- (
-					VPFloat(LeftStats.GetNumDataPoints())  * LeftStats.GetEntropy()
-					+ VPFloat(RightStats.GetNumDataPoints()) * RightStats.GetEntropy()
-				  ) / VPFloat(ParentStats.GetNumDataPoints());
-
-			//std::cout << "InfoGain: " << InformationGain << std::endl;
-
-			//if (InformationGain < 0.0)
+			VPFloat Gain = m_Objective.Evaluate(ParentStats, LeftStats, RightStats);
+
+			//std::cout << "Gain: " << Gain << std::endl;
+
+			//if (Gain < 0.0)
 			//{
-			//	std::cout << "AHEM, NO THIS SHOULD NOT HAPPEN. InfoGain: " << InformationGain << std::endl;
+			//	std::cout << "AHEM, NO THIS SHOULD NOT HAPPEN. Gain: " << Gain << std::endl;
 			//	std::cout << "Parent nPoints: " << ParentStats.GetNumDataPoints() << std::endl;
 			//	std::cout << "Left nPoints: " << LeftStats.GetNumDataPoints() << std::endl;
 			//	std::cout << "Right nPoints: " << RightStats.GetNumDataPoints() << std::endl;
@@ -614,17 +1462,19 @@ namespace Kaadugal
 			//	std::cout << "Right Entropy: " << RightStats.GetEntropy() << std::endl;
 			//}
 
-			return InformationGain;
+			return Gain;
 		};
 
-		bool BuildTreeHybrid(void)
+		// Builds the top of the tree breadth-first with one streaming pass over the data per level. Subtrees
+		// below the switch size or depth are built depth-first so that their data stays in cache
+		bool BuildTreeHybrid(std::shared_ptr<DataSetIndex> DataSetIdx)
 		{
-			// TODO:
-			std::cout << "[ INFO ]: BuildTreeHybrid() is not yet implemented." << std::endl;
-			return false;
+			return BuildTreeBreadthFirst(DataSetIdx, true);
 		};
 
 		std::shared_ptr<DecisionTree<T, S, R>> GetTree(void) { return m_Tree; };
+		// Profile of the last Build(): time and counts of every training phase at every level, node and data point counts
+		const TreeReport& GetReport(void) const { return m_Report; };
 		bool DoneBuild(void) { return m_isTreeTrained; };
 	};
 } // namespace Kaadugal
@@ -0,0 +1,303 @@
+#ifndef _DENSEDATASET_HPP_
+#define _DENSEDATASET_HPP_
+
+#include <vector>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+
+#include "Abstract/AbstractDataSet.hpp"
+#include "MappedFile.hpp"
+
+namespace Kaadugal
+{
+	// A single data point of a DenseDataSet. Only used when a data point object is needed (e.g. testing)
+	// Training with DenseDataSet reads features directly from its columns
+	class DenseDataPoint : public AbstractDataPoint
+	{
+	public:
+		std::vector<VPFloat> m_Features;
+		int m_Label;
+		VPFloat m_Target;
+
+		DenseDataPoint(void)
+			: m_Label(0)
+			, m_Target(0.0)
+		{
+
+		};
+
+		DenseDataPoint(const std::vector<VPFloat>& Features, int Label = 0, VPFloat Target = 0.0)
+			: m_Features(Features)
+			, m_Label(Label)
+			, m_Target(Target)
+		{
+
+		};
+
+		virtual void Serialize(std::ostream& OutputStream) const override
+		{
+			int NumFeatures = m_Features.size();
+			OutputStream.write((const char *)(&NumFeatures), sizeof(int));
+			OutputStream.write((const char *)(m_Features.data()), sizeof(VPFloat) * NumFeatures);
+			OutputStream.write((const char *)(&m_Label), sizeof(int));
+			OutputStream.write((const char *)(&m_Target), sizeof(VPFloat));
+		};
+
+		virtual void Deserialize(std::istream& InputStream) override
+		{
+			int NumFeatures = 0;
+			InputStream.read((char *)(&NumFeatures), sizeof(int));
+			m_Features.resize(NumFeatures);
+			InputStream.read((char *)(m_Features.data()), sizeof(VPFloat) * NumFeatures);
+			InputStream.read((char *)(&m_Label), sizeof(int));
+			InputStream.read((char *)(&m_Target), sizeof(VPFloat));
+		};
+	};
+
+	// Dataset with a fixed number of features per data point stored in contiguous columns (column-major)
+	// along with integer labels (classification) and targets (regression). Data points are not stored as objects
+	// so feature responses and statistics that know about this class (see AxisAlignedFeatureResponse and
+	// DenseStatistics.hpp) read values by index without allocations, casts or reference counting
+	// Values are either stored in memory or in a memory-mapped file (see MappedDataSet). Setters only work in memory
+	class DenseDataSet : public AbstractDataSet
+	{
+	protected:
+		uint64_t m_NumFeatures;
+		uint64_t m_ColumnStride; // Distance between the same data point in two consecutive columns
+		std::vector<VPFloat> m_Features;
+		std::vector<int> m_Labels;
+		std::vector<VPFloat> m_Targets;
+		int m_NumClasses;
+
+		// Values read by the accessors. Point to the vectors above unless the data is memory-mapped
+		const VPFloat * m_FeatureData;
+		const int * m_LabelData;
+		const VPFloat * m_TargetData;
+		std::shared_ptr<MappedFile> m_MappedFile; // Owns the data if it is memory-mapped. Shared by copies
+
+		// Quantized features (see Quantize()). Column-major like m_Features
+		std::vector<uint8_t> m_BinnedFeatures;
+		std::vector<std::vector<VPFloat>> m_BinEdges;
+
+		void BindData(void)
+		{
+			if (m_MappedFile != nullptr)
+				return;
+
+			m_FeatureData = m_Features.data();
+			m_LabelData = m_Labels.data();
+			m_TargetData = m_Targets.data();
+		};
+
+	public:
+		DenseDataSet(uint64_t NumDataPoints = 0, uint64_t NumFeatures = 0)
+			: m_NumClasses(0)
+		{
+			Resize(NumDataPoints, NumFeatures);
+		};
+
+		DenseDataSet(const DenseDataSet& Other)
+		{
+			*this = Other;
+		};
+
+		DenseDataSet& operator=(const DenseDataSet& Other)
+		{
+			AbstractDataSet::operator=(Other);
+			m_NumFeatures = Other.m_NumFeatures;
+			m_ColumnStride = Other.m_ColumnStride;
+			m_Features = Other.m_Features;
+			m_Labels = Other.m_Labels;
+			m_Targets = Other.m_Targets;
+			m_NumClasses = Other.m_NumClasses;
+			m_FeatureData = Other.m_FeatureData;
+			m_LabelData = Other.m_LabelData;
+			m_TargetData = Other.m_TargetData;
+			m_MappedFile = Other.m_MappedFile;
+			m_BinnedFeatures = Other.m_BinnedFeatures;
+			m_BinEdges = Other.m_BinEdges;
+			BindData(); // Data in memory was copied
+
+			return *this;
+		};
+
+		// Existing values are NOT preserved
+		void Resize(uint64_t NumDataPoints, uint64_t NumFeatures)
+		{
+			m_NumDataPoints = NumDataPoints;
+			m_NumFeatures = NumFeatures;
+			m_ColumnStride = NumDataPoints;
+			m_Features.assign(m_NumDataPoints * m_NumFeatures, 0.0);
+			m_Labels.assign(m_NumDataPoints, 0);
+			m_Targets.assign(m_NumDataPoints, 0.0);
+			m_MappedFile = nullptr;
+			BindData();
+			m_BinnedFeatures.clear();
+			m_BinEdges.clear();
+		};
+
+		uint64_t GetNumDataPoints(void) const { return m_NumDataPoints; };
+		uint64_t GetNumFeatures(void) const { return m_NumFeatures; };
+		int GetNumClasses(void) const { return m_NumClasses; };
+		void SetNumClasses(int NumClasses) { m_NumClasses = NumClasses; };
+
+		uint64_t GetColumnStride(void) const { return m_ColumnStride; };
+		bool isMapped(void) const { return m_MappedFile != nullptr; };
+
+		inline VPFloat GetFeature(uint64_t i, uint64_t Feature) const { return m_FeatureData[Feature * m_ColumnStride + i]; };
+		inline void SetFeature(uint64_t i, uint64_t Feature, VPFloat Value) { m_Features[Feature * m_ColumnStride + i] = Value; };
+		const VPFloat * GetColumn(uint64_t Feature) const { return m_FeatureData + Feature * m_ColumnStride; };
+		VPFloat * GetColumn(uint64_t Feature) { return const_cast<VPFloat *>(m_FeatureData) + Feature * m_ColumnStride; }; // Read-only if mapped
+
+		inline int GetLabel(uint64_t i) const { return m_LabelData[i]; };
+		// NOTE: Also grows the number of classes. Not thread-safe, use SetNumClasses() when filling labels in parallel
+		void SetLabel(uint64_t i, int Label)
+		{
+			m_Labels[i] = Label;
+			m_NumClasses = std::max(m_NumClasses, Label + 1);
+		};
+		inline VPFloat GetTarget(uint64_t i) const { return m_TargetData[i]; };
+		// NOTE: nullptr for memory-mapped data without labels (targets). See DataSetFile
+		const int * GetLabels(void) const { return m_LabelData; };
+		int * GetLabels(void) { return const_cast<int *>(m_LabelData); }; // Read-only if mapped
+		const VPFloat * GetTargets(void) const { return m_TargetData; };
+		VPFloat * GetTargets(void) { return const_cast<VPFloat *>(m_TargetData); }; // Read-only if mapped
+		void SetTarget(uint64_t i, VPFloat Target) { m_Targets[i] = Target; };
+
+		// Bin edges are midpoints between distinct values at approximate quantiles of each column so that bins hold
+		// about the same number of data points. Must be called again if features change
+		virtual bool Quantize(int MaxBins = 256) override
+		{
+			MaxBins = std::max(2, std::min(MaxBins, 256));
+			m_BinEdges.assign(m_NumFeatures, std::vector<VPFloat>());
+			m_BinnedFeatures.assign(m_NumFeatures * m_NumDataPoints, 0);
+			if (m_NumDataPoints == 0)
+				return true;
+
+#pragma omp parallel for schedule(dynamic)
+			for (int64_t f = 0; f < int64_t(m_NumFeatures); ++f)
+			{
+				const VPFloat * Column = GetColumn(f);
+				std::vector<VPFloat> Sorted(Column, Column + m_NumDataPoints);
+				std::sort(Sorted.begin(), Sorted.end());
+
+				std::vector<VPFloat>& Edges = m_BinEdges[f];
+				for (int b = 1; b < MaxBins; ++b)
+				{
+					VPFloat Lower = Sorted[std::max(uint64_t(1), b * m_NumDataPoints / MaxBins) - 1];
+					auto Upper = std::upper_bound(Sorted.begin(), Sorted.end(), Lower);
+					if (Upper == Sorted.end())
+						break; // Lower is the largest value
+					VPFloat Edge = Lower + (*Upper - Lower) / 2;
+					if (Edges.empty() || Edge > Edges.back())
+						Edges.push_back(Edge);
+				}
+
+				uint8_t * Bins = m_BinnedFeatures.data() + f * m_NumDataPoints;
+				for (uint64_t i = 0; i < m_NumDataPoints; ++i)
+					Bins[i] = uint8_t(std::lower_bound(Edges.begin(), Edges.end(), Column[i]) - Edges.begin());
+			}
+
+			return true;
+		};
+
+		virtual const uint8_t * GetBinnedFeature(int Feature) override
+		{
+			if (m_BinnedFeatures.empty())
+				return nullptr;
+
+			return m_BinnedFeatures.data() + Feature * m_NumDataPoints;
+		};
+
+		virtual const std::vector<VPFloat> * GetBinEdges(int Feature) override
+		{
+			if (m_BinnedFeatures.empty())
+				return nullptr;
+
+			return &m_BinEdges[Feature];
+		};
+
+		virtual const int * GetLabelData(void) override { return m_LabelData; };
+		virtual int GetNumLabelClasses(void) override { return m_NumClasses; };
+
+		// Values are read in storage order one column at a time and released after every column
+		virtual std::shared_ptr<AbstractDataSet> Gather(const std::vector<int>& Index) override
+		{
+			std::vector<int> Order(Index.size());
+			for (size_t i = 0; i < Order.size(); ++i)
+				Order[i] = int(i);
+			std::sort(Order.begin(), Order.end(), [&Index](int a, int b) { return Index[a] < Index[b]; });
+
+			auto Gathered = std::make_shared<DenseDataSet>(Index.size(), m_NumFeatures);
+			Gathered->SetNumClasses(m_NumClasses);
+			for (uint64_t f = 0; f < m_NumFeatures; ++f)
+			{
+				const VPFloat * Column = GetColumn(f);
+				VPFloat * GatheredColumn = Gathered->GetColumn(f);
+				for (int i : Order)
+					GatheredColumn[i] = Column[Index[i]];
+				Release(0, m_NumDataPoints);
+			}
+			for (int i : Order)
+			{
+				if (m_LabelData != nullptr)
+					Gathered->m_Labels[i] = m_LabelData[Index[i]];
+				if (m_TargetData != nullptr)
+					Gathered->m_Targets[i] = m_TargetData[Index[i]];
+			}
+			Release(0, m_NumDataPoints);
+
+			return Gathered;
+		};
+
+		// Creates a data point object with a copy of the features. Slow, prefer the accessors above
+		virtual std::shared_ptr<AbstractDataPoint> Get(uint64_t i) override
+		{
+			if (i >= m_NumDataPoints)
+				return nullptr;
+
+			auto DataPoint = std::make_shared<DenseDataPoint>();
+			DataPoint->m_Features.resize(m_NumFeatures);
+			for (uint64_t f = 0; f < m_NumFeatures; ++f)
+				DataPoint->m_Features[f] = GetFeature(i, f);
+			DataPoint->m_Label = m_LabelData != nullptr ? GetLabel(i) : 0;
+			DataPoint->m_Target = m_TargetData != nullptr ? GetTarget(i) : 0.0;
+
+			return DataPoint;
+		};
+
+		virtual void Special(int NodeIndex = 0, const int * Index = nullptr, int IndexSize = 0) override
+		{
+
+		};
+
+		virtual void Serialize(std::ostream& OutputStream) override
+		{
+			OutputStream.write((const char *)(&m_NumDataPoints), sizeof(uint64_t));
+			OutputStream.write((const char *)(&m_NumFeatures), sizeof(uint64_t));
+			OutputStream.write((const char *)(&m_NumClasses), sizeof(int));
+			for (uint64_t f = 0; f < m_NumFeatures; ++f)
+				OutputStream.write((const char *)(GetColumn(f)), sizeof(VPFloat) * m_NumDataPoints);
+			std::vector<char> Zeros((m_LabelData == nullptr || m_TargetData == nullptr) ? sizeof(VPFloat) * m_NumDataPoints : 0, 0); // Missing in mapped data
+			OutputStream.write(m_LabelData != nullptr ? (const char *)(m_LabelData) : Zeros.data(), sizeof(int) * m_NumDataPoints);
+			OutputStream.write(m_TargetData != nullptr ? (const char *)(m_TargetData) : Zeros.data(), sizeof(VPFloat) * m_NumDataPoints);
+		};
+
+		virtual void Deserialize(std::istream& InputStream) override
+		{
+			uint64_t NumDataPoints = 0;
+			uint64_t NumFeatures = 0;
+			InputStream.read((char *)(&NumDataPoints), sizeof(uint64_t));
+			InputStream.read((char *)(&NumFeatures), sizeof(uint64_t));
+			InputStream.read((char *)(&m_NumClasses), sizeof(int));
+			Resize(NumDataPoints, NumFeatures);
+			for (uint64_t f = 0; f < m_NumFeatures; ++f)
+				InputStream.read((char *)(GetColumn(f)), sizeof(VPFloat) * m_NumDataPoints);
+			InputStream.read((char *)(m_Labels.data()), sizeof(int) * m_NumDataPoints);
+			InputStream.read((char *)(m_Targets.data()), sizeof(VPFloat) * m_NumDataPoints);
+		};
+	};
+} // namespace Kaadugal
+
+#endif // _DENSEDATASET_HPP_
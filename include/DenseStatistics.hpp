@@ -0,0 +1,302 @@
+#ifndef _DENSESTATISTICS_HPP_
+#define _DENSESTATISTICS_HPP_
+
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+
+#include "Abstract/AbstractStatistics.hpp"
+#include "DenseDataSet.hpp"
+
+namespace Kaadugal
+{
+	// Class histogram statistics over the labels of a DenseDataSet
+	class DenseHistogramStats : public StaticStatistics<DenseHistogramStats, DenseDataSet>
+	{
+	protected:
+		// NOTE: If new members are added, remember to add them to serialize/deserialize
+		int m_nClasses; // This is also the number of bins
+		std::vector<int> m_Bins;
+		int m_nDataPoints;
+
+	public:
+		DenseHistogramStats(void)
+			: m_nClasses(0)
+			, m_nDataPoints(0)
+		{
+
+		};
+
+		DenseHistogramStats(std::shared_ptr<DataSetIndex> DataSetIdx)
+			: m_nClasses(0)
+			, m_nDataPoints(0)
+		{
+			Aggregate(DataSetIdx);
+		};
+
+		virtual void Serialize(std::ostream& OutputStream) const override
+		{
+			OutputStream.write((const char *)(&m_nClasses), sizeof(int));
+			OutputStream.write((const char *)(&m_nDataPoints), sizeof(int));
+			OutputStream.write((const char *)(m_Bins.data()), sizeof(int) * m_nClasses);
+		};
+
+		virtual void Deserialize(std::istream& InputStream) override
+		{
+			InputStream.read((char *)(&m_nClasses), sizeof(int));
+			InputStream.read((char *)(&m_nDataPoints), sizeof(int));
+			m_Bins.resize(m_nClasses, 0);
+			InputStream.read((char *)(m_Bins.data()), sizeof(int) * m_nClasses);
+			m_isAggregated = true;
+		};
+
+		const int& GetNumClasses(void) const { return m_nClasses; };
+		const int& GetNumDataPoints(void) const { return m_nDataPoints; };
+		const std::vector<int>& GetBins(void) const { return m_Bins; };
+
+		void AggregateStats(const DenseDataSet& DataSet, const int * Index, int Size)
+		{
+			m_nClasses = DataSet.GetNumClasses();
+			m_Bins.assign(m_nClasses, 0);
+			m_nDataPoints = Size;
+			for (int i = 0; i < m_nDataPoints; ++i)
+			{
+				int DataLabel = DataSet.GetLabel(Index[i]);
+				if (DataLabel < 0 || DataLabel > m_nClasses - 1)
+					throw std::runtime_error("Data point label is inconsistent with number of classes. Exiting.");
+
+				m_Bins[DataLabel]++;
+			}
+
+			m_isAggregated = true;
+		};
+
+		void AccumulateStats(const DenseDataSet& DataSet, uint64_t DataPointIndex)
+		{
+			m_Bins[DataSet.GetLabel(DataPointIndex)]++;
+			m_nDataPoints++;
+			m_isAggregated = true;
+		};
+
+		void MergeStats(const DenseHistogramStats& OtherStats)
+		{
+			if (m_isAggregated == false) // E.g. default constructed forest statistics when testing
+			{
+				m_nClasses = OtherStats.GetNumClasses();
+				m_Bins.assign(m_nClasses, 0);
+			}
+			if (OtherStats.GetNumClasses() != m_nClasses)
+				throw std::runtime_error("Cannot merge statistics. Number of classes don't match. Exiting.");
+
+			m_nDataPoints += OtherStats.GetNumDataPoints();
+			const int * OtherBins = OtherStats.GetBins().data();
+			for (int i = 0; i < m_nClasses; ++i)
+				m_Bins[i] += OtherBins[i];
+
+			m_isAggregated = true;
+		};
+
+		bool SubtractStats(const DenseHistogramStats& OtherStats)
+		{
+			if (OtherStats.GetNumClasses() != m_nClasses)
+				return false;
+
+			m_nDataPoints -= OtherStats.GetNumDataPoints();
+			const int * OtherBins = OtherStats.GetBins().data();
+			for (int i = 0; i < m_nClasses; ++i)
+				m_Bins[i] -= OtherBins[i];
+
+			return true;
+		};
+
+		virtual bool Reset(void) override
+		{
+			std::fill(m_Bins.begin(), m_Bins.end(), 0);
+			m_nDataPoints = 0;
+			m_isAggregated = true;
+
+			return true;
+		};
+
+		virtual bool SetLabelCounts(const int * Counts, int NumClasses) override
+		{
+			m_nClasses = NumClasses;
+			m_Bins.assign(Counts, Counts + NumClasses);
+			m_nDataPoints = 0;
+			for (int i = 0; i < NumClasses; ++i)
+				m_nDataPoints += Counts[i];
+			m_isAggregated = true;
+
+			return true;
+		};
+
+		virtual const int * GetLabelCounts(int& NumClasses) const override
+		{
+			NumClasses = m_nClasses;
+			return m_Bins.empty() ? nullptr : m_Bins.data();
+		};
+
+		inline VPFloat GetProbability(int ClassLabel) const
+		{
+			if (m_nDataPoints <= 0)
+				return 0.0;
+
+			return VPFloat(m_Bins[ClassLabel]) / VPFloat(m_nDataPoints);
+		};
+
+		int FindWinnerLabelIndex(void) const
+		{
+			return std::distance(m_Bins.begin(), std::max_element(m_Bins.begin(), m_Bins.end())); // Return index of class label with most data points
+		};
+
+		VPFloat GetEntropy(void) const
+		{
+			if (m_isAggregated == false)
+				return 0.0;
+
+			VPFloat Entropy = 0.0;
+			for (int i = 0; i < m_nClasses; ++i)
+			{
+				VPFloat p = GetProbability(i);
+				Entropy -= p == 0.0 ? 0.0 : (p * log(p)) / log(2.0);
+			}
+
+			return Entropy;
+		};
+	};
+
+	// Mean and variance of the (scalar) targets of a DenseDataSet for regression
+	// Sums are kept in double precision so that statistics can be accumulated and merged exactly
+	class DenseRegressionStats : public StaticStatistics<DenseRegressionStats, DenseDataSet>
+	{
+	protected:
+		// NOTE: If new members are added, remember to add them to serialize/deserialize
+		int m_nDataPoints;
+		double m_Sum;
+		double m_SumSquares;
+
+	public:
+		DenseRegressionStats(void)
+			: m_nDataPoints(0)
+			, m_Sum(0.0)
+			, m_SumSquares(0.0)
+		{
+
+		};
+
+		DenseRegressionStats(std::shared_ptr<DataSetIndex> DataSetIdx)
+			: m_nDataPoints(0)
+			, m_Sum(0.0)
+			, m_SumSquares(0.0)
+		{
+			Aggregate(DataSetIdx);
+		};
+
+		virtual void Serialize(std::ostream& OutputStream) const override
+		{
+			OutputStream.write((const char *)(&m_nDataPoints), sizeof(int));
+			OutputStream.write((const char *)(&m_Sum), sizeof(double));
+			OutputStream.write((const char *)(&m_SumSquares), sizeof(double));
+		};
+
+		virtual void Deserialize(std::istream& InputStream) override
+		{
+			InputStream.read((char *)(&m_nDataPoints), sizeof(int));
+			InputStream.read((char *)(&m_Sum), sizeof(double));
+			InputStream.read((char *)(&m_SumSquares), sizeof(double));
+			m_isAggregated = true;
+		};
+
+		const int& GetNumDataPoints(void) const { return m_nDataPoints; };
+		double GetSum(void) const { return m_Sum; };
+		double GetSumSquares(void) const { return m_SumSquares; };
+
+		void AggregateStats(const DenseDataSet& DataSet, const int * Index, int Size)
+		{
+			m_nDataPoints = Size;
+			m_Sum = 0.0;
+			m_SumSquares = 0.0;
+			for (int i = 0; i < m_nDataPoints; ++i)
+			{
+				double Target = DataSet.GetTarget(Index[i]);
+				m_Sum += Target;
+				m_SumSquares += Target * Target;
+			}
+
+			m_isAggregated = true;
+		};
+
+		void AccumulateStats(const DenseDataSet& DataSet, uint64_t DataPointIndex)
+		{
+			double Target = DataSet.GetTarget(DataPointIndex);
+			m_Sum += Target;
+			m_SumSquares += Target * Target;
+			m_nDataPoints++;
+			m_isAggregated = true;
+		};
+
+		void MergeStats(const DenseRegressionStats& OtherStats)
+		{
+			m_nDataPoints += OtherStats.GetNumDataPoints();
+			m_Sum += OtherStats.GetSum();
+			m_SumSquares += OtherStats.GetSumSquares();
+			m_isAggregated = true;
+		};
+
+		// NOTE: Unlike merging this is not exact in floating point, but the error is far below the variance of any real node
+		bool SubtractStats(const DenseRegressionStats& OtherStats)
+		{
+			m_nDataPoints -= OtherStats.GetNumDataPoints();
+			m_Sum -= OtherStats.GetSum();
+			m_SumSquares -= OtherStats.GetSumSquares();
+			if (m_nDataPoints == 0) // Avoid a tiny non-zero residual
+			{
+				m_Sum = 0.0;
+				m_SumSquares = 0.0;
+			}
+
+			return true;
+		};
+
+		virtual bool Reset(void) override
+		{
+			m_nDataPoints = 0;
+			m_Sum = 0.0;
+			m_SumSquares = 0.0;
+			m_isAggregated = true;
+
+			return true;
+		};
+
+		VPFloat GetMean(void) const
+		{
+			if (m_nDataPoints <= 0)
+				return 0.0;
+
+			return VPFloat(m_Sum / m_nDataPoints);
+		};
+
+		// Unbiased sample variance
+		VPFloat GetVariance(void) const
+		{
+			if (m_nDataPoints <= 1)
+				return 0.0;
+
+			double Variance = (m_SumSquares - m_Sum * m_Sum / m_nDataPoints) / (m_nDataPoints - 1);
+			return VPFloat(std::max(0.0, Variance));
+		};
+
+		// Differential entropy of a Gaussian up to a constant (same as the regression example)
+		// The variance is clamped so that constant targets don't give infinite information gain
+		VPFloat GetEntropy(void) const
+		{
+			if (m_isAggregated == false)
+				return 0.0;
+
+			return VPFloat(log(std::max(double(GetVariance()), 1e-12)) / log(2.0)); // Using base-2 log
+		};
+	};
+} // namespace Kaadugal
+
+#endif // _DENSESTATISTICS_HPP_
@@ -0,0 +1,231 @@
+#ifndef _FORESTSHARD_HPP_
+#define _FORESTSHARD_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <typeinfo>
+#include <algorithm>
+#include <stdexcept>
+
+#include "DecisionForest.hpp"
+#include "Parameters.hpp"
+#include "Utilities.hpp"
+
+namespace Kaadugal
+{
+	// Part of a forest trained by one process (see DecisionForestBuilder::Build() with a range of trees) and merging
+	// of such parts into a forest. A shard file records what its trees were trained with so that Merge() can refuse
+	// parts of different forests: fingerprints of the T/S/R types and of the parameters, the seed and the number of
+	// training data points. Trees are stored in the stream format of DecisionTree with a size and checksum each
+	// Layout: header, NumShardTrees TreeRecords and the serialized trees in the same order. Values are in host byte order
+	class ForestShard
+	{
+	public:
+		// Version of the file format. Increment when the layout changes
+		static const uint32_t s_FileVersion = 1;
+
+		struct Header
+		{
+			char m_Magic[8];
+			uint32_t m_Version;
+			uint32_t m_ByteOrder; // s_ByteOrderMark as written by the host that saved the file
+			uint32_t m_FloatSize; // sizeof(VPFloat)
+			int32_t m_NumTrees; // Trees in the whole forest
+			int32_t m_NumShardTrees; // Trees in this file
+			uint32_t m_Reserved;
+			uint64_t m_TypeFingerprint; // See GetTypeFingerprint()
+			uint64_t m_ParameterFingerprint; // See ForestBuilderParameters::GetFingerprint()
+			uint64_t m_Seed;
+			uint64_t m_NumDataPoints;
+			uint64_t m_Checksum; // Of the header (with this set to 0) and the tree records
+		};
+
+		struct TreeRecord
+		{
+			int32_t m_TreeIndex; // Index of the tree in the whole forest
+			uint32_t m_Reserved;
+			uint64_t m_Size; // Bytes of the serialized tree
+			uint64_t m_Checksum; // Of the serialized tree
+		};
+
+	private:
+		static const uint32_t s_ByteOrderMark = 0x01020304;
+		static const char * GetMagic(void) { return "KDGLSHRD"; };
+
+		static uint64_t GetChecksum(Header FileHeader, const std::vector<TreeRecord>& Records)
+		{
+			FileHeader.m_Checksum = 0;
+			uint64_t Hash = HashBytes(&FileHeader, sizeof(Header));
+			return HashBytes(Records.data(), sizeof(TreeRecord) * Records.size(), Hash);
+		};
+
+	public:
+		// Trees can only be read by a program built with the same T/S/R types (and compiler)
+		template<class T, class S, class R>
+		static uint64_t GetTypeFingerprint(void)
+		{
+			std::string Types = std::string(typeid(T).name()) + "|" + typeid(S).name() + "|" + typeid(R).name();
+			uint64_t FloatSize = sizeof(VPFloat);
+			return HashBytes(Types.data(), Types.size(), HashBytes(&FloatSize, sizeof(FloatSize)));
+		};
+
+		// Trees [FirstTree, EndTree) that shard ShardIndex of NumShards trains. Shards differ in size by at most one tree
+		static void GetTreeRange(int NumTrees, int ShardIndex, int NumShards, int& FirstTree, int& EndTree)
+		{
+			FirstTree = int(int64_t(NumTrees) * ShardIndex / NumShards);
+			EndTree = int(int64_t(NumTrees) * (ShardIndex + 1) / NumShards);
+		};
+
+		// Writes the trees of Forest. TreeIndices are their indices in the whole forest
+		// (see DecisionForestBuilder::GetTreeIndices())
+		template<class T, class S, class R>
+		static bool Save(const std::string& FileName, const DecisionForest<T, S, R>& Forest, const std::vector<int>& TreeIndices
+			, const ForestBuilderParameters& Parameters, uint64_t NumDataPoints)
+		{
+			int NumShardTrees = TreeIndices.size();
+			if (NumShardTrees > Forest.GetNumTrees())
+				throw std::runtime_error("More tree indices than trees in the forest shard.");
+
+			std::vector<std::string> Trees(NumShardTrees);
+			std::vector<TreeRecord> Records(NumShardTrees);
+			for (int i = 0; i < NumShardTrees; ++i)
+			{
+				std::ostringstream TreeStream(std::ios::out | std::ios::binary);
+				Forest.GetTree(i)->Serialize(TreeStream);
+				Trees[i] = TreeStream.str();
+				std::memset(&Records[i], 0, sizeof(TreeRecord));
+				Records[i].m_TreeIndex = TreeIndices[i];
+				Records[i].m_Size = Trees[i].size();
+				Records[i].m_Checksum = HashBytes(Trees[i].data(), Trees[i].size());
+			}
+
+			Header FileHeader;
+			std::memset(&FileHeader, 0, sizeof(Header));
+			std::memcpy(FileHeader.m_Magic, GetMagic(), sizeof(FileHeader.m_Magic));
+			FileHeader.m_Version = s_FileVersion;
+			FileHeader.m_ByteOrder = s_ByteOrderMark;
+			FileHeader.m_FloatSize = sizeof(VPFloat);
+			FileHeader.m_NumTrees = Parameters.m_NumTrees;
+			FileHeader.m_NumShardTrees = NumShardTrees;
+			FileHeader.m_TypeFingerprint = GetTypeFingerprint<T, S, R>();
+			FileHeader.m_ParameterFingerprint = Parameters.GetFingerprint();
+			FileHeader.m_Seed = Parameters.m_Seed;
+			FileHeader.m_NumDataPoints = NumDataPoints;
+			FileHeader.m_Checksum = GetChecksum(FileHeader, Records);
+
+			std::ofstream OutputStream(FileName, std::ios::out | std::ios::trunc | std::ios::binary);
+			if (!OutputStream.is_open())
+			{
+				std::cout << "[ WARN ]: Unable to open file " << FileName << " to save forest shard." << std::endl;
+				return false;
+			}
+			OutputStream.write((const char *)(&FileHeader), sizeof(Header));
+			OutputStream.write((const char *)(Records.data()), sizeof(TreeRecord) * NumShardTrees);
+			for (int i = 0; i < NumShardTrees; ++i)
+				OutputStream.write(Trees[i].data(), Trees[i].size());
+
+			return OutputStream.good();
+		};
+
+		// Reads a shard and checks its header and the checksums of all trees. Throws if anything does not match
+		static Header Load(const std::string& FileName, std::vector<TreeRecord>& Records, std::vector<std::string>& Trees)
+		{
+			std::ifstream InputStream(FileName, std::ios::in | std::ios::binary);
+			if (!InputStream.is_open())
+				throw std::runtime_error("Unable to open forest shard " + FileName + ".");
+
+			Header FileHeader;
+			std::memset(&FileHeader, 0, sizeof(Header));
+			InputStream.read((char *)(&FileHeader), sizeof(Header));
+			if (!InputStream.good() || std::memcmp(FileHeader.m_Magic, GetMagic(), sizeof(FileHeader.m_Magic)) != 0)
+				throw std::runtime_error("File " + FileName + " is not a Kaadugal forest shard.");
+			if (FileHeader.m_Version != s_FileVersion)
+				throw std::runtime_error("Forest shard " + FileName + " has unsupported version " + std::to_string(FileHeader.m_Version) + ".");
+			if (FileHeader.m_ByteOrder != s_ByteOrderMark || FileHeader.m_FloatSize != sizeof(VPFloat))
+				throw std::runtime_error("Forest shard " + FileName + " was saved on an incompatible platform or with a different VPFloat.");
+			if (FileHeader.m_NumShardTrees < 0 || FileHeader.m_NumTrees < FileHeader.m_NumShardTrees)
+				throw std::runtime_error("Forest shard " + FileName + " is corrupt.");
+
+			Records.resize(FileHeader.m_NumShardTrees);
+			InputStream.read((char *)(Records.data()), sizeof(TreeRecord) * Records.size());
+			if (!InputStream.good() || GetChecksum(FileHeader, Records) != FileHeader.m_Checksum)
+				throw std::runtime_error("Forest shard " + FileName + " is truncated or corrupt.");
+
+			Trees.resize(Records.size());
+			for (size_t i = 0; i < Records.size(); ++i)
+			{
+				Trees[i].resize(Records[i].m_Size);
+				InputStream.read(&Trees[i][0], Records[i].m_Size);
+				if (!InputStream.good() || HashBytes(Trees[i].data(), Trees[i].size()) != Records[i].m_Checksum)
+					throw std::runtime_error("Tree " + std::to_string(Records[i].m_TreeIndex) + " in forest shard " + FileName + " is truncated or corrupt.");
+			}
+
+			return FileHeader;
+		};
+
+		// Merges shards into a forest file that DecisionForest::Deserialize() reads. Trees are ordered by their index
+		// Throws unless all shards are intact, were trained for the same forest and hold every tree exactly once
+		static void Merge(const std::vector<std::string>& ShardFileNames, const std::string& ForestFileName)
+		{
+			if (ShardFileNames.empty())
+				throw std::runtime_error("No forest shards to merge.");
+
+			Header First;
+			std::memset(&First, 0, sizeof(Header));
+			std::vector<std::string> Trees;
+			std::vector<int> TreeShards; // Shard of every tree in the forest, -1 if missing
+			for (int s = 0; s < int(ShardFileNames.size()); ++s)
+			{
+				std::vector<TreeRecord> ShardRecords;
+				std::vector<std::string> ShardTrees;
+				Header ShardHeader = Load(ShardFileNames[s], ShardRecords, ShardTrees);
+				if (s == 0)
+				{
+					First = ShardHeader;
+					Trees.resize(First.m_NumTrees);
+					TreeShards.assign(First.m_NumTrees, -1);
+				}
+				const std::string Mismatch = "Forest shard " + ShardFileNames[s] + " does not belong to the same forest as " + ShardFileNames[0] + ": ";
+				if (ShardHeader.m_TypeFingerprint != First.m_TypeFingerprint)
+					throw std::runtime_error(Mismatch + "different feature response, statistics or leaf data types.");
+				if (ShardHeader.m_ParameterFingerprint != First.m_ParameterFingerprint || ShardHeader.m_NumTrees != First.m_NumTrees)
+					throw std::runtime_error(Mismatch + "different training parameters.");
+				if (ShardHeader.m_Seed != First.m_Seed)
+					throw std::runtime_error(Mismatch + "different seed.");
+				if (ShardHeader.m_NumDataPoints != First.m_NumDataPoints)
+					throw std::runtime_error(Mismatch + "different number of training data points.");
+
+				for (size_t i = 0; i < ShardRecords.size(); ++i)
+				{
+					int TreeIndex = ShardRecords[i].m_TreeIndex;
+					if (TreeIndex < 0 || TreeIndex >= First.m_NumTrees)
+						throw std::runtime_error("Forest shard " + ShardFileNames[s] + " has invalid tree index " + std::to_string(TreeIndex) + ".");
+					if (TreeShards[TreeIndex] >= 0)
+						throw std::runtime_error("Tree " + std::to_string(TreeIndex) + " is in forest shards " + ShardFileNames[TreeShards[TreeIndex]] + " and " + ShardFileNames[s] + ".");
+					TreeShards[TreeIndex] = s;
+					Trees[TreeIndex].swap(ShardTrees[i]);
+				}
+			}
+			int NumMissing = std::count(TreeShards.begin(), TreeShards.end(), -1);
+			if (NumMissing > 0)
+				throw std::runtime_error(std::to_string(NumMissing) + " of " + std::to_string(First.m_NumTrees) + " trees are missing from the forest shards (first missing is tree "
+					+ std::to_string(std::find(TreeShards.begin(), TreeShards.end(), -1) - TreeShards.begin()) + ").");
+
+			std::ofstream OutputStream(ForestFileName, std::ios::out | std::ios::trunc | std::ios::binary);
+			if (!OutputStream.is_open())
+				throw std::runtime_error("Unable to open forest file " + ForestFileName + ".");
+			int NumTrees = First.m_NumTrees;
+			OutputStream.write((const char *)(&NumTrees), sizeof(int));
+			for (int i = 0; i < NumTrees; ++i)
+				OutputStream.write(Trees[i].data(), Trees[i].size());
+			if (!OutputStream.good())
+				throw std::runtime_error("Unable to write forest file " + ForestFileName + ".");
+		};
+	};
+} // namespace Kaadugal
+
+#endif // _FORESTSHARD_HPP_
@@ -0,0 +1,175 @@
+#ifndef _LABELCOUNTS_HPP_
+#define _LABELCOUNTS_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <stdexcept>
+
+#include "KaadugalDefines.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define KAADUGAL_LABELCOUNTS_X86
+#include <immintrin.h>
+#endif
+
+namespace Kaadugal
+{
+	// Kernels for counting class labels on both sides of many thresholds in one pass over the responses
+	// The best kernel supported by the CPU is selected at runtime. SIMD kernels are only used when VPFloat is float
+	enum LabelCountKernel
+	{
+		Scalar, // Binary search for every response
+		SSE2, // 4 responses at a time compared against all thresholds
+		AVX2, // 8 responses at a time compared against all thresholds
+	};
+
+	namespace LabelCounts
+	{
+		// Beyond this many thresholds a binary search per response is cheaper than comparing against all of them
+		static const int s_MaxSIMDThresholds = 256;
+
+		inline const char * GetKernelName(LabelCountKernel Kernel)
+		{
+			if (Kernel == LabelCountKernel::AVX2)
+				return "AVX2";
+			if (Kernel == LabelCountKernel::SSE2)
+				return "SSE2";
+			return "Scalar";
+		};
+
+		inline bool isKernelSupported(LabelCountKernel Kernel)
+		{
+#ifdef KAADUGAL_LABELCOUNTS_X86
+			if (Kernel == LabelCountKernel::AVX2)
+				return __builtin_cpu_supports("avx2");
+			if (Kernel == LabelCountKernel::SSE2)
+				return __builtin_cpu_supports("sse2");
+#endif
+			return Kernel == LabelCountKernel::Scalar;
+		};
+
+		inline LabelCountKernel GetBestKernel(void)
+		{
+			static const LabelCountKernel BestKernel = isKernelSupported(LabelCountKernel::AVX2) ? LabelCountKernel::AVX2
+				: (isKernelSupported(LabelCountKernel::SSE2) ? LabelCountKernel::SSE2 : LabelCountKernel::Scalar);
+			return BestKernel;
+		};
+
+		// Bucket of a response is the number of thresholds below it, i.e. the response goes left (Response > Threshold)
+		// for threshold j if and only if j < Bucket
+		template<class F>
+		inline void GetBucketsScalar(const F * Responses, int NumResponses, const F * Thresholds, int NumThresholds, int * Buckets)
+		{
+			for (int i = 0; i < NumResponses; ++i)
+				Buckets[i] = int(std::lower_bound(Thresholds, Thresholds + NumThresholds, Responses[i]) - Thresholds);
+		};
+
+#ifdef KAADUGAL_LABELCOUNTS_X86
+		__attribute__((target("sse2")))
+		inline void GetBucketsSSE2(const float * Responses, int NumResponses, const float * Thresholds, int NumThresholds, int * Buckets)
+		{
+			int i = 0;
+			for (; i + 4 <= NumResponses; i += 4)
+			{
+				__m128 Response = _mm_loadu_ps(Responses + i);
+				__m128i Count = _mm_setzero_si128();
+				for (int j = 0; j < NumThresholds; ++j) // Comparison masks are -1, so subtracting them counts
+					Count = _mm_sub_epi32(Count, _mm_castps_si128(_mm_cmplt_ps(_mm_set1_ps(Thresholds[j]), Response)));
+				_mm_storeu_si128((__m128i *)(Buckets + i), Count);
+			}
+			GetBucketsScalar(Responses + i, NumResponses - i, Thresholds, NumThresholds, Buckets + i);
+		};
+
+		__attribute__((target("avx2")))
+		inline void GetBucketsAVX2(const float * Responses, int NumResponses, const float * Thresholds, int NumThresholds, int * Buckets)
+		{
+			int i = 0;
+			for (; i + 8 <= NumResponses; i += 8)
+			{
+				__m256 Response = _mm256_loadu_ps(Responses + i);
+				__m256i Count = _mm256_setzero_si256();
+				for (int j = 0; j < NumThresholds; ++j)
+					Count = _mm256_sub_epi32(Count, _mm256_castps_si256(_mm256_cmp_ps(_mm256_broadcast_ss(Thresholds + j), Response, _CMP_LT_OQ)));
+				_mm256_storeu_si256((__m256i *)(Buckets + i), Count);
+			}
+			_mm256_zeroupper(); // The compiler does not always do this before the scalar tail. Mixing dirty AVX state and SSE code is very slow
+			GetBucketsScalar(Responses + i, NumResponses - i, Thresholds, NumThresholds, Buckets + i);
+		};
+#endif
+
+		inline void GetBuckets(const float * Responses, int NumResponses, const float * Thresholds, int NumThresholds, int * Buckets, LabelCountKernel Kernel)
+		{
+#ifdef KAADUGAL_LABELCOUNTS_X86
+			if (NumThresholds <= s_MaxSIMDThresholds)
+			{
+				if (Kernel == LabelCountKernel::AVX2)
+					return GetBucketsAVX2(Responses, NumResponses, Thresholds, NumThresholds, Buckets);
+				if (Kernel == LabelCountKernel::SSE2)
+					return GetBucketsSSE2(Responses, NumResponses, Thresholds, NumThresholds, Buckets);
+			}
+#endif
+			GetBucketsScalar(Responses, NumResponses, Thresholds, NumThresholds, Buckets);
+		};
+
+		inline void GetBuckets(const double * Responses, int NumResponses, const double * Thresholds, int NumThresholds, int * Buckets, LabelCountKernel Kernel)
+		{
+			GetBucketsScalar(Responses, NumResponses, Thresholds, NumThresholds, Buckets);
+		};
+	} // namespace LabelCounts
+
+	// Counts the labels of all responses in the NumThresholds + 1 buckets between the sorted thresholds
+	// BucketCounts has (NumThresholds + 1) * NumClasses entries and is overwritten. Bucket k has the responses with exactly k
+	// thresholds below them. The label of response i is Labels[Index[i]] or Labels[i] if Index is nullptr
+	inline void CountLabelsInBuckets(const VPFloat * Responses, const int * Labels, const int * Index, int NumResponses
+		, const VPFloat * Thresholds, int NumThresholds, int NumClasses, int * BucketCounts, LabelCountKernel Kernel = LabelCounts::GetBestKernel())
+	{
+		std::fill(BucketCounts, BucketCounts + int64_t(NumThresholds + 1) * NumClasses, 0);
+
+		// Blocks keep the bucket indices in L1 cache between the two passes
+		const int BlockSize = 1024;
+		int Buckets[BlockSize];
+		for (int Begin = 0; Begin < NumResponses; Begin += BlockSize)
+		{
+			int Size = std::min(BlockSize, NumResponses - Begin);
+			LabelCounts::GetBuckets(Responses + Begin, Size, Thresholds, NumThresholds, Buckets, Kernel);
+			for (int i = 0; i < Size; ++i)
+			{
+				int Label = Index == nullptr ? Labels[Begin + i] : Labels[Index[Begin + i]];
+				if (unsigned(Label) >= unsigned(NumClasses))
+					throw std::runtime_error("Data point label is inconsistent with number of classes. Exiting.");
+
+				BucketCounts[Buckets[i] * NumClasses + Label]++;
+			}
+		}
+	};
+
+	// Class counts on both sides of every threshold (same logic as the builder: Response > Threshold goes left)
+	// LeftCounts and RightCounts have NumThresholds * NumClasses entries. Thresholds must be sorted
+	inline void CountLabelsPerThreshold(const VPFloat * Responses, const int * Labels, const int * Index, int NumResponses
+		, const VPFloat * Thresholds, int NumThresholds, int NumClasses, int * LeftCounts, int * RightCounts, LabelCountKernel Kernel = LabelCounts::GetBestKernel())
+	{
+		if (NumThresholds <= 0)
+			return;
+
+		std::vector<int> BucketCounts(int64_t(NumThresholds + 1) * NumClasses);
+		CountLabelsInBuckets(Responses, Labels, Index, NumResponses, Thresholds, NumThresholds, NumClasses, BucketCounts.data(), Kernel);
+
+		std::vector<int> Totals(BucketCounts.begin(), BucketCounts.begin() + NumClasses);
+		for (int k = 1; k <= NumThresholds; ++k)
+		{
+			for (int c = 0; c < NumClasses; ++c)
+				Totals[c] += BucketCounts[k * NumClasses + c];
+		}
+		for (int j = 0; j < NumThresholds; ++j)
+		{
+			for (int c = 0; c < NumClasses; ++c)
+			{
+				RightCounts[j * NumClasses + c] = (j == 0 ? 0 : RightCounts[(j - 1) * NumClasses + c]) + BucketCounts[j * NumClasses + c];
+				LeftCounts[j * NumClasses + c] = Totals[c] - RightCounts[j * NumClasses + c];
+			}
+		}
+	};
+} // namespace Kaadugal
+
+#endif // _LABELCOUNTS_HPP_
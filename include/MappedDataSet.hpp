@@ -0,0 +1,82 @@
+#ifndef _MAPPEDDATASET_HPP_
+#define _MAPPEDDATASET_HPP_
+
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <stdexcept>
+
+#include "DenseDataSet.hpp"
+#include "DataSetFile.hpp"
+#include "MappedFile.hpp"
+
+namespace Kaadugal
+{
+	// Read-only DenseDataSet backed by a memory-mapped dataset file (see DataSetFile). The file has the same column-major
+	// layout as DenseDataSet so nothing is loaded up front and the dataset can be larger than memory. Pages are read
+	// when they are first accessed. Breadth-first and hybrid training scan columns in order and release what they
+	// have read (see AbstractDataSet::Release()), so memory use is bounded by ForestBuilderParameters::m_DataMemoryBudget
+	// Depth-first training works too but reads data points in random order
+	class MappedDataSet : public DenseDataSet
+	{
+	private:
+		uint64_t m_FeaturesOffset;
+		uint64_t m_LabelsOffset;
+		uint64_t m_TargetsOffset;
+
+	public:
+		// Maps the file and checks its header. Throws if it is not a compatible dataset file
+		// NOTE: Labels (targets) can only be read if the file has them (see LabelType)
+		MappedDataSet(const std::string& FileName)
+		{
+			std::shared_ptr<MappedFile> File = std::make_shared<MappedFile>(FileName);
+			const char * Data = File->GetData();
+			DataSetFile::Header Header;
+			std::memset(&Header, 0, sizeof(Header));
+			std::memcpy(&Header, Data, std::min(uint64_t(sizeof(Header)), uint64_t(File->GetSize())));
+			DataSetFile::Validate(Header, File->GetSize(), FileName);
+
+			m_NumDataPoints = Header.m_NumDataPoints;
+			m_NumFeatures = Header.m_NumFeatures;
+			m_ColumnStride = Header.m_ColumnStride;
+			m_NumClasses = Header.m_NumClasses;
+			m_FeaturesOffset = Header.m_FeaturesOffset;
+			m_LabelsOffset = Header.m_LabelsOffset;
+			m_TargetsOffset = Header.m_TargetsOffset;
+			m_MappedFile = File;
+			m_FeatureData = (const VPFloat *)(Data + m_FeaturesOffset);
+			m_LabelData = m_LabelsOffset != 0 ? (const int *)(Data + m_LabelsOffset) : nullptr;
+			m_TargetData = m_TargetsOffset != 0 ? (const VPFloat *)(Data + m_TargetsOffset) : nullptr;
+			m_MappedFile->AdviseSequential();
+		};
+
+		// Binned features would have to be kept in memory (a quarter of the dataset for float features)
+		virtual bool Quantize(int MaxBins = 256) override { return false; };
+
+		// NOTE: Deserialize() loads a dataset into memory like DenseDataSet
+		virtual uint64_t GetStoredBytesPerDataPoint(void) override
+		{
+			if (!isMapped())
+				return 0;
+
+			return m_NumFeatures * sizeof(VPFloat) + (m_LabelData != nullptr ? sizeof(int) : 0) + (m_TargetData != nullptr ? sizeof(VPFloat) : 0);
+		};
+
+		virtual void Release(uint64_t Begin, uint64_t End) override
+		{
+			End = std::min(End, m_NumDataPoints);
+			if (!isMapped() || Begin >= End)
+				return;
+
+			for (uint64_t f = 0; f < m_NumFeatures; ++f)
+				m_MappedFile->Release(m_FeaturesOffset + sizeof(VPFloat) * (f * m_ColumnStride + Begin), sizeof(VPFloat) * (End - Begin));
+			if (m_LabelData != nullptr)
+				m_MappedFile->Release(m_LabelsOffset + sizeof(int) * Begin, sizeof(int) * (End - Begin));
+			if (m_TargetData != nullptr)
+				m_MappedFile->Release(m_TargetsOffset + sizeof(VPFloat) * Begin, sizeof(VPFloat) * (End - Begin));
+		};
+	};
+} // namespace Kaadugal
+
+#endif // _MAPPEDDATASET_HPP_
@@ -0,0 +1,145 @@
+#ifndef _MAPPEDFILE_HPP_
+#define _MAPPEDFILE_HPP_
+
+#include <string>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace Kaadugal
+{
+	// Read-only memory mapping of a whole file. Pages are loaded by the OS on first access and are shared
+	// between all processes that map the same file. Throws if the file cannot be mapped
+	class MappedFile
+	{
+	private:
+		const char * m_Data;
+		uint64_t m_Size;
+#ifdef _WIN32
+		HANDLE m_File;
+		HANDLE m_Mapping;
+#endif
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+	public:
+		MappedFile(const std::string& FileName)
+			: m_Data(nullptr)
+			, m_Size(0)
+		{
+#ifdef _WIN32
+			m_Mapping = NULL;
+			m_File = CreateFileA(FileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+			if (m_File == INVALID_HANDLE_VALUE)
+				throw std::runtime_error("Unable to open file " + FileName + " for mapping.");
+			LARGE_INTEGER FileSize;
+			if (!GetFileSizeEx(m_File, &FileSize))
+			{
+				CloseHandle(m_File);
+				throw std::runtime_error("Unable to get size of file " + FileName + ".");
+			}
+			m_Size = uint64_t(FileSize.QuadPart);
+			if (m_Size == 0)
+				return;
+			m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (m_Mapping != NULL)
+				m_Data = (const char *)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+			if (m_Data == nullptr)
+			{
+				if (m_Mapping != NULL)
+					CloseHandle(m_Mapping);
+				CloseHandle(m_File);
+				throw std::runtime_error("Unable to map file " + FileName + ".");
+			}
+#else
+			int File = open(FileName.c_str(), O_RDONLY);
+			if (File < 0)
+				throw std::runtime_error("Unable to open file " + FileName + " for mapping.");
+			struct stat FileStat;
+			if (fstat(File, &FileStat) != 0)
+			{
+				close(File);
+				throw std::runtime_error("Unable to get size of file " + FileName + ".");
+			}
+			m_Size = uint64_t(FileStat.st_size);
+			if (m_Size > 0)
+			{
+				void * Data = mmap(nullptr, m_Size, PROT_READ, MAP_SHARED, File, 0);
+				if (Data == MAP_FAILED)
+				{
+					close(File);
+					throw std::runtime_error("Unable to map file " + FileName + ".");
+				}
+				m_Data = (const char *)Data;
+			}
+			close(File); // The mapping stays valid
+#endif
+		};
+
+		~MappedFile(void)
+		{
+#ifdef _WIN32
+			if (m_Data != nullptr)
+				UnmapViewOfFile(m_Data);
+			if (m_Mapping != NULL)
+				CloseHandle(m_Mapping);
+			CloseHandle(m_File);
+#else
+			if (m_Data != nullptr)
+				munmap((void *)m_Data, m_Size);
+#endif
+		};
+
+		const char * GetData(void) const { return m_Data; };
+		uint64_t GetSize(void) const { return m_Size; };
+
+		// Hint that the mapping is mostly read in order so the OS reads ahead aggressively
+		void AdviseSequential(void) const
+		{
+#ifndef _WIN32
+			if (m_Data != nullptr)
+				madvise((void *)m_Data, m_Size, MADV_SEQUENTIAL);
+#endif
+		};
+
+		// Drops the pages that lie completely within [Offset, Offset + Size) from the memory of this process
+		// The data stays in the file and is read again on the next access
+		void Release(uint64_t Offset, uint64_t Size) const
+		{
+			if (m_Data == nullptr || Offset >= m_Size)
+				return;
+			Size = std::min(Size, m_Size - Offset);
+#ifdef _WIN32
+			SYSTEM_INFO Info;
+			GetSystemInfo(&Info);
+			uint64_t PageSize = Info.dwPageSize;
+#else
+			uint64_t PageSize = uint64_t(sysconf(_SC_PAGESIZE));
+#endif
+			uint64_t Begin = (uintptr_t(m_Data) + Offset + PageSize - 1) / PageSize * PageSize;
+			uint64_t End = (uintptr_t(m_Data) + Offset + Size) / PageSize * PageSize;
+			if (Begin >= End)
+				return;
+#ifdef _WIN32
+			VirtualUnlock((void *)Begin, End - Begin); // Removes unlocked pages from the working set
+#else
+			madvise((void *)Begin, End - Begin, MADV_DONTNEED);
+#endif
+		};
+	};
+} // namespace Kaadugal
+
+#endif // _MAPPEDFILE_HPP_
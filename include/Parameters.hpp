@@ -6,6 +6,10 @@
 #include <sstream>
 #include <string>
 #include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+
+#include "Utilities.hpp"
 
 namespace Kaadugal
 {
@@ -16,6 +20,15 @@ namespace Kaadugal
 		Hybrid
 	};
 
+	// How candidate thresholds of a feature response are evaluated during split search
+	enum SplitSearch
+	{
+		Partition, // Partition the data and aggregate left/right statistics for every threshold
+		Bucketed, // Bucket all responses in one pass and merge bucket statistics cumulatively. Needs an exact Merge() for statistics
+		Histogram, // Features are quantized into at most 256 bins before training and bin edges are the thresholds. Needs axis-aligned
+		           // feature responses, a dataset that supports AbstractDataSet::Quantize() and statistics with Accumulate()
+	};
+
 	class ForestBuilderParameters
 	{
 	public:
@@ -28,6 +41,19 @@ namespace Kaadugal
 		VPFloat m_MinGain; // Minimum gain to tolerate
 		int m_NumThreads; // If OpenMP is used
 		int m_MinDataSetSize; // Defines when to stop learning and create leaf
+		SplitSearch m_SplitSearch;
+		// Hybrid training builds nodes breadth-first until they are this deep or have at most this many data points
+		// and then builds their subtrees depth-first. Negative switch depth means only node size decides
+		int m_HybridSwitchDepth;
+		int m_HybridSwitchSize;
+		bool m_ParallelTrees; // Train several trees at once. Threads are split between trees and nodes
+		int m_EntropyTableSize; // Counts below this use a lookup table for n * log2(n) in InformationGain
+		// Megabytes of an out-of-core dataset (e.g. MappedDataSet) that breadth-first and hybrid training of a tree keep in memory
+		int m_DataMemoryBudget;
+		// Seed for random numbers. Tree i is trained with a seed derived from this and i so that it does not depend on which
+		// other trees are trained in the same process or on the number of threads (see DecisionForestBuilder::Build())
+		// 0 means a random seed every run
+		uint64_t m_Seed;
 
 		ForestBuilderParameters(const int& NumTrees, const int& MaxLevels
 			, const int& NumCandidateFeatures
@@ -35,7 +61,14 @@ namespace Kaadugal
 			, const VPFloat& MinGain
 			, const TrainMethod& Type = TrainMethod::DFS
 			, const int&  NumThreads = 1
-			, const int& MinDataSetSize = 3)
+			, const int& MinDataSetSize = 3
+			, const SplitSearch& SearchMethod = SplitSearch::Partition
+			, const int& HybridSwitchDepth = -1
+			, const int& HybridSwitchSize = 16384
+			, const bool& ParallelTrees = false
+			, const int& EntropyTableSize = 65536
+			, const int& DataMemoryBudget = 1024
+			, const uint64_t& Seed = 0)
 			: m_NumTrees(NumTrees)
 			, m_MaxLevels(MaxLevels)
 			, m_NumCandidateFeatures(NumCandidateFeatures)
@@ -44,11 +77,26 @@ namespace Kaadugal
 			, m_MinGain(MinGain)
 			, m_NumThreads(NumThreads)
 			, m_MinDataSetSize(MinDataSetSize)
+			, m_SplitSearch(SearchMethod)
+			, m_HybridSwitchDepth(HybridSwitchDepth)
+			, m_HybridSwitchSize(HybridSwitchSize)
+			, m_ParallelTrees(ParallelTrees)
+			, m_EntropyTableSize(EntropyTableSize)
+			, m_DataMemoryBudget(DataMemoryBudget)
+			, m_Seed(Seed)
 		{
 
 		};
 
 		ForestBuilderParameters(const std::string& ParameterFile)
+			: m_MinDataSetSize(3)
+			, m_SplitSearch(SplitSearch::Partition)
+			, m_HybridSwitchDepth(-1)
+			, m_HybridSwitchSize(16384)
+			, m_ParallelTrees(false)
+			, m_EntropyTableSize(65536)
+			, m_DataMemoryBudget(1024)
+			, m_Seed(0)
 		{
 			Deserialize(ParameterFile);
 		};
@@ -64,10 +112,38 @@ namespace Kaadugal
 			m_MinGain = RHS.m_MinGain;
 			m_NumThreads = RHS.m_NumThreads;
 			m_MinDataSetSize = RHS.m_MinDataSetSize;
+			m_SplitSearch = RHS.m_SplitSearch;
+			m_HybridSwitchDepth = RHS.m_HybridSwitchDepth;
+			m_HybridSwitchSize = RHS.m_HybridSwitchSize;
+			m_ParallelTrees = RHS.m_ParallelTrees;
+			m_EntropyTableSize = RHS.m_EntropyTableSize;
+			m_DataMemoryBudget = RHS.m_DataMemoryBudget;
+			m_Seed = RHS.m_Seed;
 
 			return *this;
 		};
 
+		// Hash of the parameters that affect the trained trees. Forests trained in parts (see ForestShard) can only be merged
+		// if their fingerprints match. Parameters that only affect speed or memory use (threads, budgets) are not included
+		// and neither is the seed, which ForestShard compares separately
+		uint64_t GetFingerprint(void) const
+		{
+			uint64_t Hash = HashBytes(&m_NumTrees, sizeof(m_NumTrees));
+			Hash = HashBytes(&m_MaxLevels, sizeof(m_MaxLevels), Hash);
+			Hash = HashBytes(&m_NumCandidateFeatures, sizeof(m_NumCandidateFeatures), Hash);
+			Hash = HashBytes(&m_NumCandidateThresholds, sizeof(m_NumCandidateThresholds), Hash);
+			int Method = m_TrainMethod;
+			Hash = HashBytes(&Method, sizeof(Method), Hash);
+			Hash = HashBytes(&m_MinGain, sizeof(m_MinGain), Hash);
+			Hash = HashBytes(&m_MinDataSetSize, sizeof(m_MinDataSetSize), Hash);
+			int Search = m_SplitSearch;
+			Hash = HashBytes(&Search, sizeof(Search), Hash);
+			Hash = HashBytes(&m_HybridSwitchDepth, sizeof(m_HybridSwitchDepth), Hash);
+			Hash = HashBytes(&m_HybridSwitchSize, sizeof(m_HybridSwitchSize), Hash);
+
+			return Hash;
+		};
+
 		void Serialize(const std::string& ParameterFile)
 		{
 			// TODO:
@@ -81,7 +157,7 @@ namespace Kaadugal
 				// Read parameters from file
 				m_isValid = true;
 				std::string Line;
-				int ConfigCtr = 0;
+				int RequiredCtr = 0; // Only required parameters are counted, optional ones have defaults
 				while (std::getline(ParamFile, Line))
 				{
 					// Skip empty lines or lines beginning with #
@@ -108,7 +184,7 @@ namespace Kaadugal
 							if (Key == "NumTrees")
 							{
 								m_NumTrees = std::atoi(Value.c_str());
-								ConfigCtr++;
+								RequiredCtr++;
 								// std::cout << m_NumTrees << std::endl;
 							}
 							if (Key == "TrainMethod")
@@ -120,37 +196,69 @@ namespace Kaadugal
 								if (Value == "Hybrid")
 									m_TrainMethod = TrainMethod::Hybrid;
 
-								ConfigCtr++;
+								RequiredCtr++;
 							}
 							if (Key == "MaxTreeLevels")
 							{
 								m_MaxLevels = std::atoi(Value.c_str());
-								ConfigCtr++;
+								RequiredCtr++;
 							}
 							if (Key == "NumCandidateFeats")
 							{
 								m_NumCandidateFeatures = std::atoi(Value.c_str());
-								ConfigCtr++;
+								RequiredCtr++;
 							}
 							if (Key == "NumCandidateThresh")
 							{
 								m_NumCandidateThresholds = std::atoi(Value.c_str());
-								ConfigCtr++;
+								RequiredCtr++;
 							}
 							if (Key == "MinGain")
 							{
 								m_MinGain = VPFloat(std::atof(Value.c_str()));
-								ConfigCtr++;
+								RequiredCtr++;
 							}
 							if (Key == "NumThreads")
 							{
 								m_NumThreads = std::max(1, std::atoi(Value.c_str()));
-								ConfigCtr++;
+								RequiredCtr++;
 							}
 							if (Key == "MinLeafSamples") // THIS IS A OPTIONAL PARAMETER, DEFAULT IS 3
 							{
 								m_MinDataSetSize = std::atoi(Value.c_str());
-								ConfigCtr++;
+							}
+							if (Key == "SplitSearch") // THIS IS A OPTIONAL PARAMETER, DEFAULT IS Partition
+							{
+								if (Value == "Partition")
+									m_SplitSearch = SplitSearch::Partition;
+								if (Value == "Bucketed")
+									m_SplitSearch = SplitSearch::Bucketed;
+								if (Value == "Histogram")
+									m_SplitSearch = SplitSearch::Histogram;
+							}
+							if (Key == "HybridSwitchDepth") // THIS IS A OPTIONAL PARAMETER, DEFAULT IS -1 (NEVER)
+							{
+								m_HybridSwitchDepth = std::atoi(Value.c_str());
+							}
+							if (Key == "HybridSwitchSize") // THIS IS A OPTIONAL PARAMETER, DEFAULT IS 16384
+							{
+								m_HybridSwitchSize = std::atoi(Value.c_str());
+							}
+							if (Key == "ParallelTrees") // THIS IS A OPTIONAL PARAMETER, DEFAULT IS 0
+							{
+								m_ParallelTrees = std::atoi(Value.c_str()) != 0;
+							}
+							if (Key == "EntropyTableSize") // THIS IS A OPTIONAL PARAMETER, DEFAULT IS 65536
+							{
+								m_EntropyTableSize = std::atoi(Value.c_str());
+							}
+							if (Key == "DataMemoryBudget") // THIS IS A OPTIONAL PARAMETER, DEFAULT IS 1024 (MB)
+							{
+								m_DataMemoryBudget = std::max(1, std::atoi(Value.c_str()));
+							}
+							if (Key == "Seed") // THIS IS A OPTIONAL PARAMETER, DEFAULT IS 0 (RANDOM)
+							{
+								m_Seed = std::strtoull(Value.c_str(), nullptr, 10);
 							}
 
 							isKey = false;
@@ -159,16 +267,16 @@ namespace Kaadugal
 					}
 				}
 
-				if (ConfigCtr < 7) // Greater is fine because we can have other parameters in the config for client code
+				if (RequiredCtr < 7) // Other parameters in the config for client code are fine
 				{
-					std::cout << "[ WARN ]: Some parameters are missing (read only " << ConfigCtr << " / 7). Please check input." << std::endl;
+					std::cout << "[ WARN ]: Some parameters are missing (read only " << RequiredCtr << " / 7). Please check input." << std::endl;
 					m_isValid = false;
 					return;
 				}
 
 				// Print info for debug purposes
 				std::cout << "[ INFO ]: Here are the training parameters: " << std::endl;
-				std::cout << "[ Number of Threads   ]: " << m_NumThreads << std::endl;
+				std::cout << "[ Number of Threads   ]: " << m_NumThreads << (m_ParallelTrees ? " (parallel trees)" : "") << std::endl;
 				std::cout << "[ Number of Trees     ]: " << m_NumTrees << std::endl;
 				std::cout << "[ Max Levels Per Tree ]: " << m_MaxLevels << std::endl;
 				if (m_TrainMethod == TrainMethod::DFS)
@@ -176,10 +284,22 @@ namespace Kaadugal
 				if (m_TrainMethod == TrainMethod::BFS)
 					std::cout << "[ Training Method     ]: " << "Breadth First" << std::endl;
 				if (m_TrainMethod == TrainMethod::Hybrid)
+				{
 					std::cout << "[ Training Method     ]: " << "Hybrid depth/breadth First" << std::endl;
+					std::cout << "[ Hybrid Switch Depth ]: " << m_HybridSwitchDepth << std::endl;
+					std::cout << "[ Hybrid Switch Size  ]: " << m_HybridSwitchSize << std::endl;
+				}
 				std::cout << "[ Num of Cand Thresholds  ]: " << m_NumCandidateThresholds << std::endl;
 				std::cout << "[ Num of Cand Features    ]: " << m_NumCandidateFeatures << std::endl;
 				std::cout << "[ Minimum Gain        ]: " << m_MinGain << std::endl;
+				if (m_Seed != 0)
+					std::cout << "[ Seed                ]: " << m_Seed << std::endl;
+				if (m_SplitSearch == SplitSearch::Bucketed)
+					std::cout << "[ Split Search        ]: " << "Bucketed" << std::endl;
+				else if (m_SplitSearch == SplitSearch::Histogram)
+					std::cout << "[ Split Search        ]: " << "Histogram" << std::endl;
+				else
+					std::cout << "[ Split Search        ]: " << "Partition" << std::endl;
 			}
 			else
 			{
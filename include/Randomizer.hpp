@@ -5,12 +5,88 @@
 #include <algorithm>
 #include <iostream>
 #include <iterator>
+#include <cstdint>
 #include <omp.h>
 
 namespace Kaadugal
 {
-	// This is a singleton class but supports multiple *OpenMP* threads
-	// Note, however, that no other threading library is supported
+	// Counter-based random engine (Philox4x32-10, Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3", SC 2011)
+	// Every block of 4 numbers is a pure function of a key and a counter, so a stream is identified by its key and the
+	// upper 3 counter words (see SetStream()). Streams can be started anywhere without generating the numbers before them
+	// Satisfies UniformRandomBitGenerator and can be used with the std:: distributions and std::shuffle()
+	class PhiloxEngine
+	{
+	private:
+		uint32_t m_Key[2];
+		uint32_t m_Counter[4]; // m_Counter[0] counts blocks within the stream
+		uint32_t m_Block[4];
+		int m_Used; // Numbers of m_Block already returned
+
+		static void Round(uint32_t (&Counter)[4], const uint32_t (&Key)[2])
+		{
+			uint64_t Product0 = uint64_t(0xD2511F53) * Counter[0];
+			uint64_t Product1 = uint64_t(0xCD9E8D57) * Counter[2];
+			uint32_t Hi0 = uint32_t(Product0 >> 32), Lo0 = uint32_t(Product0);
+			uint32_t Hi1 = uint32_t(Product1 >> 32), Lo1 = uint32_t(Product1);
+			Counter[0] = Hi1 ^ Counter[1] ^ Key[0];
+			Counter[1] = Lo1;
+			Counter[2] = Hi0 ^ Counter[3] ^ Key[1];
+			Counter[3] = Lo0;
+		};
+
+		void Generate(void)
+		{
+			uint32_t Key[2] = { m_Key[0], m_Key[1] };
+			std::copy(m_Counter, m_Counter + 4, m_Block);
+			for (int r = 0; r < 10; ++r)
+			{
+				if (r > 0)
+				{
+					Key[0] += 0x9E3779B9;
+					Key[1] += 0xBB67AE85;
+				}
+				Round(m_Block, Key);
+			}
+			m_Counter[0]++;
+			m_Used = 0;
+		};
+
+	public:
+		typedef uint32_t result_type;
+
+		PhiloxEngine(uint64_t Key = 0, uint64_t Stream = 0, uint32_t SubStream = 0)
+		{
+			SetStream(Key, Stream, SubStream);
+		};
+
+		// Restarts the engine at the beginning of stream (Stream, SubStream) of Key
+		void SetStream(uint64_t Key, uint64_t Stream, uint32_t SubStream = 0)
+		{
+			m_Key[0] = uint32_t(Key);
+			m_Key[1] = uint32_t(Key >> 32);
+			m_Counter[0] = 0;
+			m_Counter[1] = SubStream;
+			m_Counter[2] = uint32_t(Stream);
+			m_Counter[3] = uint32_t(Stream >> 32);
+			m_Used = 4;
+		};
+
+		result_type operator()(void)
+		{
+			if (m_Used == 4)
+				Generate();
+			return m_Block[m_Used++];
+		};
+
+		static constexpr result_type min(void) { return 0; };
+		static constexpr result_type max(void) { return 0xFFFFFFFF; };
+	};
+
+	// This is a singleton class but supports multiple threads
+	// Each thread gets its own random engine so this also works with nested OpenMP teams (e.g.
+	// when training trees in parallel) and other threading libraries
+	// Training points the engine of the calling thread at a stream of (seed, tree, node, candidate) before every random
+	// draw (see SetStream()), so trees do not depend on the number of threads or on which thread built what
 	// See also http://stackoverflow.com/questions/15918758/how-to-make-each-thread-use-its-own-rng-in-c11
 	class Randomizer
 	{
@@ -19,12 +95,6 @@ namespace Kaadugal
 		{
 			int nThreads = std::max(1, omp_get_max_threads());
 			std::cout << "[ INFO ]: Maximum usable threads: " << nThreads << std::endl;
-			for (int i = 0; i < nThreads; ++i)
-			{
-				std::random_device SeedDevice;
-				m_RandEngines.push_back(std::mt19937(SeedDevice()));
-				//m_RandEngines.push_back(std::mt19937((unsigned)0));
-			}
 		};
 		// You want to make sure they
 		// are unaccessable otherwise you may accidently get copies of
@@ -32,8 +102,6 @@ namespace Kaadugal
 		Randomizer(Randomizer const&); // Don't Implement
 		void operator=(Randomizer const&); // Don't implement
 
-		std::vector<std::mt19937> m_RandEngines;
-
 	public:
 		static Randomizer& Get(void)
 		{
@@ -49,11 +117,40 @@ namespace Kaadugal
 			return Vec[dis(Randomizer::Get().GetRNG())];
 		};
 
-		std::mt19937& GetRNG(void)
+		// Randomly keyed until SetStream() or Seed() is called by this thread
+		PhiloxEngine& GetRNG(void)
+		{
+			static thread_local PhiloxEngine RandEngine(GetRandomSeed());
+			return RandEngine;
+		};
+
+		// Points the random engine of the calling thread only at stream (Stream, SubStream) of Key
+		void SetStream(uint64_t Key, uint64_t Stream, uint32_t SubStream = 0)
+		{
+			GetRNG().SetStream(Key, Stream, SubStream);
+		};
+
+		// Reseeds the random engine of the calling thread only
+		void Seed(uint64_t Seed)
+		{
+			SetStream(Seed, 0);
+		};
+
+		// Non-deterministic seed for unseeded training. Never 0
+		static uint64_t GetRandomSeed(void)
+		{
+			std::random_device Device;
+			uint64_t Seed = (uint64_t(Device()) << 32) | Device();
+			return Seed != 0 ? Seed : 1;
+		};
+
+		// Seed for an independent stream of random numbers (e.g. one per tree) derived from a base seed (SplitMix64)
+		static uint64_t MixSeed(uint64_t Seed, uint64_t Stream)
 		{
-			int ThreadID = omp_get_thread_num();
-			// std::cout << "Thread ID: " << ThreadID << std::endl;
-			return m_RandEngines[ThreadID];
+			uint64_t z = Seed + (Stream + 1) * 0x9E3779B97F4A7C15ULL;
+			z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+			z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+			return z ^ (z >> 31);
 		};
 	};
 } // namespace Kaadugal
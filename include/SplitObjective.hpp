@@ -0,0 +1,157 @@
+#ifndef _SPLITOBJECTIVE_HPP_
+#define _SPLITOBJECTIVE_HPP_
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <cmath>
+#include <stdexcept>
+
+#include "Parameters.hpp"
+#include "Abstract/AbstractStatistics.hpp"
+
+namespace Kaadugal
+{
+	// Lookup table of n * log2(n) for integer counts n < Size (0 * log2(0) = 0). Larger counts are computed directly
+	// Tables are shared by all builders that ask for the same size
+	class NLogNTable
+	{
+	private:
+		std::vector<double> m_Table;
+
+	public:
+		NLogNTable(int Size)
+			: m_Table(std::max(Size, 2), 0.0)
+		{
+			for (int n = 2; n < int(m_Table.size()); ++n)
+				m_Table[n] = n * std::log2(double(n));
+		};
+
+		inline double operator()(int n) const
+		{
+			if (n < int(m_Table.size()))
+				return m_Table[n];
+
+			return n * std::log2(double(n));
+		};
+
+		static std::shared_ptr<const NLogNTable> Get(int Size)
+		{
+			static std::map<int, std::shared_ptr<const NLogNTable>> Tables;
+			std::shared_ptr<const NLogNTable> Table;
+#pragma omp critical(KaadugalNLogNTable)
+			{
+				std::shared_ptr<const NLogNTable>& Cached = Tables[Size];
+				if (Cached == nullptr)
+					Cached = std::make_shared<NLogNTable>(Size);
+				Table = Cached;
+			}
+
+			return Table;
+		};
+	};
+
+	// Split objectives are a template parameter of DecisionTreeBuilder (and DecisionForestBuilder)
+	// An objective is constructed from the builder parameters and provides
+	//   template<class S> VPFloat Evaluate(S& ParentStats, S& LeftStats, S& RightStats) const
+	// which returns the (non-negative) gain of splitting the parent into left and right. Larger is better
+	// The builder already handles children with too few data points before calling Evaluate()
+
+	// Information gain (reduction of entropy in bits). Statistics that expose class counts
+	// (AbstractStatistics::GetLabelCounts()) are evaluated with table lookups and no logarithms
+	// Other statistics use their GetEntropy() (e.g. differential entropy for regression)
+	class InformationGain
+	{
+	private:
+		std::shared_ptr<const NLogNTable> m_NLogN;
+
+		// Sum of c * log2(c) over all classes, i.e. n * log2(n) - n * Entropy
+		inline double SumNLogN(const int * Counts, int NumClasses) const
+		{
+			double Sum = 0.0;
+			for (int i = 0; i < NumClasses; ++i)
+				Sum += (*m_NLogN)(Counts[i]);
+
+			return Sum;
+		};
+
+	public:
+		InformationGain(const ForestBuilderParameters& Parameters)
+			: m_NLogN(NLogNTable::Get(Parameters.m_EntropyTableSize))
+		{
+
+		};
+
+		template<class S>
+		VPFloat Evaluate(S& ParentStats, S& LeftStats, S& RightStats) const
+		{
+			int ParentClasses = 0, LeftClasses = 0, RightClasses = 0;
+			const int * ParentCounts = ParentStats.GetLabelCounts(ParentClasses);
+			const int * LeftCounts = LeftStats.GetLabelCounts(LeftClasses);
+			const int * RightCounts = RightStats.GetLabelCounts(RightClasses);
+			if (ParentCounts == nullptr || LeftCounts == nullptr || RightCounts == nullptr)
+			{
+				// See any of the Shotton et al. papers for this definition
+				return ParentStats.GetEntropy()
+					- (
+						VPFloat(LeftStats.GetNumDataPoints())  * LeftStats.GetEntropy()
+						+ VPFloat(RightStats.GetNumDataPoints()) * RightStats.GetEntropy()
+					  ) / VPFloat(ParentStats.GetNumDataPoints());
+			}
+
+			// n * Entropy = n * log2(n) - Sum(c * log2(c)). In double since these are differences of large values
+			int nParent = ParentStats.GetNumDataPoints();
+			int nLeft = LeftStats.GetNumDataPoints();
+			int nRight = RightStats.GetNumDataPoints();
+			double ParentEnergy = (*m_NLogN)(nParent) - SumNLogN(ParentCounts, ParentClasses);
+			double LeftEnergy = (*m_NLogN)(nLeft) - SumNLogN(LeftCounts, LeftClasses);
+			double RightEnergy = (*m_NLogN)(nRight) - SumNLogN(RightCounts, RightClasses);
+
+			return VPFloat((ParentEnergy - LeftEnergy - RightEnergy) / double(nParent));
+		};
+	};
+
+	// Reduction of Gini impurity 1 - Sum(p^2). Needs statistics with class counts (AbstractStatistics::GetLabelCounts())
+	class GiniImpurity
+	{
+	private:
+		// n * Gini impurity
+		static inline double WeightedImpurity(const int * Counts, int NumClasses, int n)
+		{
+			if (n <= 0)
+				return 0.0;
+
+			double SumSquares = 0.0;
+			for (int i = 0; i < NumClasses; ++i)
+				SumSquares += double(Counts[i]) * double(Counts[i]);
+
+			return double(n) - SumSquares / double(n);
+		};
+
+	public:
+		GiniImpurity(const ForestBuilderParameters& Parameters)
+		{
+
+		};
+
+		template<class S>
+		VPFloat Evaluate(S& ParentStats, S& LeftStats, S& RightStats) const
+		{
+			int ParentClasses = 0, LeftClasses = 0, RightClasses = 0;
+			const int * ParentCounts = ParentStats.GetLabelCounts(ParentClasses);
+			const int * LeftCounts = LeftStats.GetLabelCounts(LeftClasses);
+			const int * RightCounts = RightStats.GetLabelCounts(RightClasses);
+			if (ParentCounts == nullptr || LeftCounts == nullptr || RightCounts == nullptr)
+				throw std::runtime_error("GiniImpurity needs statistics with class counts (see AbstractStatistics::GetLabelCounts()).");
+
+			int nParent = ParentStats.GetNumDataPoints();
+			double ParentImpurity = WeightedImpurity(ParentCounts, ParentClasses, nParent);
+			double LeftImpurity = WeightedImpurity(LeftCounts, LeftClasses, LeftStats.GetNumDataPoints());
+			double RightImpurity = WeightedImpurity(RightCounts, RightClasses, RightStats.GetNumDataPoints());
+
+			return VPFloat((ParentImpurity - LeftImpurity - RightImpurity) / double(nParent));
+		};
+	};
+} // namespace Kaadugal
+
+#endif // _SPLITOBJECTIVE_HPP_
@@ -0,0 +1,90 @@
+#ifndef _SPLITWORKSPACE_HPP_
+#define _SPLITWORKSPACE_HPP_
+
+#include <vector>
+#include <memory>
+
+#include "DataSetIndex.hpp"
+
+namespace Kaadugal
+{
+	// Scratch memory of one thread for evaluating split candidates (see DecisionTreeBuilder::EvaluateCandidate())
+	// Buffers are resized for every candidate but keep their capacity, and statistics are reused by assigning to,
+	// aggregating into or resetting them. The builder sizes workspaces once per tree (see
+	// DecisionTreeBuilder::PrepareWorkspaces()) so that split evaluation does not allocate
+	// S: AbstractStatistics
+	template<class S>
+	struct SplitWorkspace
+	{
+		std::vector<VPFloat> m_Responses; // Of the data points of the node
+		std::vector<VPFloat> m_Quantiles; // Sampled responses
+		std::vector<VPFloat> m_Thresholds;
+		std::vector<int> m_PointBuckets; // Bucket of every data point
+		std::vector<int> m_BucketOffsets;
+		std::vector<int> m_BucketFill;
+		std::vector<int> m_BucketCounts; // Label counts of every bucket
+		std::vector<int> m_BinSlots; // Bucket of every non-empty bin of a quantized feature, -1 if empty
+		std::shared_ptr<std::vector<int>> m_LeftBuffer; // Data going left. Also holds the data grouped by bucket
+		std::shared_ptr<std::vector<int>> m_RightBuffer;
+		std::shared_ptr<DataSetIndex> m_LeftIdx; // Views of the buffers (see DataSetIndex::SetView())
+		std::shared_ptr<DataSetIndex> m_RightIdx;
+		std::vector<S> m_BucketStats;
+		std::vector<S> m_CumulativeStats; // Merged buckets 0..j (see DecisionTreeBuilder::FindBestThresholdFromBuckets())
+		std::vector<S> m_Accumulators; // Bucket statistics that data points are accumulated into (see GetAccumulators())
+		S m_LeftStats;
+		S m_RightStats;
+
+		SplitWorkspace(void)
+			: m_LeftBuffer(std::make_shared<std::vector<int>>())
+			, m_RightBuffer(std::make_shared<std::vector<int>>())
+			, m_NumProbedClasses(-1)
+			, m_isLabelCountable(false)
+		{
+			m_LeftIdx = std::make_shared<DataSetIndex>(nullptr, m_LeftBuffer, 0, 0);
+			m_RightIdx = std::make_shared<DataSetIndex>(nullptr, m_RightBuffer, 0, 0);
+		};
+
+		// The first Size statistics of Stats. Stats grows if needed but never shrinks so that its statistics keep their storage
+		static S * GetStats(std::vector<S>& Stats, int Size)
+		{
+			if (int(Stats.size()) < Size)
+				Stats.resize(Size);
+			return Stats.data();
+		};
+
+		// The first Size accumulators, cleared to EmptyStats (statistics of no data points). Accumulators only ever hold
+		// copies of EmptyStats with data accumulated into them, so they are cleared in place with AbstractStatistics::Reset()
+		// if the statistics support it. They only grow if the workspace was sized too small
+		S * GetAccumulators(int64_t Size, const S& EmptyStats)
+		{
+			if (int64_t(m_Accumulators.size()) < Size)
+				m_Accumulators.resize(Size, EmptyStats);
+			S * Accumulators = m_Accumulators.data();
+			for (int64_t k = 0; k < Size; ++k)
+			{
+				if (Accumulators[k].Reset() == false)
+					Accumulators[k] = EmptyStats;
+			}
+			return Accumulators;
+		};
+
+		// True if the statistics support AbstractStatistics::SetLabelCounts(). Probed once per number of classes
+		bool isLabelCountable(int NumClasses)
+		{
+			if (NumClasses != m_NumProbedClasses)
+			{
+				std::vector<int> Counts(NumClasses, 0);
+				S Probe;
+				m_isLabelCountable = Probe.SetLabelCounts(Counts.data(), NumClasses);
+				m_NumProbedClasses = NumClasses;
+			}
+			return m_isLabelCountable;
+		};
+
+	private:
+		int m_NumProbedClasses;
+		bool m_isLabelCountable;
+	};
+} // namespace Kaadugal
+
+#endif // _SPLITWORKSPACE_HPP_
@@ -0,0 +1,220 @@
+#ifndef _TRAININGREPORT_HPP_
+#define _TRAININGREPORT_HPP_
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <ostream>
+#include <iostream>
+#include <cstdint>
+#include <algorithm>
+
+namespace Kaadugal
+{
+	// Phases of training that are timed separately. Times are thread time, so phases that run on several threads at once
+	// add up the time of every thread. Counts are the number of operations, see below
+	enum TrainingPhase
+	{
+		PhaseResponses = 0, // Feature responses of candidates and of the chosen split. Count: responses evaluated
+		PhaseThresholds, // Threshold selection, including sampling responses (breadth-first). Count: candidates
+		PhasePartition, // Partitioning data between children. Breadth-first: advancing data points by a level. Count: partitions
+		PhaseStatistics, // Aggregating, accumulating and merging statistics. Breadth-first training evaluates responses in the
+		                 // same pass that accumulates bucket statistics or counts labels, which is counted here. Count: statistics aggregated
+		PhaseObjective, // Split objective of candidate thresholds, including merging bucket statistics. Count: objective evaluations
+		NumTrainingPhases
+	};
+
+	inline const char * GetTrainingPhaseName(int Phase)
+	{
+		static const char * Names[] = { "Responses", "Thresholds", "Partition", "Statistics", "Objective" };
+		return Phase >= 0 && Phase < NumTrainingPhases ? Names[Phase] : "Unknown";
+	};
+
+	// Training profile of one level (depth) of a tree or of all trees of a forest. Times are in microseconds
+	struct LevelReport
+	{
+		uint64_t m_Time; // Building the nodes of this level. Summed over nodes, i.e. threads, in depth-first training
+		uint64_t m_PhaseTimes[NumTrainingPhases];
+		uint64_t m_PhaseCounts[NumTrainingPhases];
+		uint64_t m_NumSplitNodes;
+		uint64_t m_NumLeafNodes;
+		uint64_t m_NumDataPoints; // Data points that reach the nodes of this level
+		uint64_t m_NumCandidates; // Candidate feature responses evaluated
+
+		LevelReport(void)
+			: m_Time(0)
+			, m_NumSplitNodes(0)
+			, m_NumLeafNodes(0)
+			, m_NumDataPoints(0)
+			, m_NumCandidates(0)
+		{
+			std::fill(m_PhaseTimes, m_PhaseTimes + NumTrainingPhases, 0);
+			std::fill(m_PhaseCounts, m_PhaseCounts + NumTrainingPhases, 0);
+		};
+
+		uint64_t GetPhaseTime(void) const
+		{
+			uint64_t Sum = 0;
+			for (int p = 0; p < NumTrainingPhases; ++p)
+				Sum += m_PhaseTimes[p];
+			return Sum;
+		};
+
+		void Add(const LevelReport& Other)
+		{
+			m_Time += Other.m_Time;
+			for (int p = 0; p < NumTrainingPhases; ++p)
+			{
+				m_PhaseTimes[p] += Other.m_PhaseTimes[p];
+				m_PhaseCounts[p] += Other.m_PhaseCounts[p];
+			}
+			m_NumSplitNodes += Other.m_NumSplitNodes;
+			m_NumLeafNodes += Other.m_NumLeafNodes;
+			m_NumDataPoints += Other.m_NumDataPoints;
+			m_NumCandidates += Other.m_NumCandidates;
+		};
+
+		// Depth is omitted if negative (e.g. totals)
+		void WriteJSON(std::ostream& OutputStream, int Depth) const
+		{
+			OutputStream << "{ ";
+			if (Depth >= 0)
+				OutputStream << "\"depth\": " << Depth << ", ";
+			OutputStream << "\"time_us\": " << m_Time << ", \"split_nodes\": " << m_NumSplitNodes
+				<< ", \"leaf_nodes\": " << m_NumLeafNodes << ", \"data_points\": " << m_NumDataPoints << ", \"candidates\": " << m_NumCandidates
+				<< ", \"phases\": {";
+			for (int p = 0; p < NumTrainingPhases; ++p)
+				OutputStream << (p ? ", " : " ") << "\"" << GetTrainingPhaseName(p) << "\": { \"time_us\": " << m_PhaseTimes[p] << ", \"count\": " << m_PhaseCounts[p] << " }";
+			OutputStream << " } }";
+		};
+	};
+
+	// Training profile of one tree (see DecisionTreeBuilder::GetReport())
+	struct TreeReport
+	{
+		int m_TreeIndex; // Index in the forest
+		uint64_t m_Time; // Wall time of building the tree in microseconds
+		int m_NumThreads; // Threads available for the nodes of this tree
+		int m_NumDataPoints;
+		int m_ReachedMaxDepth;
+		std::vector<LevelReport> m_Levels; // Indexed by depth. Levels that were not reached are empty
+
+		TreeReport(void)
+			: m_TreeIndex(0)
+			, m_Time(0)
+			, m_NumThreads(1)
+			, m_NumDataPoints(0)
+			, m_ReachedMaxDepth(0)
+		{
+
+		};
+
+		LevelReport GetTotals(void) const
+		{
+			LevelReport Totals;
+			for (const LevelReport& Level : m_Levels)
+				Totals.Add(Level);
+			return Totals;
+		};
+
+		// Time of the timed phases over the time that all threads were available. Below 1 when threads wait for each
+		// other or for serial parts of training
+		double GetThreadUtilization(void) const
+		{
+			return m_Time > 0 ? double(GetTotals().GetPhaseTime()) / (double(m_Time) * std::max(1, m_NumThreads)) : 0.0;
+		};
+
+		void WriteJSON(std::ostream& OutputStream, const std::string& Indent) const
+		{
+			LevelReport Totals = GetTotals();
+			OutputStream << "{\n" << Indent << "  \"tree\": " << m_TreeIndex << ", \"time_us\": " << m_Time << ", \"threads\": " << m_NumThreads
+				<< ", \"thread_utilization\": " << GetThreadUtilization() << ", \"data_points\": " << m_NumDataPoints << ", \"depth\": " << m_ReachedMaxDepth << ",\n";
+			OutputStream << Indent << "  \"totals\": ";
+			Totals.WriteJSON(OutputStream, -1);
+			OutputStream << ",\n" << Indent << "  \"levels\": [";
+			for (int d = 0; d <= m_ReachedMaxDepth && d < int(m_Levels.size()); ++d)
+			{
+				OutputStream << (d ? ",\n" : "\n") << Indent << "    ";
+				m_Levels[d].WriteJSON(OutputStream, d);
+			}
+			OutputStream << "\n" << Indent << "  ]\n" << Indent << "}";
+		};
+	};
+
+	// Training profile of a forest: one TreeReport per trained tree (see DecisionForestBuilder::GetReport())
+	struct TrainingReport
+	{
+		uint64_t m_Time; // Wall time of training all trees in microseconds
+		int m_NumThreads;
+		std::vector<TreeReport> m_Trees;
+
+		TrainingReport(void)
+			: m_Time(0)
+			, m_NumThreads(1)
+		{
+
+		};
+
+		// Levels summed over all trees
+		std::vector<LevelReport> GetLevelTotals(void) const
+		{
+			std::vector<LevelReport> Levels;
+			for (const TreeReport& Tree : m_Trees)
+			{
+				Levels.resize(std::max(Levels.size(), size_t(Tree.m_ReachedMaxDepth + 1)));
+				for (int d = 0; d <= Tree.m_ReachedMaxDepth && d < int(Tree.m_Levels.size()); ++d)
+					Levels[d].Add(Tree.m_Levels[d]);
+			}
+			return Levels;
+		};
+
+		double GetThreadUtilization(void) const
+		{
+			uint64_t PhaseTime = 0;
+			for (const TreeReport& Tree : m_Trees)
+				PhaseTime += Tree.GetTotals().GetPhaseTime();
+			return m_Time > 0 ? double(PhaseTime) / (double(m_Time) * std::max(1, m_NumThreads)) : 0.0;
+		};
+
+		void WriteJSON(std::ostream& OutputStream) const
+		{
+			std::vector<LevelReport> Levels = GetLevelTotals();
+			LevelReport Totals;
+			for (const LevelReport& Level : Levels)
+				Totals.Add(Level);
+
+			OutputStream << "{\n  \"time_us\": " << m_Time << ", \"threads\": " << m_NumThreads << ", \"thread_utilization\": " << GetThreadUtilization()
+				<< ", \"num_trees\": " << m_Trees.size() << ",\n";
+			OutputStream << "  \"totals\": ";
+			Totals.WriteJSON(OutputStream, -1);
+			OutputStream << ",\n  \"levels\": [";
+			for (int d = 0; d < int(Levels.size()); ++d)
+			{
+				OutputStream << (d ? ",\n" : "\n") << "    ";
+				Levels[d].WriteJSON(OutputStream, d);
+			}
+			OutputStream << "\n  ],\n  \"trees\": [";
+			for (size_t t = 0; t < m_Trees.size(); ++t)
+			{
+				OutputStream << (t ? ",\n" : "\n") << "    ";
+				m_Trees[t].WriteJSON(OutputStream, "    ");
+			}
+			OutputStream << "\n  ]\n}\n";
+		};
+
+		bool SaveJSON(const std::string& FileName) const
+		{
+			std::ofstream OutputStream(FileName, std::ios::out | std::ios::trunc);
+			if (!OutputStream.is_open())
+			{
+				std::cout << "[ WARN ]: Unable to open file " << FileName << " to save training report." << std::endl;
+				return false;
+			}
+			WriteJSON(OutputStream);
+
+			return OutputStream.good();
+		};
+	};
+} // namespace Kaadugal
+
+#endif // _TRAININGREPORT_HPP_
@@ -2,6 +2,8 @@
 #define _UTILITIES_HPP_
 
 #include <chrono>
+#include <cstdint>
+#include <cstddef>
 
 // Get the current Epoch time in microseconds
 inline uint64_t GetCurrentEpochTime(void)
@@ -10,4 +12,14 @@ inline uint64_t GetCurrentEpochTime(void)
 	return etime;
 };
 
+// 64-bit FNV-1a hash of a byte range. Pass the previous hash to continue hashing over several ranges
+// Used for checksums and fingerprints of files, not for security
+inline uint64_t HashBytes(const void * Data, size_t Size, uint64_t Hash = 14695981039346656037ULL)
+{
+	const unsigned char * Bytes = (const unsigned char *)Data;
+	for (size_t i = 0; i < Size; ++i)
+		Hash = (Hash ^ Bytes[i]) * 1099511628211ULL;
+	return Hash;
+};
+
 #endif // #ifndef _UTILITIES_HPP_
@@ -0,0 +1,140 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+#include <algorithm>
+
+#include "Kaadugal.hpp"
+#include "DataSetFile.hpp"
+
+std::string g_TextDataFName;
+std::string g_OutputDataFName;
+Kaadugal::LabelType g_LabelType = Kaadugal::ClassLabels;
+
+void PrintUsage(char * argv[])
+{
+	std::cout << "[ USAGE ]: " << argv[0] << " <TEXT_DATA_FILE> <OUTPUT_DATA_FILE> [class|target|none]" << std::endl;
+	std::cout << "[ USAGE ]: The last column is an integer class label (class, default), a regression target (target) or a feature (none)" << std::endl;
+}
+
+bool ParseArguments(int argc, char * argv[])
+{
+	if (argc < 3 || argc > 4)
+	{
+		PrintUsage(argv);
+		return false;
+	}
+	g_TextDataFName = argv[1];
+	g_OutputDataFName = argv[2];
+	std::string Type = argc == 4 ? argv[3] : "class";
+	if (Type == "class")
+		g_LabelType = Kaadugal::ClassLabels;
+	else if (Type == "target")
+		g_LabelType = Kaadugal::Targets;
+	else if (Type == "none")
+		g_LabelType = Kaadugal::NoLabels;
+	else
+	{
+		PrintUsage(argv);
+		return false;
+	}
+
+	return true;
+}
+
+// This program converts a text data file (one data point per line, columns separated by white space, lines
+// beginning with # are comments) to the binary dataset format that can be loaded quickly or memory-mapped
+int main(int argc, char * argv[])
+{
+	if (ParseArguments(argc, argv) == false)
+		return -1;
+
+	std::ifstream TextFile(g_TextDataFName, std::ios::in | std::ios::binary);
+	if (!TextFile.is_open())
+	{
+		std::cout << "[ WARN ]: Unable to open text data file. Exiting." << std::endl;
+		return -2;
+	}
+	std::stringstream Buffer;
+	Buffer << TextFile.rdbuf();
+	std::string Text = Buffer.str();
+
+	// Values are collected row-major and transposed once the number of rows is known
+	std::vector<Kaadugal::VPFloat> Values;
+	std::vector<Kaadugal::VPFloat> Row;
+	int NumColumns = -1;
+	const char * Pos = Text.c_str();
+	const char * End = Pos + Text.size();
+	for (int Line = 1; Pos < End; ++Line)
+	{
+		const char * LineEnd = std::find(Pos, End, '\n');
+		Row.clear();
+		if (*Pos != '#')
+		{
+			while (true)
+			{
+				while (Pos < LineEnd && std::isspace((unsigned char)(*Pos)))
+					++Pos;
+				if (Pos >= LineEnd)
+					break;
+				char * ValueEnd = nullptr;
+				Row.push_back(Kaadugal::VPFloat(std::strtod(Pos, &ValueEnd)));
+				if (ValueEnd == Pos || ValueEnd > LineEnd)
+				{
+					std::cout << "[ WARN ]: Invalid value in line " << Line << ". Exiting." << std::endl;
+					return -2;
+				}
+				Pos = ValueEnd;
+			}
+		}
+		Pos = LineEnd + 1;
+		if (Row.empty()) // Empty or comment line
+			continue;
+
+		if (NumColumns < 0)
+			NumColumns = Row.size();
+		if (int(Row.size()) != NumColumns)
+		{
+			std::cout << "[ WARN ]: Line " << Line << " has " << Row.size() << " columns instead of " << NumColumns << ". Exiting." << std::endl;
+			return -2;
+		}
+		Values.insert(Values.end(), Row.begin(), Row.end());
+	}
+
+	int NumFeatures = NumColumns - (g_LabelType == Kaadugal::NoLabels ? 0 : 1);
+	if (NumColumns <= 0 || NumFeatures <= 0)
+	{
+		std::cout << "[ WARN ]: Text data file has no features. Exiting." << std::endl;
+		return -2;
+	}
+	uint64_t NumDataPoints = Values.size() / NumColumns;
+	Kaadugal::DenseDataSet DataSet(NumDataPoints, NumFeatures);
+	for (uint64_t i = 0; i < NumDataPoints; ++i)
+	{
+		const Kaadugal::VPFloat * RowValues = Values.data() + i * NumColumns;
+		for (int f = 0; f < NumFeatures; ++f)
+			DataSet.SetFeature(i, f, RowValues[f]);
+		if (g_LabelType == Kaadugal::ClassLabels)
+		{
+			int Label = int(RowValues[NumFeatures]);
+			if (Label < 0 || Kaadugal::VPFloat(Label) != RowValues[NumFeatures])
+			{
+				std::cout << "[ WARN ]: Data point " << i << " has an invalid class label. Exiting." << std::endl;
+				return -2;
+			}
+			DataSet.SetLabel(i, Label);
+		}
+		if (g_LabelType == Kaadugal::Targets)
+			DataSet.SetTarget(i, RowValues[NumFeatures]);
+	}
+
+	if (Kaadugal::DataSetFile::Save(DataSet, g_OutputDataFName, g_LabelType) == false)
+		return -2;
+	std::cout << "Done converting " << NumDataPoints << " data points with " << NumFeatures << " features";
+	if (g_LabelType == Kaadugal::ClassLabels)
+		std::cout << " and " << DataSet.GetNumClasses() << " classes";
+	std::cout << " into dataset: " << g_OutputDataFName << std::endl;
+
+	return 0;
+}
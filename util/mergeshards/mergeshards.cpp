@@ -0,0 +1,30 @@
+#include <iostream>
+#include <fstream>
+
+#include "ForestShard.hpp"
+
+// This program merges forest shards (see ForestShard.hpp) into a forest. Unlike mergetrees, it checks that all
+// shards are intact, were trained with the same types, parameters, seed and data size and together hold every tree
+int main(int argc, char * argv[])
+{
+	if (argc < 3)
+	{
+		std::cout << "[ USAGE ]: " << argv[0] << " <SHARD1_PATH> <SHARD2_PATH> ... <OUTPUT_FOREST_FILE>" << std::endl;
+		return -1;
+	}
+
+	std::vector<std::string> ShardFNames(argv + 1, argv + argc - 1);
+	std::string OutputForestFName = argv[argc - 1];
+	try
+	{
+		Kaadugal::ForestShard::Merge(ShardFNames, OutputForestFName);
+	}
+	catch (const std::exception& Error)
+	{
+		std::cout << "[ ERROR ]: " << Error.what() << std::endl;
+		return -2;
+	}
+	std::cout << "Done merging " << ShardFNames.size() << " shards into forest: " << OutputForestFName << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,102 @@
+#include <iostream>
+#include <fstream>
+#include <thread>
+#include <cstdlib>
+
+#include "ForestShard.hpp"
+
+// This program trains a forest with several local worker processes and merges their forest shards
+// Every worker runs the given command with {SHARD}, {NUM_SHARDS} and {OUTPUT} replaced by its shard index, the number
+// of shards and the path of its shard file, e.g.
+//   shardtrain 4 forest.out ./classify trainshard config.train {SHARD} {NUM_SHARDS} {OUTPUT} data.kds
+// Output of shard k goes to <OUTPUT_FOREST_PATH>.shard<k>.log. Unless OMP_NUM_THREADS is set, the cores are divided
+// between the workers. Set Seed in the config to make the forest reproducible
+int g_NumShards = 0;
+std::string g_OutputForestFName;
+std::vector<std::string> g_WorkerCommand;
+
+std::string Replace(std::string Text, const std::string& From, const std::string& To)
+{
+	for (size_t Pos = Text.find(From); Pos != std::string::npos; Pos = Text.find(From, Pos + To.size()))
+		Text.replace(Pos, From.size(), To);
+	return Text;
+}
+
+// Quotes an argument for the shell that std::system() uses
+std::string Quote(const std::string& Argument)
+{
+#ifdef _WIN32
+	return "\"" + Replace(Argument, "\"", "\\\"") + "\"";
+#else
+	return "'" + Replace(Argument, "'", "'\\''") + "'";
+#endif
+}
+
+std::string GetShardFName(int Shard) { return g_OutputForestFName + ".shard" + std::to_string(Shard); }
+
+int main(int argc, char * argv[])
+{
+	if (argc < 4 || (g_NumShards = std::atoi(argv[1])) < 1)
+	{
+		std::cout << "[ USAGE ]: " << argv[0] << " <NUM_SHARDS> <OUTPUT_FOREST_PATH> <WORKER_COMMAND> [<WORKER_ARGS> ...]" << std::endl;
+		std::cout << "[ USAGE ]: Worker arguments may contain {SHARD}, {NUM_SHARDS} and {OUTPUT} (the shard file of the worker)" << std::endl;
+		return -1;
+	}
+	g_OutputForestFName = argv[2];
+	g_WorkerCommand.assign(argv + 3, argv + argc);
+
+	if (std::getenv("OMP_NUM_THREADS") == nullptr)
+	{
+		std::string NumThreads = std::to_string(std::max(1, int(std::thread::hardware_concurrency()) / g_NumShards));
+#ifdef _WIN32
+		_putenv_s("OMP_NUM_THREADS", NumThreads.c_str());
+#else
+		setenv("OMP_NUM_THREADS", NumThreads.c_str(), 1);
+#endif
+	}
+	std::cout << "[ INFO ]: Starting " << g_NumShards << " workers with " << std::getenv("OMP_NUM_THREADS") << " thread(s) each..." << std::endl;
+
+	std::vector<int> ExitCodes(g_NumShards, 0);
+	std::vector<std::thread> Workers;
+	for (int Shard = 0; Shard < g_NumShards; ++Shard)
+	{
+		std::string Command;
+		for (const std::string& Argument : g_WorkerCommand)
+		{
+			std::string Value = Replace(Argument, "{SHARD}", std::to_string(Shard));
+			Value = Replace(Value, "{NUM_SHARDS}", std::to_string(g_NumShards));
+			Value = Replace(Value, "{OUTPUT}", GetShardFName(Shard));
+			Command += Quote(Value) + " ";
+		}
+		Command += "> " + Quote(GetShardFName(Shard) + ".log") + " 2>&1";
+		Workers.push_back(std::thread([Command, Shard, &ExitCodes]() { ExitCodes[Shard] = std::system(Command.c_str()); }));
+	}
+
+	bool Success = true;
+	std::vector<std::string> ShardFNames;
+	for (int Shard = 0; Shard < g_NumShards; ++Shard)
+	{
+		Workers[Shard].join();
+		ShardFNames.push_back(GetShardFName(Shard));
+		if (ExitCodes[Shard] != 0)
+		{
+			std::cout << "[ ERROR ]: Worker " << Shard << " failed. See " << GetShardFName(Shard) << ".log" << std::endl;
+			Success = false;
+		}
+	}
+	if (Success == false)
+		return -2;
+
+	try
+	{
+		Kaadugal::ForestShard::Merge(ShardFNames, g_OutputForestFName);
+	}
+	catch (const std::exception& Error)
+	{
+		std::cout << "[ ERROR ]: " << Error.what() << std::endl;
+		return -2;
+	}
+	std::cout << "Done merging " << g_NumShards << " shards into forest: " << g_OutputForestFName << std::endl;
+
+	return 0;
+}
@@ -0,0 +1,81 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <stdexcept>
+
+#include "Kaadugal.hpp"
+#include "DecisionForestBuilder.hpp"
+#include "MappedDataSet.hpp"
+#include "AxisAlignedFeatureResponse.hpp"
+#include "DenseStatistics.hpp"
+
+std::string g_ParamFileName;
+std::string g_DataFileName;
+std::string g_OutputForestFName;
+
+void PrintUsage(char * argv[])
+{
+	std::cout << "[ USAGE ]: " << argv[0] << " <CONFIG_FILE_PATH> <BINARY_DATA_FILE> <OUTPUT_FOREST_PATH>" << std::endl;
+	std::cout << "[ USAGE ]: Convert text data files with convertdataset first" << std::endl;
+}
+
+bool ParseArguments(int argc, char * argv[])
+{
+	if (argc != 4)
+	{
+		PrintUsage(argv);
+		return false;
+	}
+	g_ParamFileName = argv[1];
+	g_DataFileName = argv[2];
+	g_OutputForestFName = argv[3];
+
+	return true;
+}
+
+// This program trains a forest with axis-aligned splits and class histograms on a binary dataset file that is
+// memory-mapped instead of loaded (see MappedDataSet). With TrainMethod BFS or Hybrid at most DataMemoryBudget
+// megabytes of the dataset are kept in memory per tree, so the dataset can be larger than memory
+int main(int argc, char * argv[])
+{
+	if (ParseArguments(argc, argv) == false)
+		return -1;
+
+	std::shared_ptr<Kaadugal::MappedDataSet> DataSet;
+	try
+	{
+		DataSet = std::make_shared<Kaadugal::MappedDataSet>(g_DataFileName);
+	}
+	catch (const std::exception& Error)
+	{
+		std::cout << "[ ERROR ]: " << Error.what() << std::endl;
+		return -2;
+	}
+	if (DataSet->GetLabelData() == nullptr)
+	{
+		std::cout << "[ ERROR ]: Training needs a dataset with class labels." << std::endl;
+		return -2;
+	}
+	std::cout << "[ INFO ]: Mapped input data (Total: " << DataSet->GetNumDataPoints() << ", features: " << DataSet->GetNumFeatures()
+		<< "). Total number of classes: " << DataSet->GetNumClasses() << std::endl;
+
+	Kaadugal::ForestBuilderParameters ForestParams(g_ParamFileName);
+	Kaadugal::DecisionForestBuilder<Kaadugal::AxisAlignedFeatureResponse, Kaadugal::DenseHistogramStats> ForestBuilder(ForestParams);
+	if (ForestBuilder.Build(DataSet) == false)
+	{
+		std::cout << "[ ERROR ]: Unable to train forest." << std::endl;
+		return -2;
+	}
+
+	std::cout << "Writing forest to file..." << std::endl;
+	std::ofstream OutputStream(g_OutputForestFName, std::ios::out | std::ios::trunc | std::ios::binary);
+	if (!OutputStream.is_open())
+	{
+		std::cout << "[ WARN ]: Unable to open file to save." << std::endl;
+		return -2;
+	}
+	ForestBuilder.GetForest().Serialize(OutputStream);
+	std::cout << "Done." << std::endl;
+
+	return 0;
+}